@@ -34,7 +34,7 @@ void dealloc_array_fl_complex(fft_complex **arr, int m);
  * \brief Dynamically allocate 2D array of floats
  * \param rows      Number of rows
  * \param columns   Number of columns
- * \return pointer to 2D array
+ * \return pointer to 2D array, or NULL if the allocation failed
  *
  * This routine allocates memory in heap for a 2D
  * array of dimensions rows x columns and datatype
@@ -49,8 +49,15 @@ float **alloc_array(int rows, int columns) {
 
 /* For each row, allocate an array with size equal to number of columns */
 
-    for (int i = 0; i < rows; i++) {
+    for (int i = 0; twoDary != NULL && i < rows; i++) {
         *(twoDary + i) = (calloc(columns, sizeof(float)));
+
+/* On failure, release the rows allocated so far */
+
+        if (*(twoDary + i) == NULL) {
+            dealloc_array_fl(twoDary, i);
+            twoDary = NULL;
+        }
     }
 	 
     return twoDary;
@@ -59,7 +66,7 @@ float **alloc_array(int rows, int columns) {
 
 /**
  * \brief Deallocate dynamically allocated 2D array of floats
- * \param arr       Pointer to 2D array
+ * \param arr       Pointer to 2D array, or NULL
  * \param m         Number of rows
  *
  * This routine deallocates heap memory allocated for
@@ -69,6 +76,9 @@ float **alloc_array(int rows, int columns) {
 void dealloc_array_fl(float **arr, int m) {
     int k;
 
+    if (arr == NULL)
+        return;
+
 /* Free memory corresponding to each row */
 
     for (k = 0; k < m; k++) {
@@ -85,7 +95,7 @@ void dealloc_array_fl(float **arr, int m) {
  * \brief Dynamically allocate 2D array of complex floats
  * \param rows      Number of rows
  * \param columns   Number of columns
- * \return pointer to 2D array
+ * \return pointer to 2D array, or NULL if the allocation failed
  *
  * This routine allocates memory in heap for a 2D
  * array of dimensions rows x columns and datatype
@@ -100,8 +110,15 @@ fft_complex **alloc_array_complex(int rows, int columns) {
  
 /* For each row, allocate an array with size equal to number of columns */
 
-    for (int i = 0; i < rows; i++) {
+    for (int i = 0; twoDary != NULL && i < rows; i++) {
         *(twoDary + i) = (calloc(columns, sizeof(fft_complex)));
+
+/* On failure, release the rows allocated so far */
+
+        if (*(twoDary + i) == NULL) {
+            dealloc_array_fl_complex(twoDary, i);
+            twoDary = NULL;
+        }
     } 
     return twoDary;
 }
@@ -109,7 +126,7 @@ fft_complex **alloc_array_complex(int rows, int columns) {
 
 /**
  * \brief Deallocate dynamically allocated 2D array of complex floats
- * \param arr       Pointer to 2D array
+ * \param arr       Pointer to 2D array, or NULL
  * \param m         Number of rows
  *
  * This routine deallocates heap memory allocated for
@@ -119,6 +136,9 @@ fft_complex **alloc_array_complex(int rows, int columns) {
 void dealloc_array_fl_complex(fft_complex **arr, int m) {
     int k;
 
+    if (arr == NULL)
+        return;
+
 /* Free memory corresponding to each row */
 
     for (k = 0; k < m; k++) {
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file batch.c
+ * @brief Fast bilateral filter of a batch of images of the same size
+ *
+ * The images are filtered by a single team of threads. The work is
+ * split in items, each a range of frequencies of one image, which
+ * the threads take in turn; the auxiliary images of a thread are
+ * allocated once for the whole batch. Images with the same T share
+ * the range kernel fit, and the spatial filter constants are shared
+ * by all the images.
+ **/
+
+#include "headersreq.h"
+
+int shiftableBF_batch(int count, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                      float ****img, float ****outimg, int cores, program_params *params, float eps);
+
+/** \brief Work item: frequencies [k0, k1) of one image */
+typedef struct {
+    int image, k0, k1;
+} batch_item;
+
+/**
+ * \brief Compute the output planes from P and Q
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels, interleaved in P and Q
+ * \param P         Unnormalized filtered image
+ * \param Q         Weight sums
+ * \param img       Pointer to the input planes, used where Q vanishes
+ * \param outimg    Pointer to the output planes
+ */
+static void batch_output(int m, int n, int channels, float **P, float **Q, float ***img, float ***outimg) {
+    const int C = channels;
+    for (int c = 0; c < C; c++) {
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < n; j++) {
+                if (fabsf((Q[i][j * C + c])) <= 0.001f)
+                    outimg[c][i][j] = img[c][i][j];
+                else
+                    outimg[c][i][j] = (P[i][j * C + c] / Q[i][j * C + c]);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a batch of images
+ * \param count     Number of images
+ * \param m         Height of the images
+ * \param n         Width of the images
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input images, each a pointer to
+ *                  its planes
+ * \param outimg    Pointer to the output images
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters; on return they
+ *                  hold the fit of the largest T, the backend and
+ *                  the number of threads used
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Same as shiftableBF_channels for each image. T is found for
+ * each image, and the range kernel is fitted once per distinct
+ * value. The backend is chosen from the largest T, or measured
+ * on the first image with PLAN_MEASURE, and all the cores are
+ * used. When there are fewer images than threads, the
+ * frequencies of an image are split in several items whose P
+ * and Q are summed; otherwise each item filters a whole image.
+ */
+int shiftableBF_batch(int count, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                      float ****img, float ****outimg, int cores, program_params *params, float eps) {
+    int b, i, j, c, f;
+    const int C = channels;
+    if (count <= 0)
+        return EXIT_SUCCESS;
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+    int threads = max(cores, 1);
+
+    /* Half period of each image */
+    float *Tmax = (float *) calloc(count, sizeof(float));
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#pragma omp parallel for schedule(dynamic, 1) private(c)
+#endif
+    for (b = 0; b < count; b++) {
+        float T = 0;
+        for (c = 0; c < C; c++)
+            T = max(T, maxfilterfind(img[b][c], wy, wx, m, n));
+        Tmax[b] = max(T, ceilf(3.2f * sigmar));
+    }
+
+    /* One range kernel fit per distinct half period */
+    program_params *fits = (program_params *) calloc(count, sizeof(program_params));
+    int *fit_of = (int *) calloc(count, sizeof(int));
+    int nfits = 0, largest = 0;
+    for (b = 0; b < count; b++) {
+        for (f = 0; f < nfits && fits[f].T != Tmax[b]; f++);
+        if (f == nfits) {
+            fits[nfits] = *params;
+            cache_fourier_coefficients(Tmax[b], sigmar, eps, &fits[nfits]);
+            if (fits[nfits].T > fits[largest].T)
+                largest = nfits;
+            nfits++;
+        }
+        fit_of[b] = f;
+    }
+
+    /* Spatial backend, shared by the batch */
+    program_params plan = fits[largest];
+    plan.threads = threads;
+    if (plan.planning == PLAN_MEASURE) {
+        if (plan_measure(m, n, sigmas_x, sigmas_y, C, img[0], &plan) != EXIT_SUCCESS) {
+            for (f = 0; f < nfits; f++)
+                free(fits[f].coeff);
+            free(fits);
+            free(fit_of);
+            free(Tmax);
+            return EXIT_FAILURE;
+        }
+    } else if (plan.backend < 0) {
+        plan.backend = select_spatial_backend(plan.T, sigmar);
+    }
+    plan.threads = threads; /* The images keep all the threads busy whatever the plan of one image */
+    const spatial_filter *spatial = &spatial_filters[plan.backend];
+    spatial_kernel kx, ky; /** \brief Spatial filter constants along rows and columns, shared by all images */
+    cache_spatial_kernel(plan.backend, sigmas_x, &kx);
+    cache_spatial_kernel(plan.backend, sigmas_y, &ky);
+    int cx = kx.w, cy = ky.w; /** \brief Padding widths of the auxiliary images */
+    int mp = m + 2 * cy, np = n + 2 * cx; /** \brief Size of the padded auxiliary images */
+
+    /* Work items: images are split in parts only when there are fewer images than threads */
+    int parts = (threads + count - 1) / count;
+    batch_item *items = (batch_item *) calloc(count * parts, sizeof(batch_item));
+    int *remaining = (int *) calloc(count, sizeof(int));
+    float ***P = (float ***) calloc(count, sizeof(float **)); /** \brief Sums of the parts of an image */
+    float ***Q = (float ***) calloc(count, sizeof(float **));
+    int nitems = 0;
+    bool failed = false; /** \brief Whether buffers of the batch could not be allocated */
+    for (b = 0; b < count; b++) {
+        int K = fits[fit_of[b]].K, p = min(parts, K);
+        for (i = 0; i < p; i++) {
+            items[nitems].image = b;
+            items[nitems].k0 = (i * K) / p;
+            items[nitems].k1 = ((i + 1) * K) / p;
+            nitems++;
+        }
+        remaining[b] = p;
+        if (p > 1) {
+            P[b] = alloc_array(m, n * C);
+            Q[b] = alloc_array(m, n * C);
+            if (P[b] == NULL || Q[b] == NULL)
+                failed = true;
+        }
+    }
+    if (failed)
+        nitems = 0;
+
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#pragma omp parallel shared(nitems, items, fits, fit_of, remaining, m, n, cx, cy, mp, np, spatial, kx, ky, P, Q, img, outimg, failed) private(b, i, j, c)
+#endif
+    {
+        /** \brief Matrices for Auxiliary images, reused by the items of the thread */
+        fft_complex **F = alloc_array_complex(m, n * C), **F1 = alloc_array_complex(m, n * C),
+                **G = alloc_array_complex(mp, np * C), **H = alloc_array_complex(mp, np * C);
+        float **P_k = alloc_array(m, n * C), **Q_k = alloc_array(m, n * C);
+        bool allocated = F != NULL && F1 != NULL && G != NULL && H != NULL && P_k != NULL && Q_k != NULL;
+        if (!allocated) {
+#ifdef _OPENMP
+#pragma omp critical(fbf_batch)
+#endif
+            failed = true;
+        }
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1) nowait
+#endif
+        for (int it = 0; it < nitems; it++) {
+            if (!allocated)
+                continue;
+            const batch_item *item = &items[it];
+            float ***image = img[item->image];
+            const float *coff = fits[fit_of[item->image]].coeff;
+            float omegao = (2 * M_PI) / (2 * fits[fit_of[item->image]].T + 1);
+            b = item->image;
+
+            for (i = 0; i < m; i++) {
+                memset(P_k[i], 0, n * C * sizeof(float));
+                memset(Q_k[i], 0, n * C * sizeof(float));
+            }
+            /* Basis F1 for frequency omegao, needed when the item has more than one frequency */
+            if (item->k1 - item->k0 > 1) {
+                for (i = 0; i < m; i++) {
+                    for (j = 0; j < n; j++) {
+                        for (c = 0; c < C; c++) {
+                            F1[i][j * C + c].real = cosf(omegao * image[c][i][j]);
+                            F1[i][j * C + c].imag = sinf(omegao * image[c][i][j]);
+                        }
+                    }
+                }
+            }
+
+            shiftableBF_accumulate(m, n, C, item->k0, item->k1, omegao, coff, spatial, &kx, &ky, image, image, F1, F,
+                                   G, H, P_k, Q_k, NULL);
+
+            if (P[b] == NULL) {
+                /* Whole image in this item */
+                batch_output(m, n, C, P_k, Q_k, image, outimg[b]);
+            } else {
+                /* Sum the parts, the last one computes the output */
+                bool last;
+#ifdef _OPENMP
+#pragma omp critical(fbf_batch)
+#endif
+                {
+                    for (i = 0; i < m; i++) {
+                        for (j = 0; j < n * C; j++) {
+                            P[b][i][j] += P_k[i][j];
+                            Q[b][i][j] += Q_k[i][j];
+                        }
+                    }
+                    last = (--remaining[b] == 0);
+                }
+                if (last) {
+                    batch_output(m, n, C, P[b], Q[b], image, outimg[b]);
+                    dealloc_array_fl(P[b], m);
+                    dealloc_array_fl(Q[b], m);
+                    P[b] = Q[b] = NULL;
+                }
+            }
+        }
+
+        /* Deallocate thread private matrices */
+        dealloc_array_fl(P_k, m);
+        dealloc_array_fl(Q_k, m);
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(F1, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+    }
+
+    /* Parameters of the batch: fit of the largest T and the plan */
+    for (f = 0; f < nfits; f++) {
+        if (f != largest)
+            free(fits[f].coeff);
+    }
+    *params = plan;
+    /* Sums of images left incomplete by a failed allocation */
+    for (b = 0; b < count; b++) {
+        dealloc_array_fl(P[b], m);
+        dealloc_array_fl(Q[b], m);
+    }
+    free(items);
+    free(remaining);
+    free(P);
+    free(Q);
+    free(fits);
+    free(fit_of);
+    free(Tmax);
+    if (failed) {
+        printf("Allocating the buffers of the batch failed \n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
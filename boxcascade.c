@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file boxcascade.c
+ * @brief Gaussian approximation by a cascade of extended box filters
+ **/
+
+#include "headersreq.h"
+
+/** \brief Number of box filters in the cascade */
+#define BOX_PASSES 3
+
+void box_init(spatial_kernel *kernel, float sigma);
+
+void convolve_box2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                    fft_complex **ip_padded);
+
+/**
+ * \brief Compute extended box cascade constants
+ * \param kernel    Pointer to filter constants to fill
+ * \param sigma     Gaussian kernel standard deviation
+ *
+ * Each of the BOX_PASSES boxes has radius r with an extra tap
+ * of weight alpha at distance r+1 on both sides, chosen so that
+ * the variance of the cascade is exactly sigma^2. The support of
+ * the cascade is BOX_PASSES*(r+1), which is at most 3*sigma for
+ * integer sigma; the padding width is the larger of the two.
+ */
+void box_init(spatial_kernel *kernel, float sigma) {
+    /** \brief Variance of a single box */
+    float s2 = sigma * sigma / BOX_PASSES;
+    int r = (int) floorf(0.5f * sqrtf(12.0f * s2 + 1.0f) - 0.5f);
+
+    kernel->backend = SPATIAL_BOX;
+    kernel->sigma = sigma;
+    kernel->w = max((int) ceilf(3 * sigma), BOX_PASSES * (r + 1));
+    kernel->r = r;
+    kernel->alpha = (2 * r + 1) * (s2 - r * (r + 1) / 3.0f) / (2.0f * ((r + 1) * (r + 1) - s2));
+    kernel->norm = 1.0f / (2 * r + 1 + 2 * kernel->alpha);
+}
+
+/**
+ * \brief Convolve input array with one extended box filter
+ * \param in        Pointer to input array
+ * \param out       Pointer to output array
+ * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param kernel    Filter constants
+ *
+ * This routine computes the output with a running sum over
+ * the 2r+1 central taps, so only additions are needed per
+ * element. The first and last r+1 elements, where the box
+ * does not fit, are copied from the input. The lanes are
+ * filtered one after the other, so that the running sum of
+ * each stays in registers.
+ */
+static void convolve_boxPass(const fft_complex *in, fft_complex *out, int datasize, int lanes,
+                             const spatial_kernel *kernel) {
+    const int r = kernel->r;
+    const float alpha = kernel->alpha, norm = kernel->norm;
+    fft_complex sum;
+    int i;
+
+    memcpy(out, in, (r + 1) * lanes * sizeof(fft_complex));
+    memcpy(out + (datasize - r - 1) * lanes, in + (datasize - r - 1) * lanes, (r + 1) * lanes * sizeof(fft_complex));
+
+    for (int c = 0; c < lanes; c++) {
+        const fft_complex *x = in + c;
+        fft_complex *y = out + c;
+
+        /* Sum of the 2r+1 central taps around element r+1 */
+        sum.real = 0;
+        sum.imag = 0;
+        for (i = 1; i <= 2 * r + 1; i++) {
+            sum.real += x[i * lanes].real;
+            sum.imag += x[i * lanes].imag;
+        }
+
+        /* Slide the window one element at a time */
+        for (i = r + 1; i < datasize - r - 1; i++) {
+            const fft_complex left = x[(i - r - 1) * lanes], right = x[(i + r + 1) * lanes];
+            y[i * lanes].real = norm * (sum.real + alpha * (left.real + right.real));
+            y[i * lanes].imag = norm * (sum.imag + alpha * (left.imag + right.imag));
+            sum.real += right.real - x[(i - r) * lanes].real;
+            sum.imag += right.imag - x[(i - r) * lanes].imag;
+        }
+    }
+}
+
+/**
+ * \brief Convolve input array with the 1D box cascade
+ * \param in        Pointer to input/output array
+ * \param out       Pointer to scratch array of the same size
+ * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param kernel    Filter constants
+ *
+ * The boxes are applied alternately between in and out and the
+ * result is left in in.
+ */
+void convolve_box1D(fft_complex *in, fft_complex *out, int datasize, int lanes, const spatial_kernel *kernel) {
+    fft_complex *src = in, *dst = out, *swap;
+    for (int p = 0; p < BOX_PASSES; p++) {
+        convolve_boxPass(src, dst, datasize, lanes, kernel);
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != in)
+        memcpy(in, src, datasize * lanes * sizeof(fft_complex));
+}
+
+/**
+ * \brief Apply 2D Gaussian-like filter to input image
+ *        (Extended box filter cascade)
+ * \param rows      Image height
+ * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from box_init for rows
+ * \param ky        Filter constants from box_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
+ *
+ * This routine convolves ip_padded of dimensions rows x columns
+ * in place with a cascade of extended box filters along rows
+ * and then along columns. Each box is evaluated with running
+ * sums, so the cost per pixel is a few additions independent
+ * of sigma.
+ */
+void convolve_box2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                    fft_complex **ip_padded) {
+
+    /** \brief Padding widths */
+    const int wx = kx->w, wy = ky->w;
+    symmetric_padding(rows, columns, lanes, ip_padded, wy, wx);
+    /* Convolve each row with the 1D cascade */
+    fft_complex *out_t = calloc((columns + (2 * wx)) * lanes, sizeof(fft_complex));
+    for (int i = 0; i < rows + 2 * wy; i++) {
+        convolve_box1D(ip_padded[i], out_t, columns + 2 * wx, lanes, kx);
+    }
+    free(out_t);
+    fft_complex *intemp = calloc((rows + (2 * wy)) * lanes, sizeof(fft_complex)), *outtemp = calloc(
+            (rows + (2 * wy)) * lanes, sizeof(fft_complex));
+    for (int j = wx; j < columns + wx; j++) {
+        /* Convolve each column with the 1D cascade */
+        for (int i = 0; i < rows + (2 * wy); i++) {
+            for (int l = 0; l < lanes; l++)
+                intemp[i * lanes + l] = ip_padded[i][j * lanes + l];
+        }
+        convolve_box1D(intemp, outtemp, rows + 2 * wy, lanes, ky);
+        /* Store the convolved column in row of output matrix*/
+        for (int i = 0; i < rows + (2 * wy); i++) {
+            for (int l = 0; l < lanes; l++)
+                ip_padded[i][j * lanes + l] = intemp[i * lanes + l];
+        }
+    }
+    free(intemp);
+    free(outtemp);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file budget.c
+ * @brief Fast bilateral filter within a memory budget
+ *
+ * Each thread of shiftableBF_execute_joint holds three auxiliary
+ * images of the size of the image, so the buffers grow with the
+ * number of threads. Under a memory budget the number of threads
+ * holding buffers is reduced first; when even one thread does not
+ * fit, the image is filtered in strips of rows, each extended by
+ * REGION_MARGIN filter radii above and below.
+ **/
+
+#include "headersreq.h"
+
+size_t shiftableBF_layout(int m, int n, int channels, float sigmas_x, float sigmas_y, const program_params *params,
+                          int *threads, int *rows);
+
+int shiftableBF_execute_strips(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                               float ***img, float ***outimg, const program_params *params, int threads, int rows);
+
+/**
+ * \brief Choose the threads and strips of a filter within a memory budget
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param params    Pointer to Program parameters with backend,
+ *                  threads and memory set
+ * \param threads   Number of threads holding buffers, set
+ * \param rows      Rows filtered per strip, m for the whole image,
+ *                  set
+ * \return bytes of the buffers, or 0 if they do not fit in the budget
+ *
+ * The most threads for which the buffers of the whole image fit
+ * are used. Otherwise strips are used, with the most threads for
+ * which a strip is at least as high as its two margins, down to
+ * strips of one row on one thread.
+ */
+size_t shiftableBF_layout(int m, int n, int channels, float sigmas_x, float sigmas_y, const program_params *params,
+                          int *threads, int *rows) {
+    int t;
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(params->backend, sigmas_x, &kx);
+    cache_spatial_kernel(params->backend, sigmas_y, &ky);
+
+    *rows = m;
+    for (t = max(params->threads, 1); t >= 1; t--) {
+        size_t bytes = cost_buffers(m, n, channels, kx.w, ky.w, t);
+        if (params->memory == 0 || bytes <= params->memory) {
+            *threads = t;
+            return bytes;
+        }
+    }
+
+    /* The buffers grow linearly with the rows of the strip */
+    int margin = REGION_MARGIN * ky.w;
+    for (t = max(params->threads, 1); t >= 1; t--) {
+        size_t row = cost_buffers(2, n, channels, kx.w, ky.w, t) - cost_buffers(1, n, channels, kx.w, ky.w, t);
+        size_t base = cost_buffers(1, n, channels, kx.w, ky.w, t) - row;
+        if (params->memory < base + (2 * margin + 1) * row)
+            continue;
+        int h = (int) min((params->memory - base) / row - 2 * margin, (size_t) m);
+        if (h >= 2 * margin || t == 1) {
+            *threads = t;
+            *rows = h;
+            return cost_buffers(h + 2 * margin, n, channels, kx.w, ky.w, t);
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Compute the filtered channels strip by strip
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff and backend set
+ * \param threads   Number of threads
+ * \param rows      Rows of output per strip
+ * \return Success or Failure
+ *
+ * Each strip is filtered by shiftableBF_execute_joint on a crop
+ * sharing the rows of the image, extended by REGION_MARGIN filter
+ * radii above and below, and its rows are written to outimg. The
+ * rows of the margins go to scratch rows. The result matches the
+ * filter of the whole image up to the tail of the spatial filters
+ * beyond the margins, below 0.01 grey levels.
+ */
+int shiftableBF_execute_strips(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                               float ***img, float ***outimg, const program_params *params, int threads, int rows) {
+    int i, c, status = EXIT_SUCCESS;
+    spatial_kernel ky;
+    cache_spatial_kernel(params->backend, sigmas_y, &ky);
+    int margin = REGION_MARGIN * ky.w;
+    program_params strip = *params; /** \brief Parameters of each strip, whose buffers fit in the budget */
+    strip.threads = threads;
+    strip.memory = 0;
+
+    float ***g = (float ***) calloc(channels, sizeof(float **));
+    float ***f = (float ***) calloc(channels, sizeof(float **));
+    float ***out = (float ***) calloc(channels, sizeof(float **));
+    float ***scratch = (float ***) calloc(channels, sizeof(float **));
+    for (c = 0; c < channels; c++) {
+        g[c] = (float **) calloc(rows + 2 * margin, sizeof(float *));
+        f[c] = (guide == img) ? g[c] : (float **) calloc(rows + 2 * margin, sizeof(float *));
+        out[c] = (float **) calloc(rows + 2 * margin, sizeof(float *));
+        scratch[c] = alloc_array(2 * margin, n);
+        if (scratch[c] == NULL && status == EXIT_SUCCESS) {
+            printf("Allocating %d scratch rows of width %d failed \n", 2 * margin, n);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (int y0 = 0; y0 < m && status == EXIT_SUCCESS; y0 += rows) {
+        int y1 = min(y0 + rows, m);
+        int iy0 = max(y0 - margin, 0), iy1 = min(y1 + margin, m);
+        for (c = 0; c < channels; c++) {
+            int s = 0;
+            for (i = iy0; i < iy1; i++) {
+                g[c][i - iy0] = guide[c][i];
+                f[c][i - iy0] = img[c][i];
+                out[c][i - iy0] = (i >= y0 && i < y1) ? outimg[c][i] : scratch[c][s++];
+            }
+        }
+        status = shiftableBF_execute_joint(iy1 - iy0, n, channels, sigmas_x, sigmas_y, g, f, out, &strip);
+    }
+
+    for (c = 0; c < channels; c++) {
+        if (f[c] != g[c])
+            free(f[c]);
+        free(g[c]);
+        free(out[c]);
+        dealloc_array_fl(scratch[c], 2 * margin);
+    }
+    free(g);
+    free(f);
+    free(out);
+    free(scratch);
+    return status;
+}
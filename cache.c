@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file cache.c
+ * @brief Persistent cache of range kernel coefficients and spatial
+ * filter constants, shared by successive runs through a file
+ *
+ * The file is a header followed by fixed size records. It is
+ * memory mapped read-only when opened, and records computed by the
+ * run are appended when it is closed, each with a single write on a
+ * file opened in append mode so that concurrent runs do not mix
+ * their records. The number of records is derived from the file
+ * size and a truncated last record is ignored.
+ **/
+
+#include "headersreq.h"
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** \brief Magic number at the start of a cache file */
+#define CACHE_MAGIC "FBFC"
+/** \brief Version of the cache file layout */
+#define CACHE_VERSION 2
+/** \brief Largest number of coefficients stored in a record */
+#define CACHE_MAX_COEFFS 256
+/** \brief Largest number of records computed in one run */
+#define CACHE_MAX_PENDING 64
+
+/** \brief Header of a cache file */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    /** \brief sizeof(cache_record) of the writer, layouts of other builds are rejected */
+    uint32_t record_size;
+    uint32_t reserved;
+} cache_header;
+
+/** \brief Kinds of cache records */
+enum {
+    CACHE_COEFFS = 1, CACHE_SPATIAL = 2
+};
+
+/** \brief Cache record */
+typedef struct {
+    /** \brief CACHE_COEFFS or CACHE_SPATIAL */
+    uint32_t kind;
+    union {
+        /** \brief Range kernel fit, keyed by (T, sigmar, eps) */
+        struct {
+            float T, sigmar, eps;
+            int32_t K;
+            float error;
+            float coeff[CACHE_MAX_COEFFS];
+        } fit;
+        /** \brief 1D spatial filter constants, keyed by (sigma, backend) */
+        struct {
+            float sigma;
+            int32_t backend;
+            spatial_kernel kernel;
+        } spatial;
+    } u;
+} cache_record;
+
+static char *cache_filename = NULL;
+/** \brief Records of the file, mapped read-only */
+static const cache_record *cache_mapped = NULL;
+static size_t cache_mapped_count = 0, cache_mapped_bytes = 0;
+/** \brief Records computed by this run, appended when the cache is closed */
+static cache_record cache_pending[CACHE_MAX_PENDING];
+static int cache_pending_count = 0;
+
+int cache_open(const char *filename);
+
+void cache_close(void);
+
+float cache_fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params);
+
+void cache_spatial_kernel(spatial_backend backend, float sigma, spatial_kernel *kernel);
+
+/**
+ * \brief Open the cache file and map its records
+ * \param filename  Cache file, created when the cache is closed
+ * \return Success or Failure
+ *
+ * A missing file is not an error. A file with another magic
+ * number, version or record layout is ignored and not written.
+ */
+int cache_open(const char *filename) {
+    struct stat st;
+    cache_header header;
+    int fd;
+
+    cache_close();
+    cache_filename = strdup(filename);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return EXIT_SUCCESS;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cache_header) ||
+        read(fd, &header, sizeof(header)) != sizeof(header) || memcmp(header.magic, CACHE_MAGIC, 4) != 0 ||
+        header.version != CACHE_VERSION || header.record_size != sizeof(cache_record)) {
+        printf("Ignoring cache file %s with unknown format \n", filename);
+        close(fd);
+        free(cache_filename);
+        cache_filename = NULL;
+        return EXIT_FAILURE;
+    }
+    cache_mapped_count = (st.st_size - sizeof(cache_header)) / sizeof(cache_record);
+    if (cache_mapped_count > 0) {
+        cache_mapped_bytes = st.st_size;
+        void *map = mmap(NULL, cache_mapped_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            cache_mapped_count = 0;
+            cache_mapped_bytes = 0;
+        } else
+            cache_mapped = (const cache_record *) ((const char *) map + sizeof(cache_header));
+    }
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Create the cache file with its header if it does not exist
+ * \return Success or Failure
+ *
+ * The header is written to a temporary file which is then linked
+ * to the cache file name, so that other runs never see a file
+ * without header.
+ */
+static int cache_create(void) {
+    cache_header header;
+    char *tmpname = malloc(strlen(cache_filename) + 16);
+    int fd, status = EXIT_SUCCESS;
+
+    if (access(cache_filename, F_OK) == 0) {
+        free(tmpname);
+        return EXIT_SUCCESS;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.record_size = sizeof(cache_record);
+    sprintf(tmpname, "%s.%d", cache_filename, (int) getpid());
+    fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, &header, sizeof(header)) != sizeof(header))
+        status = EXIT_FAILURE;
+    if (fd >= 0)
+        close(fd);
+    if (status == EXIT_SUCCESS && link(tmpname, cache_filename) != 0 && access(cache_filename, F_OK) != 0)
+        status = EXIT_FAILURE;
+    unlink(tmpname);
+    free(tmpname);
+    return status;
+}
+
+/**
+ * \brief Append the records computed by this run and unmap the cache
+ */
+void cache_close(void) {
+    if (cache_filename != NULL && cache_pending_count > 0 && cache_create() == EXIT_SUCCESS) {
+        int fd = open(cache_filename, O_WRONLY | O_APPEND);
+        if (fd >= 0) {
+            for (int i = 0; i < cache_pending_count; i++) {
+                if (write(fd, &cache_pending[i], sizeof(cache_record)) != sizeof(cache_record))
+                    break;
+            }
+            close(fd);
+        }
+    }
+    if (cache_mapped != NULL)
+        munmap((char *) cache_mapped - sizeof(cache_header), cache_mapped_bytes);
+    free(cache_filename);
+    cache_filename = NULL;
+    cache_mapped = NULL;
+    cache_mapped_count = 0;
+    cache_mapped_bytes = 0;
+    cache_pending_count = 0;
+}
+
+/**
+ * \brief Find a record in the mapped file or among the pending records
+ * \param probe     Record holding the kind and key to look for
+ * \return matching record or NULL
+ */
+static const cache_record *cache_find(const cache_record *probe) {
+    for (int p = 0; p < cache_pending_count + (int) cache_mapped_count; p++) {
+        const cache_record *r = (p < cache_pending_count) ? &cache_pending[p] : &cache_mapped[p - cache_pending_count];
+        if (r->kind != probe->kind)
+            continue;
+        if (r->kind == CACHE_COEFFS && r->u.fit.T == probe->u.fit.T && r->u.fit.sigmar == probe->u.fit.sigmar &&
+            r->u.fit.eps == probe->u.fit.eps)
+            return r;
+        if (r->kind == CACHE_SPATIAL && r->u.spatial.sigma == probe->u.spatial.sigma &&
+            r->u.spatial.backend == probe->u.spatial.backend)
+            return r;
+    }
+    return NULL;
+}
+
+/**
+ * \brief Remember a record computed by this run
+ * \param record    Record to append to the file on close
+ */
+static void cache_add(const cache_record *record) {
+    if (cache_filename == NULL)
+        return;
+#ifdef _OPENMP
+#pragma omp critical(fbf_cache)
+#endif
+    {
+        if (cache_pending_count < CACHE_MAX_PENDING)
+            cache_pending[cache_pending_count++] = *record;
+    }
+}
+
+/**
+ * \brief Fit the range kernel, or load the fit from the cache
+ * \param Tmax      Half period of the approximation
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the approximation error
+ * \param params    Pointer to Program parameters, T, K, coeff
+ *                  and error are filled
+ * \return Approximation error reached (Linfinity norm)
+ *
+ * Same as fourier_coefficients, with the result looked up in and
+ * added to the cache when one is open.
+ */
+float cache_fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params) {
+    cache_record probe;
+    const cache_record *hit;
+    float error;
+
+    memset(&probe, 0, sizeof(probe));
+    probe.kind = CACHE_COEFFS;
+    probe.u.fit.T = Tmax;
+    probe.u.fit.sigmar = sigmar;
+    probe.u.fit.eps = eps;
+    if (cache_filename != NULL && (hit = cache_find(&probe)) != NULL) {
+        params->T = Tmax;
+        params->K = hit->u.fit.K;
+        params->coeff = (float *) calloc(Tmax + 1, sizeof(float));
+        memcpy(params->coeff, hit->u.fit.coeff, hit->u.fit.K * sizeof(float));
+        params->error = hit->u.fit.error;
+        return hit->u.fit.error;
+    }
+
+    error = fourier_coefficients(Tmax, sigmar, eps, params);
+    if (params->K <= CACHE_MAX_COEFFS) {
+        probe.u.fit.K = params->K;
+        probe.u.fit.error = error;
+        memcpy(probe.u.fit.coeff, params->coeff, params->K * sizeof(float));
+        cache_add(&probe);
+    }
+    return error;
+}
+
+/**
+ * \brief Compute spatial filter constants, or load them from the cache
+ * \param backend   Spatial backend
+ * \param sigma     Standard deviation of the 1D Gaussian
+ * \param kernel    Pointer to filter constants to fill
+ */
+void cache_spatial_kernel(spatial_backend backend, float sigma, spatial_kernel *kernel) {
+    cache_record probe;
+    const cache_record *hit;
+
+    memset(&probe, 0, sizeof(probe));
+    probe.kind = CACHE_SPATIAL;
+    probe.u.spatial.sigma = sigma;
+    probe.u.spatial.backend = backend;
+    if (cache_filename != NULL && (hit = cache_find(&probe)) != NULL) {
+        *kernel = hit->u.spatial.kernel;
+        return;
+    }
+
+    spatial_filters[backend].init(kernel, sigma);
+    probe.u.spatial.kernel = *kernel;
+    cache_add(&probe);
+}
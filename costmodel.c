@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file costmodel.c
+ * @brief Cost of the filter on this machine, measured once per run
+ *
+ * The time of the filter is dominated by the frequencies, each of
+ * which builds and convolves the auxiliary images of the whole
+ * image, and by the max-filter. Their costs per pixel are measured
+ * on a synthetic image the first time they are needed, for each
+ * backend, number of channels and number of threads, and combined with the size of
+ * the range kernel fit and the buffers of shiftableBF_execute_joint
+ * to predict the time and peak memory of a filter.
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+
+/** \brief Side of the synthetic image timed */
+#define COST_CROP_SIZE 256
+/** \brief Number of timings, the fastest is kept */
+#define COST_REPEATS 3
+/** \brief Largest number of threads of a round timed */
+#define COST_MAX_THREADS 64
+
+/** \brief Seconds per pixel of a round of one frequency per thread, by backend, channels and threads, 0 until measured */
+static double cost_table[SPATIAL_NUM_BACKENDS][4][COST_MAX_THREADS];
+/** \brief Seconds per pixel of the max-filter of one channel, 0 until measured */
+static double cost_maxfilter_pixel;
+
+double cost_frequency(spatial_backend backend, int channels);
+
+double cost_round(spatial_backend backend, int channels, int threads);
+
+spatial_backend cost_backend(spatial_backend backend, float Tmax, float sigmar, int channels);
+
+size_t cost_buffers(int m, int n, int channels, int cx, int cy, int threads);
+
+int cost_predict(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float eps, int threads,
+                 spatial_backend backend, cost_estimate *estimate);
+
+/**
+ * \brief Time of one frequency per pixel on one thread
+ * \param backend   Spatial backend
+ * \param channels  Number of channels, 1 to 4
+ * \return seconds per pixel
+ *
+ * One frequency of shiftableBF_accumulate is timed on a synthetic
+ * COST_CROP_SIZE square image with spatial deviation 3. The cost
+ * of the recursive backends does not depend on the deviation and
+ * the one of the box cascade only slightly.
+ */
+double cost_frequency(spatial_backend backend, int channels) {
+    return cost_round(backend, channels, 1);
+}
+
+/**
+ * \brief Wall time of a round of one frequency per thread, per pixel
+ * \param backend   Spatial backend
+ * \param channels  Number of channels, 1 to 4
+ * \param threads   Number of threads
+ * \return seconds per pixel
+ *
+ * As cost_frequency, with the threads each accumulating one
+ * frequency in their own buffers at the same time, so that the
+ * parallel efficiency of the frequencies, limited by the memory
+ * bandwidth they share, is measured rather than assumed. Rounds
+ * of more than COST_MAX_THREADS threads are timed with
+ * COST_MAX_THREADS threads. HUGE_VAL is returned, and not kept,
+ * when the buffers of the timing cannot be allocated.
+ */
+double cost_round(spatial_backend backend, int channels, int threads) {
+    const int m = COST_CROP_SIZE, n = COST_CROP_SIZE, C = channels;
+    int i, j, c, r;
+    const int t = min(max(threads, 1), COST_MAX_THREADS);
+
+    if (cost_table[backend][C - 1][t - 1] > 0)
+        return cost_table[backend][C - 1][t - 1];
+
+    spatial_kernel kx;
+    cache_spatial_kernel(backend, 3, &kx);
+    int mp = m + 2 * kx.w, np = n + 2 * kx.w;
+    float ***img = (float ***) calloc(C, sizeof(float **));
+    bool failed = false;
+    for (c = 0; c < C; c++) {
+        img[c] = alloc_array(m, n);
+        failed = failed || img[c] == NULL;
+        for (i = 0; img[c] != NULL && i < m; i++) {
+            for (j = 0; j < n; j++)
+                img[c][i][j] = (float) ((i * 7 + j * 13 + c * 5) % 256);
+        }
+    }
+    float coeff[2] = {1, 1};
+
+    double best = -1;
+#ifdef _OPENMP
+    omp_set_num_threads(t);
+#pragma omp parallel shared(best, img, coeff, kx, mp, np, failed) private(r)
+#endif
+    {
+        fft_complex **F = alloc_array_complex(m, n * C), **G = alloc_array_complex(mp, np * C),
+                **H = alloc_array_complex(mp, np * C);
+        float **P = alloc_array(m, n * C), **Q = alloc_array(m, n * C);
+        bool allocated = F != NULL && G != NULL && H != NULL && P != NULL && Q != NULL;
+        if (!allocated) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            failed = true;
+        }
+        double start = 0;
+        for (r = 0; r < COST_REPEATS; r++) {
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp master
+#endif
+            start = now();
+            /* The threads still meet at the barriers when one of them failed */
+            if (allocated && !failed)
+                shiftableBF_accumulate(m, n, C, 1, 2, 0.01f, coeff, &spatial_filters[backend], &kx, &kx, img, img,
+                                       NULL, F, G, H, P, Q, NULL);
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp master
+#endif
+            {
+                double seconds = calcElapsed(start, now());
+                if (best < 0 || seconds < best)
+                    best = seconds;
+            }
+        }
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+        dealloc_array_fl(P, m);
+        dealloc_array_fl(Q, m);
+    }
+
+    for (c = 0; c < C; c++)
+        dealloc_array_fl(img[c], m);
+    free(img);
+    if (failed)
+        return HUGE_VAL;
+    cost_table[backend][C - 1][t - 1] = best / (m * n);
+    return cost_table[backend][C - 1][t - 1];
+}
+
+/**
+ * \brief Time of the max-filter per pixel of one channel
+ * \return seconds per pixel, or HUGE_VAL if the image of the timing
+ *         cannot be allocated
+ */
+static double cost_maxfilter(void) {
+    const int m = COST_CROP_SIZE, n = COST_CROP_SIZE;
+    int i, j, r;
+
+    if (cost_maxfilter_pixel > 0)
+        return cost_maxfilter_pixel;
+
+    float **img = alloc_array(m, n);
+    if (img == NULL)
+        return HUGE_VAL;
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++)
+            img[i][j] = (float) ((i * 7 + j * 13) % 256);
+    }
+    double best = -1;
+    for (r = 0; r < COST_REPEATS; r++) {
+        double start = now();
+        maxfilterfind(img, 19, 19, m, n);
+        double seconds = calcElapsed(start, now());
+        if (best < 0 || seconds < best)
+            best = seconds;
+    }
+    dealloc_array_fl(img, m);
+    cost_maxfilter_pixel = best / (m * n);
+    return cost_maxfilter_pixel;
+}
+
+/**
+ * \brief Backend used for a request, without measuring the filter
+ * \param backend   Requested backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \param Tmax      Half period of the range kernel
+ * \param sigmar    Standard deviation of range kernel
+ * \param channels  Number of channels, 1 to 4
+ * \return backend itself, select_spatial_backend for SPATIAL_AUTO
+ *         as the filters do with the estimate planning mode, or
+ *         the cheapest of all for SPATIAL_ANY
+ */
+spatial_backend cost_backend(spatial_backend backend, float Tmax, float sigmar, int channels) {
+    if (backend >= 0)
+        return backend;
+    if (backend == SPATIAL_AUTO)
+        return select_spatial_backend(Tmax, sigmar);
+    spatial_backend best = SPATIAL_DERICHE;
+    for (int b = SPATIAL_DERICHE; b < SPATIAL_NUM_BACKENDS; b++) {
+        if (cost_frequency(b, channels) < cost_frequency(best, channels))
+            best = b;
+    }
+    return best;
+}
+
+/**
+ * \brief Bytes of the buffers of shiftableBF_execute_joint
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param cx        Padding width of the auxiliary images left and right
+ * \param cy        Padding width of the auxiliary images above and below
+ * \param threads   Number of threads holding auxiliary images
+ * \return bytes of P, Q, F1 and the auxiliary images of the threads
+ *
+ * A single thread accumulates in P and Q, without private copies.
+ */
+size_t cost_buffers(int m, int n, int channels, int cx, int cy, int threads) {
+    size_t plane = (size_t) m * n * channels;
+    size_t padded = (size_t) (m + 2 * cy) * (n + 2 * cx) * channels; /** \brief Size of the padded auxiliary images */
+    size_t thread = plane * sizeof(fft_complex) + 2 * padded * sizeof(fft_complex);
+    if (threads > 1)
+        thread += 2 * plane * sizeof(float);
+    return 2 * plane * sizeof(float) + plane * sizeof(fft_complex) + threads * thread;
+}
+
+/**
+ * \brief Predict the time and peak memory of a filter
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered, 1 to 4
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param threads   Number of threads
+ * \param backend   Requested backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \param estimate  Pointer to the prediction to fill
+ * \return Success or Failure
+ *
+ * T is not known before the image is read, so the range kernel is
+ * fitted for the largest T, PIXEL_RANGE: the prediction is an upper
+ * bound for images with a smaller local dynamic range. The backend
+ * is resolved by cost_backend, as in shiftableBF_deadline. The frequencies are shared between the threads
+ * in chunks as in shiftableBF_execute_joint, each frequency of the
+ * busiest thread costing a round of the threads (see cost_round),
+ * and one more round is counted for F1, the normalization and the
+ * merge of P and Q.
+ * The bytes are those of the input and output planes and of the
+ * buffers (see cost_buffers).
+ */
+int cost_predict(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float eps, int threads,
+                 spatial_backend backend, cost_estimate *estimate) {
+    const int C = channels;
+    program_params params;
+
+    if (m < 1 || n < 1 || C < 1 || C > 4 || threads < 1) {
+        printf("Cannot predict the cost of a %d x %d image with %d channels on %d threads \n", m, n, C, threads);
+        return EXIT_FAILURE;
+    }
+    memset(&params, 0, sizeof(params));
+    float Tmax = max(PIXEL_RANGE, ceilf(3.2f * sigmar));
+    cache_fourier_coefficients(Tmax, sigmar, eps, &params);
+    free(params.coeff);
+    backend = cost_backend(backend, Tmax, sigmar, C);
+
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(backend, sigmas_x, &kx);
+    cache_spatial_kernel(backend, sigmas_y, &ky);
+
+    /* Frequencies of the busiest thread, chunks being dealt round robin */
+    int chunk = max(params.K / threads, 1);
+    int nchunks = (params.K + chunk - 1) / chunk;
+    int load = ((nchunks + threads - 1) / threads) * chunk;
+
+    estimate->K = params.K;
+    estimate->error = params.error;
+    estimate->backend = backend;
+    estimate->seconds = cost_maxfilter() * m * n * C + cost_round(backend, C, threads) * m * n * (min(load, params.K) + 1);
+    estimate->bytes = 2 * (size_t) m * n * C * sizeof(float) + cost_buffers(m, n, C, kx.w, ky.w, threads);
+    return EXIT_SUCCESS;
+}
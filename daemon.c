@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file daemon.c
+ * @brief Fast bilateral filter served over a Unix domain socket
+ *
+ * A run of FBF per image probes the cores, pins the threads, plans
+ * the filter and fits the range kernel each time. The daemon does
+ * so once: the threads are pinned at startup and the OpenMP team
+ * is kept between requests, and the plans of the last requests are
+ * kept in a least recently used list keyed by (size, channels,
+ * sigmas, sigmar, eps). A plan holds the backend and threads chosen
+ * for its key and the range kernel fit of its last T, which is
+ * reused while T does not change.
+ *
+ * Each request is one line, answered by one line:
+ *
+ *     input output sigmas sigmar eps [gray|rgb|rgba]
+ *     ok K backend hit|miss seconds
+ *
+ * or "error message"; the line "quit" stops the daemon. Paths are
+ * those of image files, relative to the directory of the daemon,
+ * and may not hold spaces. The planes of an image may instead be
+ * given in a shared memory segment (see shm_attach), which the
+ * filter reads and writes in place:
+ *
+ *     shm name width height channels f32 stride plane in out sigmas sigmar eps
+ *
+ * the samples being floats in [0, 255], stride and plane the bytes
+ * between rows and between channels, and in and out the offsets of
+ * the input and output planes in the segment.
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** \brief Number of plans kept by the daemon */
+#define DAEMON_PLANS 16
+/** \brief Longest request or reply line */
+#define DAEMON_LINE 4096
+/** \brief Longest image path or segment name of a request, as read by "%" DAEMON_PATH_FIELD "s" */
+#define DAEMON_PATH 2048
+#define DAEMON_PATH_FIELD "2047"
+
+/** \brief Plan of the daemon for one key */
+typedef struct {
+    /** \brief Key: image size, channels and filter parameters */
+    int m, n, channels;
+    float sigmas_x, sigmas_y, sigmar, eps;
+    /** \brief Range kernel fit of the last T, backend and threads */
+    program_params params;
+} daemon_plan;
+
+/** \brief Plans, from the least to the most recently used */
+static daemon_plan daemon_plans[DAEMON_PLANS];
+static int daemon_count = 0;
+
+int daemon_serve(const char *path, int cores, const program_params *params);
+
+int daemon_client(const char *path, char *const *args, const char *colour, int count, bool shared);
+
+/**
+ * \brief Find the plan of a key, adding it if missing
+ * \param key       Plan holding the key, and the requested backend
+ *                  and planning mode in params
+ * \param hit       Set to whether the plan was kept
+ * \return plan, moved to the most recently used
+ *
+ * When the list is full the least recently used plan is dropped.
+ */
+static daemon_plan *daemon_plan_find(const daemon_plan *key, bool *hit) {
+    daemon_plan plan = *key;
+    int i;
+
+    *hit = false;
+    for (i = 0; i < daemon_count; i++) {
+        const daemon_plan *p = &daemon_plans[i];
+        if (p->m == key->m && p->n == key->n && p->channels == key->channels && p->sigmas_x == key->sigmas_x &&
+            p->sigmas_y == key->sigmas_y && p->sigmar == key->sigmar && p->eps == key->eps) {
+            plan = *p;
+            *hit = true;
+            break;
+        }
+    }
+    if (!*hit && daemon_count == DAEMON_PLANS) {
+        free(daemon_plans[0].params.coeff);
+        i = 0;
+    }
+    if (*hit || daemon_count == DAEMON_PLANS) {
+        memmove(daemon_plans + i, daemon_plans + i + 1, (daemon_count - i - 1) * sizeof(daemon_plan));
+        daemon_count--;
+    }
+    daemon_plans[daemon_count] = plan;
+    return &daemon_plans[daemon_count++];
+}
+
+/**
+ * \brief Filter planes with the plan of their key
+ * \param key       Plan holding the key of the request
+ * \param filtered  Number of channels filtered
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of threads of the daemon
+ * \param defaults  Requested backend, planning mode and memory
+ *                  budget of the daemon
+ * \param reply     Reply line, filled
+ * \param start     Time the request was received
+ * \param inplace   Whether outimg is img
+ * \return Success or Failure
+ *
+ * The image is filtered as by shiftableBF_channels, with the
+ * backend and threads of its plan and, when T is the last T of the
+ * plan, its range kernel fit. Strips of a memory budget read the
+ * rows written by the strip above as margin, so an image filtered
+ * in place must fit the budget whole.
+ */
+static int daemon_execute(daemon_plan *key, int filtered, float ***img, float ***outimg, int cores,
+                          const program_params *defaults, char *reply, double start, bool inplace) {
+    bool hit;
+
+    key->params = *defaults;
+    key->params.coeff = NULL;
+    key->params.T = 0;
+    key->params.threads = max(cores, 1);
+    daemon_plan *plan = daemon_plan_find(key, &hit);
+    int status = plan_reuse(key->m, key->n, key->sigmas_x, key->sigmas_y, key->sigmar, key->eps, filtered, img,
+                            defaults->backend, &plan->params);
+    int threads, rows;
+    if (status == EXIT_SUCCESS && inplace &&
+        (shiftableBF_layout(key->m, key->n, filtered, key->sigmas_x, key->sigmas_y, &plan->params, &threads,
+                            &rows) == 0 || rows < key->m)) {
+        snprintf(reply, DAEMON_LINE, "error in place filter of strips, the output must not overlap the input\n");
+        return EXIT_FAILURE;
+    }
+    if (status == EXIT_SUCCESS)
+        status = shiftableBF_execute_channels(key->m, key->n, filtered, key->sigmas_x, key->sigmas_y, img, outimg,
+                                              &plan->params);
+    if (status != EXIT_SUCCESS)
+        snprintf(reply, DAEMON_LINE, "error filter failed\n");
+    else
+        snprintf(reply, DAEMON_LINE, "ok %d %s %s %f\n", plan->params.K, spatial_backend_name(plan->params.backend),
+                 hit ? "hit" : "miss", calcElapsed(start, now()));
+    return status;
+}
+
+/**
+ * \brief Read a colour mode
+ * \param colour    gray, rgb or rgba
+ * \param format    Channels read from and written to the image files,
+ *                  set
+ * \param channels  Number of channels, including alpha, set
+ * \param filtered  Number of channels filtered, set
+ * \return Success or Failure for an unknown mode
+ */
+static int daemon_colour(const char *colour, int *format, int *channels, int *filtered) {
+    if (strcmp(colour, "gray") == 0) {
+        *format = IMAGEIO_GRAYSCALE;
+        *channels = *filtered = 1;
+    } else if (strcmp(colour, "rgb") == 0) {
+        *format = IMAGEIO_RGB;
+        *channels = *filtered = 3;
+    } else if (strcmp(colour, "rgba") == 0) {
+        *format = IMAGEIO_RGBA;
+        *channels = 4;
+        *filtered = 3;
+    } else
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Read sigmas, sigmar and eps of a request into a key
+ * \param sigmas    sigmas, one value or sigmas_x,sigmas_y
+ * \param key       Plan receiving the key, cleared first
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param reply     Reply line, filled on failure
+ * \return Success or Failure
+ */
+static int daemon_key(const char *sigmas, daemon_plan *key, float sigmar, float eps, char *reply) {
+    memset(key, 0, sizeof(daemon_plan));
+    if (sscanf(sigmas, "%f,%f", &key->sigmas_x, &key->sigmas_y) == 1)
+        key->sigmas_y = key->sigmas_x;
+    if (!(key->sigmas_x >= 0.5f && key->sigmas_y >= 0.5f)) {
+        snprintf(reply, DAEMON_LINE, "error sigmas must be at least 0.5\n");
+        return EXIT_FAILURE;
+    }
+    if (!(sigmar > 0 && isfinite(sigmar))) {
+        snprintf(reply, DAEMON_LINE, "error sigmar must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (!(eps > 0 && isfinite(eps))) {
+        snprintf(reply, DAEMON_LINE, "error eps must be positive\n");
+        return EXIT_FAILURE;
+    }
+    key->sigmar = sigmar;
+    key->eps = eps;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Filter the image file of a request
+ * \param request   Request line
+ * \param reply     Reply line, filled
+ * \param cores     Number of threads of the daemon
+ * \param defaults  Requested backend, planning mode and memory
+ *                  budget of the daemon
+ * \return Success or Failure
+ */
+static int daemon_filter(const char *request, char *reply, int cores, const program_params *defaults) {
+    char input[DAEMON_PATH], output[DAEMON_PATH], sigmas[64], colour[16] = "gray";
+    float sr, eps;
+    int columns, rows, c, i, j;
+    double start = now();
+    daemon_plan key;
+
+    if (sscanf(request, "%" DAEMON_PATH_FIELD "s %" DAEMON_PATH_FIELD "s %63s %f %f %15s", input, output, sigmas, &sr,
+               &eps, colour) < 5) {
+        snprintf(reply, DAEMON_LINE, "error malformed request\n");
+        return EXIT_FAILURE;
+    }
+    if (daemon_key(sigmas, &key, sr, eps, reply) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    int format, filtered;
+    if (daemon_colour(colour, &format, &key.channels, &filtered) != EXIT_SUCCESS) {
+        snprintf(reply, DAEMON_LINE, "error unknown colour mode %s\n", colour);
+        return EXIT_FAILURE;
+    }
+
+    /* Planes of the image, alpha is copied */
+    float *image = (float *) read_image(&columns, &rows, input, IMAGEIO_float | IMAGEIO_PLANAR | format);
+    if (image == NULL) {
+        snprintf(reply, DAEMON_LINE, "error reading image %s failed\n", input);
+        return EXIT_FAILURE;
+    }
+    const size_t size = (size_t) rows * columns;
+    float **img[4], **out[4];
+    bool allocated = true;
+    for (c = 0; c < filtered; c++) {
+        img[c] = alloc_array(rows, columns);
+        out[c] = alloc_array(rows, columns);
+        allocated = allocated && img[c] != NULL && out[c] != NULL;
+        for (i = 0; allocated && i < rows; i++)
+            for (j = 0; j < columns; j++)
+                img[c][i][j] = image[c * size + (size_t) i * columns + j] * 255.0f;
+    }
+    key.m = rows;
+    key.n = columns;
+    int status = EXIT_FAILURE;
+    if (allocated)
+        status = daemon_execute(&key, filtered, img, out, cores, defaults, reply, start, false);
+    else
+        snprintf(reply, DAEMON_LINE, "error allocating the planes of %s failed\n", input);
+
+    for (c = 0; c < filtered; c++) {
+        for (i = 0; allocated && i < rows; i++)
+            for (j = 0; j < columns; j++)
+                image[c * size + (size_t) i * columns + j] = out[c][i][j] / 255.0f;
+        dealloc_array_fl(img[c], rows);
+        dealloc_array_fl(out[c], rows);
+    }
+    if (status == EXIT_SUCCESS &&
+        write_image(image, columns, rows, output, IMAGEIO_float | IMAGEIO_PLANAR | format, 100) != 1) {
+        snprintf(reply, DAEMON_LINE, "error writing image %s failed\n", output);
+        status = EXIT_FAILURE;
+    }
+    free(image);
+    return status;
+}
+
+/**
+ * \brief Filter the planes of a request in a shared memory segment
+ * \param request   Request line, starting with "shm"
+ * \param reply     Reply line, filled
+ * \param cores     Number of threads of the daemon
+ * \param defaults  Requested backend, planning mode and memory
+ *                  budget of the daemon
+ * \return Success or Failure
+ *
+ * The filter reads and writes the planes in the segment, through
+ * row pointers: the samples are neither copied nor converted.
+ */
+static int daemon_filter_shm(const char *request, char *reply, int cores, const program_params *defaults) {
+    char name[DAEMON_PATH], format[16], sigmas[64];
+    shm_layout in, out;
+    float sr, eps;
+    size_t bytes;
+    double start = now();
+    daemon_plan key;
+
+    if (sscanf(request, "shm %" DAEMON_PATH_FIELD "s %d %d %d %15s %zu %zu %zu %zu %63s %f %f", name, &in.width,
+               &in.height, &in.channels, format, &in.stride, &in.plane, &in.offset, &out.offset, sigmas, &sr,
+               &eps) != 12 ||
+        strcmp(format, "f32") != 0) {
+        snprintf(reply, DAEMON_LINE, "error malformed shm request\n");
+        return EXIT_FAILURE;
+    }
+    if (daemon_key(sigmas, &key, sr, eps, reply) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    out.width = in.width;
+    out.height = in.height;
+    out.channels = in.channels;
+    out.stride = in.stride;
+    out.plane = in.plane;
+
+    void *base = shm_attach(name, &bytes);
+    if (base == NULL) {
+        snprintf(reply, DAEMON_LINE, "error opening segment %s failed\n", name);
+        return EXIT_FAILURE;
+    }
+    float ***img = shm_planes(base, bytes, &in);
+    float ***outimg = shm_planes(base, bytes, &out);
+    size_t in_end = 0, out_end = 0;
+    int status = EXIT_FAILURE;
+    if (img == NULL || outimg == NULL || in.channels > 4 || shm_extent(&in, bytes, &in_end) != EXIT_SUCCESS ||
+        shm_extent(&out, bytes, &out_end) != EXIT_SUCCESS)
+        snprintf(reply, DAEMON_LINE, "error planes do not fit in segment %s\n", name);
+    else if (in.offset != out.offset && in.offset < out_end && out.offset < in_end)
+        snprintf(reply, DAEMON_LINE, "error output planes overlap the input planes\n");
+    else {
+        key.m = in.height;
+        key.n = in.width;
+        key.channels = in.channels;
+        status = daemon_execute(&key, in.channels, img, outimg, cores, defaults, reply, start,
+                                in.offset == out.offset);
+    }
+    shm_planes_free(img, in.channels);
+    shm_planes_free(outimg, out.channels);
+    shm_detach(base, bytes);
+    return status;
+}
+
+/**
+ * \brief Serve filter requests on a Unix domain socket until "quit"
+ * \param path      Path of the socket, replaced if it exists
+ * \param cores     Number of threads, pinned by the caller
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend, planning mode and memory budget
+ * \return Success or Failure
+ *
+ * The connections are served in turn, each for any number of
+ * requests; the filter of a request uses all the threads.
+ */
+int daemon_serve(const char *path, int cores, const program_params *params) {
+    struct sockaddr_un address;
+    char line[DAEMON_LINE], reply[DAEMON_LINE];
+    bool quit = false;
+    int served = 0;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Socket path %s is too long \n", path);
+        return EXIT_FAILURE;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (server < 0 || bind(server, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(server, 8) != 0) {
+        printf("Listening on %s failed \n", path);
+        if (server >= 0)
+            close(server);
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN); /* A client leaving early must not stop the daemon */
+    printf("Serving on %s with %d threads \n", path, max(cores, 1));
+    fflush(stdout);
+
+    while (!quit) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0)
+            continue;
+        FILE *stream = fdopen(client, "r");
+        while (fgets(line, sizeof(line), stream) != NULL) {
+            size_t length = strlen(line);
+            if (length > 0 && line[length - 1] != '\n' && !feof(stream)) {
+                /* The rest of an overlong request is discarded, and answered once */
+                int ch;
+                while ((ch = getc(stream)) != EOF && ch != '\n');
+                snprintf(reply, sizeof(reply), "error request longer than %d characters\n", DAEMON_LINE - 2);
+            } else if (strncmp(line, "quit", 4) == 0) {
+                snprintf(reply, sizeof(reply), "ok quit\n");
+                quit = true;
+            } else {
+                if (strncmp(line, "shm ", 4) == 0)
+                    daemon_filter_shm(line, reply, cores, params);
+                else
+                    daemon_filter(line, reply, cores, params);
+                served++;
+            }
+            if (write(client, reply, strlen(reply)) < 0 || quit)
+                break;
+        }
+        fclose(stream);
+    }
+
+    close(server);
+    unlink(path);
+    for (int i = 0; i < daemon_count; i++)
+        free(daemon_plans[i].params.coeff);
+    daemon_count = 0;
+    printf("Served %d requests \n", served);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Compare two latencies for qsort
+ * \param a         Pointer to the first latency
+ * \param b         Pointer to the second latency
+ * \return Order of the latencies
+ */
+static int daemon_compare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * \brief Send a request to a daemon repeatedly and report its latency
+ * \param path      Path of the socket of the daemon
+ * \param args      input, sigmas, sigmar, output and eps, as given to
+ *                  FBF
+ * \param colour    Colour mode, gray, rgb or rgba
+ * \param count     Number of requests sent, one after the other
+ * \param shared    Whether the planes are passed in a shared memory
+ *                  segment rather than as image files
+ * \return Success or Failure
+ *
+ * Relative image paths are made absolute, as the daemon may run in
+ * another directory. With shared, the client reads the image and
+ * writes the output itself, the daemon filtering the planes in a
+ * segment created for the requests. The median and 99th percentile
+ * of the time from sending a request to receiving its reply are
+ * printed.
+ */
+int daemon_client(const char *path, char *const *args, const char *colour, int count, bool shared) {
+    struct sockaddr_un address;
+    char request[DAEMON_LINE], reply[DAEMON_LINE], cwd[DAEMON_PATH], name[64];
+    char input[DAEMON_PATH], output[DAEMON_PATH];
+    int i, j, c, format, channels, filtered, rows, columns, status = EXIT_SUCCESS;
+    float *image = NULL;
+    void *segment = NULL;
+    shm_layout layout;
+
+    if (daemon_colour(colour, &format, &channels, &filtered) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+        strcpy(cwd, ".");
+    /* The daemon reads requests of at most DAEMON_LINE - 1 characters */
+    if (snprintf(input, sizeof(input), "%s%s%s", (args[0][0] == '/') ? "" : cwd, (args[0][0] == '/') ? "" : "/",
+                 args[0]) >= (int) sizeof(input) ||
+        snprintf(output, sizeof(output), "%s%s%s", (args[3][0] == '/') ? "" : cwd, (args[3][0] == '/') ? "" : "/",
+                 args[3]) >= (int) sizeof(output) ||
+        snprintf(request, sizeof(request), "%s %s %s %s %s %s\n", input, output, args[1], args[2], args[4],
+                 colour) >= (int) sizeof(request)) {
+        printf("Request longer than %d characters \n", DAEMON_LINE - 2);
+        return EXIT_FAILURE;
+    }
+
+    /* Input planes followed by output planes in a segment */
+    if (shared) {
+        image = (float *) read_image(&columns, &rows, args[0], IMAGEIO_float | IMAGEIO_PLANAR | format);
+        if (image == NULL) {
+            printf("Reading image %s failed \n", args[0]);
+            return EXIT_FAILURE;
+        }
+        layout.width = columns;
+        layout.height = rows;
+        layout.channels = filtered;
+        layout.stride = columns * sizeof(float);
+        layout.plane = rows * layout.stride;
+        layout.offset = 0;
+        snprintf(name, sizeof(name), "/fbf-%d", (int) getpid());
+        segment = shm_create(name, 2 * filtered * layout.plane);
+        if (segment == NULL) {
+            free(image);
+            return EXIT_FAILURE;
+        }
+        float ***planes = shm_planes(segment, 2 * filtered * layout.plane, &layout);
+        for (c = 0; c < filtered; c++)
+            for (i = 0; i < rows; i++)
+                for (j = 0; j < columns; j++)
+                    planes[c][i][j] = image[c * layout.plane / sizeof(float) + (size_t) i * columns + j] * 255.0f;
+        shm_planes_free(planes, filtered);
+        if (snprintf(request, sizeof(request), "shm %s %d %d %d f32 %zu %zu %zu %zu %s %s %s\n", name, columns,
+                     rows, filtered, layout.stride, layout.plane, (size_t) 0, filtered * layout.plane, args[1],
+                     args[2], args[4]) >= (int) sizeof(request)) {
+            printf("Request longer than %d characters \n", DAEMON_LINE - 2);
+            status = EXIT_FAILURE;
+            count = 0;
+        }
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = (status == EXIT_SUCCESS) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+    if (status == EXIT_SUCCESS && (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0)) {
+        printf("Connecting to %s failed \n", path);
+        if (fd >= 0)
+            close(fd);
+        status = EXIT_FAILURE;
+        count = 0;
+    }
+    FILE *stream = (status == EXIT_SUCCESS) ? fdopen(fd, "r") : NULL;
+
+    double *latency = (double *) calloc(max(count, 1), sizeof(double));
+    for (i = 0; i < count && status == EXIT_SUCCESS; i++) {
+        double start = now();
+        if (write(fd, request, strlen(request)) < 0 || fgets(reply, sizeof(reply), stream) == NULL) {
+            printf("Request %d failed \n", i);
+            status = EXIT_FAILURE;
+        } else if (strncmp(reply, "ok", 2) != 0) {
+            printf("Request %d: %s", i, reply);
+            status = EXIT_FAILURE;
+        }
+        latency[i] = calcElapsed(start, now());
+    }
+    if (stream != NULL)
+        fclose(stream);
+
+    if (status == EXIT_SUCCESS) {
+        qsort(latency, count, sizeof(double), daemon_compare);
+        printf("Last reply: %s", reply);
+        printf("%d requests, latency p50 %.2f ms, p99 %.2f ms, max %.2f ms \n", count,
+               1e3 * latency[(count - 1) / 2], 1e3 * latency[(int) ceil(0.99 * count) - 1],
+               1e3 * latency[count - 1]);
+    }
+    free(latency);
+
+    /* Output planes of the segment, alpha is copied from the input */
+    if (shared) {
+        layout.offset = filtered * layout.plane;
+        float ***planes = shm_planes(segment, 2 * filtered * layout.plane, &layout);
+        for (c = 0; c < filtered; c++)
+            for (i = 0; i < rows; i++)
+                for (j = 0; j < columns; j++)
+                    image[c * layout.plane / sizeof(float) + (size_t) i * columns + j] = planes[c][i][j] / 255.0f;
+        shm_planes_free(planes, filtered);
+        if (status == EXIT_SUCCESS &&
+            write_image(image, columns, rows, args[3], IMAGEIO_float | IMAGEIO_PLANAR | format, 100) != 1) {
+            printf("Writing image %s failed \n", args[3]);
+            status = EXIT_FAILURE;
+        }
+        shm_detach(segment, 2 * filtered * layout.plane);
+        shm_unlink(name);
+        free(image);
+    }
+    return status;
+}
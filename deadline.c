@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file deadline.c
+ * @brief Fast bilateral filter within a time budget
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+
+int shiftableBF_deadline(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps, float seconds);
+
+/**
+ * \brief Error of the range kernel fit truncated to its first K terms
+ * \param params    Pointer to Program parameters with the fit
+ * \param sigmar    Standard deviation of range kernel
+ * \param K         Number of terms kept
+ * \return Approximation error (Linfinity norm) over [-T, T]
+ */
+static float deadline_error(const program_params *params, float sigmar, int K) {
+    int T = (int) params->T, i, k;
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    float error = 0;
+
+    for (i = -T; i <= T; i++) {
+        float approx = 0;
+        for (k = 0; k < K; k++)
+            approx += params->coeff[k] * cosf(k * omegao * i);
+        error = max(error, fabsf(expf(-0.5f * i * i / (sigmar * sigmar)) - approx));
+    }
+    return error;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter within a time budget
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, error is set to
+ *                  the range kernel error reached
+ * \param eps       Bound on the range kernel approximation error
+ *                  when the budget allows it
+ * \param seconds   Time budget, from the call
+ * \return Success or Failure
+ *
+ * The range kernel is fitted for eps, then the time left after
+ * the max-filter and the fit is divided by the measured wall time
+ * of a round of one frequency per thread, on the threads and
+ * strips the filter will use (see cost_round and
+ * shiftableBF_layout), to find how many rounds fit in it, one
+ * round being kept for the setup and the normalization. When
+ * fewer terms than the fit
+ * are affordable, the fit is truncated, its leading coefficients
+ * being the largest. The backend is resolved by cost_backend, as
+ * in cost_predict: SPATIAL_AUTO as without a budget, SPATIAL_ANY
+ * as the cheapest one. At least one term is always computed.
+ */
+int shiftableBF_deadline(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps, float seconds) {
+    double start = now();
+    int c;
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+
+    float T = 0;
+    for (c = 0; c < channels; c++)
+        T = max(T, maxfilterfind(img[c], wy, wx, m, n));
+    float Tmax = max(T, ceilf(3.2f * sigmar));
+    cache_fourier_coefficients(Tmax, sigmar, eps, params);
+    params->threads = max(cores, 1);
+    params->backend = cost_backend(params->backend, Tmax, sigmar, channels);
+
+    /* Threads and strips of the filter, within the memory budget */
+    int threads, rows;
+    params->buffers = shiftableBF_layout(m, n, channels, sigmas_x, sigmas_y, params, &threads, &rows);
+    if (params->buffers == 0) {
+        printf("Memory budget of %zu bytes is too small for the filter \n", params->memory);
+        return EXIT_FAILURE;
+    }
+    double pixels = (double) m * n;
+    if (rows < m) {
+        /* Each strip is filtered with its margins */
+        spatial_kernel ky;
+        cache_spatial_kernel(params->backend, sigmas_y, &ky);
+        pixels = (double) ((m + rows - 1) / rows) * (rows + 2 * REGION_MARGIN * ky.w) * n;
+    }
+
+    /* Number of terms affordable in the time left */
+    double per_round = cost_round(params->backend, channels, threads) * pixels;
+    double left = seconds - calcElapsed(start, now());
+    int rounds = (int) floor(left / per_round) - 1;
+    int K = max(rounds, 1) * threads;
+    if (K < params->K) {
+        params->K = K;
+        params->error = deadline_error(params, sigmar, K);
+    }
+    return shiftableBF_execute_channels(m, n, channels, sigmas_x, sigmas_y, img, outimg, params);
+}
@@ -21,55 +21,54 @@
 
 #include "headersreq.h"
 
-void convolve_deriche2D(int rows, int columns, int sigma, fft_complex **ip_padded);
+void deriche_init(spatial_kernel *kernel, float sigma);
+
+void convolve_deriche2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                        fft_complex **ip_padded);
 
-float Nc[3], Dc[3], Na[3], Da[3], scale;
-int w;
-//float filter[w+1];
 /**
  * \brief Convolve input array with 1D Causal filter
  *        (Deriche Recursive algorithm)
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param filter    Normalized filter weights
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D Causal filter
  * of Deriche Recursive algorithm. The 1D filter is an
- * IIR filter.
+ * IIR filter. The real and imaginary parts of the lanes
+ * are filtered together by the innermost loops.
  */
-void convolve_dericheCausal(fft_complex *in, fft_complex *out, int datasize, float *filter) {
+static inline void convolve_dericheCausal(fft_complex *in, fft_complex *out, int datasize, int lanes,
+										  const float *filter, const spatial_kernel *kernel) {
 
-	int i, j;
-	fft_complex zero_complex;
-	zero_complex.imag = 0;
-	zero_complex.real = 0;
+	int i, l;
+	const int w = kernel->w, L = 2 * lanes;
+	const float *Nc = kernel->Nc, *Dc = kernel->Dc;
+	const float *x = (const float *) in;
+	float *y = (float *) out;
 	/* Compute first 3 output elements non-recursively */
-	out[w] = zero_complex;
-	for (i = 0; i < w + 1; i++) {
-		out[w].real += (filter[i] * in[i].real);
-		out[w].imag += (filter[i] * in[i].imag);
-	}
-	out[w + 1] = zero_complex;
-	for (i = 0; i < w + 1; i++) {
-		out[w + 1].real += (filter[i] * in[i + 1].real);
-		out[w + 1].imag += (filter[i] * in[i + 1].imag);
-	}
-	out[w + 2] = zero_complex;
-	for (i = 0; i < w + 1; i++) {
-		out[w + 2].real += (filter[i] * in[i + 2].real);
-		out[w + 2].imag += (filter[i] * in[i + 2].imag);
+	for (int e = w; e < w + 3; e++) {
+		for (l = 0; l < L; l++)
+			y[e * L + l] = 0;
+		for (i = 0; i < w + 1; i++) {
+			for (l = 0; l < L; l++)
+				y[e * L + l] += (filter[i] * x[(i + e - w) * L + l]);
+		}
 	}
 
 	/* Recursive computation of output in forward direction using filter parameters Nc, Dc and scale */
-	float invScale = 1.0f / scale;
+	float invScale = 1.0f / kernel->scale;
 	for (i = w + 3; i < datasize - w; i++) {
-		out[i] = zero_complex;
-		for (j = 0; j < 3; j++) {
-			out[i].real += (((Nc[j] * in[i - (2 - j)].real)* invScale));
-			out[i].imag += (((Nc[j] * in[i - (2 - j)].imag)*invScale));
-			out[i].real = (out[i].real - (Dc[j] * out[i - (3 - j)].real));
-			out[i].imag = (out[i].imag - (Dc[j] * out[i - (3 - j)].imag));
+		const float *xi = x + i * L;
+		float *yi = y + i * L;
+		for (l = 0; l < L; l++) {
+			yi[l] = (Nc[0] * xi[l - 2 * L]) * invScale - Dc[0] * yi[l - 3 * L] +
+					(Nc[1] * xi[l - L]) * invScale - Dc[1] * yi[l - 2 * L] +
+					(Nc[2] * xi[l]) * invScale - Dc[2] * yi[l - L];
 		}
 	}
 
@@ -81,45 +80,43 @@ void convolve_dericheCausal(fft_complex *in, fft_complex *out, int datasize, flo
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param filter    Normalized filter weights
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D AntiCausal filter
  * of Deriche Recursive algorithm. The 1D filter is an
  * IIR filter.
  */
-void convolve_dericheAnticausal(fft_complex *in, fft_complex *out, int datasize, float *filter) {
+static inline void convolve_dericheAnticausal(fft_complex *in, fft_complex *out, int datasize, int lanes,
+											  const float *filter, const spatial_kernel *kernel) {
 
-	int i, j;
-	fft_complex zero_complex;
-	zero_complex.imag = 0;
-	zero_complex.real = 0;
+	int i, l;
+	const int w = kernel->w, L = 2 * lanes;
+	const float *Na = kernel->Na, *Da = kernel->Da;
+	const float *x = (const float *) in;
+	float *y = (float *) out;
 	/* Compute last 3 output elements non-recursively */
-	out[datasize - 1 - w] = zero_complex;
-	for (i = 0; i < w; i++) {
-		out[datasize - 1 - w].real += (filter[i] * in[datasize - 1 - i].real);
-		out[datasize - 1 - w].imag += (filter[i] * in[datasize - 1 - i].imag);
-	}
-	out[datasize - 2 - w] = zero_complex;
-	for (i = 0; i < w; i++) {
-		out[datasize - 2 - w].real += (filter[i] * in[datasize - 2 - i].real);
-		out[datasize - 2 - w].imag += (filter[i] * in[datasize - 2 - i].imag);
-	}
-	out[datasize - 3 - w] = zero_complex;
-	for (i = 0; i < w; i++) {
-
-		out[datasize - 3 - w].real += (filter[i] * in[datasize - 3 - i].real);
-		out[datasize - 3 - w].imag += (filter[i] * in[datasize - 3 - i].imag);
+	for (int e = 1; e <= 3; e++) {
+		float *ye = y + (datasize - e - w) * L;
+		for (l = 0; l < L; l++)
+			ye[l] = 0;
+		for (i = 0; i < w; i++) {
+			for (l = 0; l < L; l++)
+				ye[l] += (filter[i] * x[(datasize - e - i) * L + l]);
+		}
 	}
 
 	/* Recursive computation of output in backward direction using filter parameters Na, Da and scale */
-	float invScale = 1.0f / scale;
+	float invScale = 1.0f / kernel->scale;
 	for (i = datasize - 4 - w; i >= w; i--) {
-		out[i] = zero_complex;
-		for (j = 0; j < 3; j++) {
-			out[i].real += ((Na[j] * in[i + (j + 1)].real)* invScale);
-			out[i].imag += ((Na[j] * in[i + (j + 1)].imag)* invScale);
-			out[i].real = (out[i].real - (Da[j] * out[i + (j + 1)].real));
-			out[i].imag = (out[i].imag - (Da[j] * out[i + (j + 1)].imag));
+		const float *xi = x + i * L;
+		float *yi = y + i * L;
+		for (l = 0; l < L; l++) {
+			yi[l] = (Na[0] * xi[l + L]) * invScale - Da[0] * yi[l + L] +
+					(Na[1] * xi[l + 2 * L]) * invScale - Da[1] * yi[l + 2 * L] +
+					(Na[2] * xi[l + 3 * L]) * invScale - Da[2] * yi[l + 3 * L];
 		}
 	}
 
@@ -131,20 +128,37 @@ void convolve_dericheAnticausal(fft_complex *in, fft_complex *out, int datasize,
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param filter    Normalized filter weights
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D Gaussian filter
  * using Deriche Recursive algorithm. The input array is separately
  * convolved with Causal and AntiCausal filters and the results are
  * added to obtain the output array.
+ * The usual lane counts are passed as constants so that the
+ * compiler unrolls the lane loops.
  */
-void convolve_deriche1D(fft_complex *in, fft_complex *out, int datasize, float *filter) {
+void convolve_deriche1D(fft_complex *in, fft_complex *out, int datasize, int lanes, const float *filter,
+						const spatial_kernel *kernel) {
 	/** \brief Array to store output of Causal filter convolution */
-	fft_complex* out_causal = (fft_complex*)calloc(datasize, sizeof(fft_complex));
-	convolve_dericheCausal(in, out_causal, datasize, filter);
-	convolve_dericheAnticausal(in, out, datasize, filter);
+	fft_complex* out_causal = (fft_complex*)calloc(datasize * lanes, sizeof(fft_complex));
+	switch (lanes) {
+		case 1:
+			convolve_dericheCausal(in, out_causal, datasize, 1, filter, kernel);
+			convolve_dericheAnticausal(in, out, datasize, 1, filter, kernel);
+			break;
+		case 3:
+			convolve_dericheCausal(in, out_causal, datasize, 3, filter, kernel);
+			convolve_dericheAnticausal(in, out, datasize, 3, filter, kernel);
+			break;
+		default:
+			convolve_dericheCausal(in, out_causal, datasize, lanes, filter, kernel);
+			convolve_dericheAnticausal(in, out, datasize, lanes, filter, kernel);
+	}
  
-	for (int i = 0; i < datasize; i++)
+	for (int i = 0; i < datasize * lanes; i++)
 	{
 		in[i].real = (out_causal[i].real + out[i].real);
 		in[i].imag = (out_causal[i].imag + out[i].imag);
@@ -153,27 +167,21 @@ void convolve_deriche1D(fft_complex *in, fft_complex *out, int datasize, float *
 }
 
 /**
- * \brief Apply 2D Gaussian filter to input image
- *        (Deriche Recursive Algorithm)
- * \param rows      Image height
- * \param columns   Image width
+ * \brief Compute Deriche filter constants
+ * \param kernel    Pointer to filter constants to fill
  * \param sigma     Gaussian kernel standard deviation
- * \param ip_padded Pointer to input image
- * \param op_padded Pointer to output image
  *
- * This routine applies 2D Gaussian filter of s.d.
- * sigma to input image ip_padded of dimensions
- * rows x columns and computes output image op_padded.
- * 1D filter is first convolved along rows and then
- * along columns. The 1D convolution is performed using
- * Deriche's fast recursive algorithm.
+ * This routine computes the causal and anticausal transfer
+ * function coefficients of Deriche's O(3) approximation of
+ * the Gaussian with s.d. sigma, and the scale that
+ * normalizes the filter to unit gain.
  */
-void convolve_deriche2D(int rows, int columns, int sigma, fft_complex **ip_padded) {
+void deriche_init(spatial_kernel *kernel, float sigma) {
 
+	kernel->backend = SPATIAL_DERICHE;
+	kernel->sigma = sigma;
 	/** \brief Filter radius */
-	w = 3 * sigma;
-	/** \brief Array to store filter weights */
-	float *filter = calloc(w + 1, sizeof(float));
+	kernel->w = (int) ceilf(3 * sigma);
 	/** \brief Impulse response parameters  */
 	float a0 = -0.8929f, a1 = 1.021f, b0 = 1.512f, w0 = 1.475f, c0 = 1.898f, b1 = 1.556f;
 
@@ -189,48 +197,90 @@ void convolve_deriche2D(int rows, int columns, int sigma, fft_complex **ip_padde
 	float n33a = -d33c * n00c;
 	float n22a = n22c - d22c * n00c;
 	float n11a = n11c - d11c * n00c;
-	Nc[0] = n22c;
-	Nc[1] = n11c;
-	Nc[2] = n00c;
-	Dc[0] = d33c;
-	Dc[1] = d22c;
-	Dc[2] = d11c;
-	Na[0] = n11a;
-	Na[1] = n22a;
-	Na[2] = n33a;
-	Da[0] = d11a;
-	Da[1] = d22a;
-	Da[2] = d33a;
+	kernel->Nc[0] = n22c;
+	kernel->Nc[1] = n11c;
+	kernel->Nc[2] = n00c;
+	kernel->Dc[0] = d33c;
+	kernel->Dc[1] = d22c;
+	kernel->Dc[2] = d11c;
+	kernel->Na[0] = n11a;
+	kernel->Na[1] = n22a;
+	kernel->Na[2] = n33a;
+	kernel->Da[0] = d11a;
+	kernel->Da[1] = d22a;
+	kernel->Da[2] = d33a;
 	/** \brief Scale to normalize filter weights */
-	scale = (Nc[0] + Nc[1] + Nc[2]) / (1 + Dc[0] + Dc[1] + Dc[2]) +
-		(Na[0] + Na[1] + Na[2]) / (1 + Da[0] + Da[1] + Da[2]);
-
-	/* Compute normalized filter weights */
+	kernel->scale = (kernel->Nc[0] + kernel->Nc[1] + kernel->Nc[2]) / (1 + kernel->Dc[0] + kernel->Dc[1] + kernel->Dc[2]) +
+		(kernel->Na[0] + kernel->Na[1] + kernel->Na[2]) / (1 + kernel->Da[0] + kernel->Da[1] + kernel->Da[2]);
+}
 
+/**
+ * \brief Compute normalized Deriche filter weights
+ * \param kernel    Filter constants
+ * \return Array of the w+1 weights, to be freed by the caller
+ *
+ * The weights are used to compute the first outputs of the
+ * causal and anticausal recursions non-recursively.
+ */
+static float *deriche_weights(const spatial_kernel *kernel) {
+	const int w = kernel->w;
+	const float sigma = kernel->sigma;
+	/** \brief Array to store filter weights */
+	float *filter = calloc(w + 1, sizeof(float));
 	for (int i = 0; i < w + 1; i++) {
 		float gnum = -(i - w) * (i - w);
 		float gden = 2 * sigma * sigma;
-		filter[i] = expf(gnum / gden) / scale;
+		filter[i] = expf(gnum / gden) / kernel->scale;
 	}
+	return filter;
+}
+
+/**
+ * \brief Apply 2D Gaussian filter to input image
+ *        (Deriche Recursive Algorithm)
+ * \param rows      Image height
+ * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from deriche_init for rows
+ * \param ky        Filter constants from deriche_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
+ *
+ * This routine applies 2D Gaussian filter to input image
+ * ip_padded of dimensions rows x columns in place.
+ * 1D filter is first convolved along rows and then
+ * along columns. The 1D convolution is performed using
+ * Deriche's fast recursive algorithm.
+ */
+void convolve_deriche2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                        fft_complex **ip_padded) {
+
+	/** \brief Filter radii, equal to the padding widths */
+	const int wx = kx->w, wy = ky->w;
+	/* Compute normalized filter weights */
+	float *filter_x = deriche_weights(kx), *filter_y = deriche_weights(ky);
 
 	/* Symmetric padding of input image with padding width equal to the filter radius w */
-	symmetric_padding(rows, columns, ip_padded, w);
+	symmetric_padding(rows, columns, lanes, ip_padded, wy, wx);
 
 	/* Convolve each row with 1D Gaussian filter */
-	fft_complex *out_t = calloc(columns + (2 * w), sizeof(fft_complex));
-	for (int i = 0; i < rows + 2 * w; i++) convolve_deriche1D(ip_padded[i], out_t, columns + 2 * w, filter);
+	fft_complex *out_t = calloc((columns + (2 * wx)) * lanes, sizeof(fft_complex));
+	for (int i = 0; i < rows + 2 * wy; i++)
+		convolve_deriche1D(ip_padded[i], out_t, columns + 2 * wx, lanes, filter_x, kx);
 	free(out_t);
-	fft_complex *intemp = calloc(rows + (2 * w), sizeof(fft_complex)), *outtemp = calloc(rows + (2 * w),
-		sizeof(fft_complex));
-	for (int j = w; j < columns + w; j++) {
+	fft_complex *intemp = calloc((rows + (2 * wy)) * lanes, sizeof(fft_complex)), *outtemp = calloc(
+		(rows + (2 * wy)) * lanes, sizeof(fft_complex));
+	for (int j = wx; j < columns + wx; j++) {
 		/* Convolve each column with 1D Gaussian filter */
-		for (int i = 0; i < rows + (2 * w); i++) intemp[i] = ip_padded[i][j];
-		convolve_deriche1D(intemp, outtemp, rows + 2 * w, filter);
+		for (int i = 0; i < rows + (2 * wy); i++)
+			for (int l = 0; l < lanes; l++) intemp[i * lanes + l] = ip_padded[i][j * lanes + l];
+		convolve_deriche1D(intemp, outtemp, rows + 2 * wy, lanes, filter_y, ky);
 		/* Store the convolved column in row of output matrix*/
-		for (int i = 0; i < rows + (2 * w); i++) ip_padded[i][j] = intemp[i];
+		for (int i = 0; i < rows + (2 * wy); i++)
+			for (int l = 0; l < lanes; l++) ip_padded[i][j * lanes + l] = intemp[i * lanes + l];
 	}
-	free(filter);
+	free(filter_x);
+	free(filter_y);
 	free(intemp);
 	free(outtemp);
 }
-
@@ -21,8 +21,30 @@
 #include "headersreq.h"
 
 int
-shiftableBF(int m, int n, int sigmas, float sigmar, float **img, float **outimg, int cores, program_params *params,
-            float eps);
+shiftableBF(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float **img, float **outimg, int cores,
+            program_params *params, float eps);
+
+float fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params);
+
+int shiftableBF_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps);
+
+int shiftableBF_execute(int m, int n, float sigmas_x, float sigmas_y, float **img, float **outimg,
+                        const program_params *params);
+
+int shiftableBF_execute_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img,
+                                 float ***outimg, const program_params *params);
+
+int shiftableBF_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***guide,
+                      float ***img, float ***outimg, int cores, program_params *params, float eps);
+
+int shiftableBF_execute_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                              float ***img, float ***outimg, const program_params *params);
+
+void shiftableBF_accumulate(int m, int n, int channels, int k0, int k1, float omegao, const float *coff,
+                            const spatial_filter *spatial, const spatial_kernel *kx, const spatial_kernel *ky,
+                            float ***guide, float ***img, fft_complex **F1, fft_complex **F, fft_complex **G,
+                            fft_complex **H, float **P_k, float **Q_k, const reduced_grid *low);
 
 /**
  * \brief Calculate norm of vector
@@ -42,37 +64,20 @@ float norm(float *a, int n) {
 }
 
 /**
- * \brief Apply fast shiftable bilateral filter to input image
- * \param m         Image height
- * \param n         Image width
- * \param sigmas    Standard deviation of spatial kernel
+ * \brief Fit the Fourier approximation of the range kernel
+ * \param Tmax      Half period of the approximation
  * \param sigmar    Standard deviation of range kernel
- * \param img       Pointer to input image
- * \param outimg    Pointer to output image
- * \param cores     Number of physical cores on system
- * \param params    Pointer to Program parameters like
- *                  coefficients
+ * \param eps       Bound on the approximation error
+ * \param params    Pointer to Program parameters, T, K, coeff
+ *                  and error are filled
+ * \return Approximation error reached (Linfinity norm)
  *
- * This routine applies the fast shiftable bilateral filter
- * with parameters sigmas & sigmar to input image img of
- * dimensions m x n and computes output image outimg.
- * The algorithm used is Fourier Basis approximation.
- * The Gaussian spatial convolutions are performed using
- * 'Deriche' or 'Young and van Vliet' fast recursive algorithms,
- * dpending on sigmar and maximum local dynamic range of the image.
- * The convolutions are performed parallelly with one thread
- * assigned for each physical core on the system.
+ * This routine adds DFT coefficients of the Gaussian range
+ * kernel on [-Tmax,Tmax] until the approximation error is
+ * less than eps or Tmax+1 coefficients are used.
  */
-int
-shiftableBF(int m, int n, int sigmas, float sigmar, float **img, float **outimg, int cores, program_params *params,
-            float eps) {
-    int i, j, k;
-    int w = 6 * sigmas + 1; /** \brief Filter width */
-    int c = (w - 1) / 2; /** \brief Filter radius */
-
-    /* Fourier Basis Algorithm */
-    float T = maxfilterfind(img, w, m, n); /* Finding maximum local dynamic range which is image independent */
-    float Tmax = max(T, ceilf(3.2f * sigmar)); /* New half period of the filter */
+float fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params) {
+    int i;
     params->T = Tmax;
     int K = (int) (2 * Tmax + 1); /* Period = 2*Tmax+1 */
     float a1 = (1 / (2 * Tmax + 1));
@@ -123,184 +128,456 @@ shiftableBF(int m, int n, int sigmas, float sigmar, float **img, float **outimg,
     free(kernel);
 
     params->K = Kapprox;
-    params->coeff = (float *) calloc(Kapprox, sizeof(float));
-    for (i = 0; i < Kapprox; i++) params->coeff[i] = coff[i];
+    params->coeff = coff;
+    params->error = approxerror;
+    return approxerror;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to input image
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to input image
+ * \param outimg    Pointer to output image
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ *
+ * This routine applies the fast shiftable bilateral filter
+ * with parameters sigmas_x, sigmas_y & sigmar to input image img of
+ * dimensions m x n and computes output image outimg.
+ * The algorithm used is Fourier Basis approximation.
+ * The Gaussian spatial convolutions are performed with the
+ * backend requested in params->backend. With SPATIAL_AUTO,
+ * 'Deriche' or 'Young and van Vliet' fast recursive algorithms
+ * are used, dpending on sigmar and maximum local dynamic range
+ * of the image. With params->planning set to PLAN_MEASURE the
+ * backend and the number of threads are instead chosen by
+ * timing the candidates (see plan_measure).
+ * The convolutions are performed parallelly with one thread
+ * assigned for each physical core on the system.
+ */
+int
+shiftableBF(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float **img, float **outimg, int cores,
+            program_params *params, float eps) {
+    return shiftableBF_channels(m, n, 1, sigmas_x, sigmas_y, sigmar, &img, &outimg, cores, params, eps);
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a multi-channel image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Same as shiftableBF for each channel, with the planning
+ * shared: T is the largest over the channels, and the range
+ * kernel is fitted and the backend chosen once.
+ */
+int shiftableBF_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps) {
+    return shiftableBF_joint(m, n, channels, sigmas_x, sigmas_y, sigmar, img, img, outimg, cores, params, eps);
+}
+
+/**
+ * \brief Apply fast shiftable joint bilateral filter
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The range weights are computed from the guide and applied
+ * to img: channel c of the output is the average of img[c]
+ * weighted by the spatial kernel and by the range kernel of
+ * differences in guide[c]. T is found on the guide. With
+ * guide equal to img this is shiftableBF_channels.
+ */
+int shiftableBF_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***guide,
+                      float ***img, float ***outimg, int cores, program_params *params, float eps) {
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+
+    /* Fourier Basis Algorithm */
+    float T = 0;
+    for (int c = 0; c < channels; c++) /* Finding maximum local dynamic range which is image independent */
+        T = max(T, maxfilterfind(guide[c], wy, wx, m, n));
+    float Tmax = max(T, ceilf(3.2f * sigmar)); /* New half period of the filter */
+    cache_fourier_coefficients(Tmax, sigmar, eps, params);
     /* End of algorithm for finding appropripriate number of DFT coefficients for range kernel approximation */
     /*******************************************************************************************************************/
 
-    /* Computation of Filtered image */
-    float **P = alloc_array(m, n); /** \brief Matrix to store unnormalized filtered image */
-    float **Q = alloc_array(m, n); /** \brief Matrix to store weight sums for normalization */
+    params->threads = cores;
+    if (params->planning == PLAN_MEASURE) {
+        /* Backend and thread count from wisdom, or from timing the candidates */
+        if (plan_measure(m, n, sigmas_x, sigmas_y, channels, guide, params) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    } else if (params->backend < 0) {
+        /* Spatial backend: algo decided by ratio Tmax/sigmar unless one was requested */
+        params->backend = select_spatial_backend(Tmax, sigmar);
+    }
+    int threads, rows;
+    params->buffers = shiftableBF_layout(m, n, channels, sigmas_x, sigmas_y, params, &threads, &rows);
+    return shiftableBF_execute_joint(m, n, channels, sigmas_x, sigmas_y, guide, img, outimg, params);
+}
 
-    fft_complex temp;
-    temp.imag = (omegao * 1.0f);
-    temp.real = (omegao * 0.0f);
-    fft_complex **F1 = alloc_array_complex(m + w - 1, n + w - 1);
+/**
+ * \brief Compute the filtered image from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to input image
+ * \param outimg    Pointer to output image
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ */
+int shiftableBF_execute(int m, int n, float sigmas_x, float sigmas_y, float **img, float **outimg,
+                        const program_params *params) {
+    return shiftableBF_execute_channels(m, n, 1, sigmas_x, sigmas_y, &img, &outimg, params);
+}
 
+/**
+ * \brief Compute the filtered channels from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ */
+int shiftableBF_execute_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img,
+                                 float ***outimg, const program_params *params) {
+    return shiftableBF_execute_joint(m, n, channels, sigmas_x, sigmas_y, img, img, outimg, params);
+}
+
+/**
+ * \brief Compute the joint filtered channels from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ *
+ * This routine computes the auxiliary images for each of the
+ * K frequencies, convolves them with the spatial backend and
+ * accumulates the numerator P and the normalization Q of the
+ * output. The frequencies are split in contiguous chunks, one
+ * per thread; the first auxiliary image of a chunk is computed
+ * directly and the following ones recursively.
+ * F and G are computed from the guide and H from img times G.
+ * The values of the channels are interleaved in the auxiliary
+ * images, P and Q (element j*channels+c of a row), so that one
+ * convolution filters all the channels.
+ * With a memory budget in params, fewer threads or strips of
+ * the image are used (see shiftableBF_layout), and a single
+ * thread accumulates in P and Q directly.
+ */
+int shiftableBF_execute_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                              float ***img, float ***outimg, const program_params *params) {
+    int i, j, k, c;
+    const int C = channels;
+    int Kapprox = params->K;
+    const float *coff = params->coeff;
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    const spatial_filter *spatial = &spatial_filters[params->backend];
+    spatial_kernel kx, ky; /** \brief Spatial filter constants along rows and columns, shared by all threads */
+    cache_spatial_kernel(params->backend, sigmas_x, &kx);
+    cache_spatial_kernel(params->backend, sigmas_y, &ky);
+    int cx = kx.w, cy = ky.w; /** \brief Padding widths of the auxiliary images */
+    int mp = m + 2 * cy, np = n + 2 * cx; /** \brief Size of the padded auxiliary images */
+
+    /* Threads holding buffers, and strips, within the memory budget */
+    int threads, rows;
+    if (shiftableBF_layout(m, n, C, sigmas_x, sigmas_y, params, &threads, &rows) == 0) {
+        printf("Memory budget of %zu bytes is too small for the filter \n", params->memory);
+        return EXIT_FAILURE;
+    }
+    if (rows < m)
+        return shiftableBF_execute_strips(m, n, C, sigmas_x, sigmas_y, guide, img, outimg, params, threads, rows);
+
+    /* Computation of Filtered image */
+    float **P = alloc_array(m, n * C); /** \brief Matrix to store unnormalized filtered image */
+    float **Q = alloc_array(m, n * C); /** \brief Matrix to store weight sums for normalization */
+
+    fft_complex **F1 = alloc_array_complex(m, n * C);
+    if (P == NULL || Q == NULL || F1 == NULL) {
+        printf("Allocating the buffers of the filter failed \n");
+        dealloc_array_fl(P, m);
+        dealloc_array_fl(Q, m);
+        dealloc_array_fl_complex(F1, m);
+        return EXIT_FAILURE;
+    }
 
     /** \brief Recursive parameter/basis matrix F1 for frequency omegao, required to compute Auxiliary images */
     for (i = 0; i < m; i++) {
         for (j = 0; j < n; j++) {
-            float R = expf((img[i][j] * temp.real));
-            float tmp_imag = (img[i][j] * temp.imag);
-
-            F1[i + c][j + c].imag = R * sinf(tmp_imag);
-            F1[i + c][j + c].real = R * cosf(tmp_imag);
-
+            for (c = 0; c < C; c++) {
+                F1[i][j * C + c].real = cosf(omegao * guide[c][i][j]);
+                F1[i][j * C + c].imag = sinf(omegao * guide[c][i][j]);
+            }
         }
     }
-#ifdef _OPENMP
-    /* The auxiliary images are convolved with spatial Gaussian parallelly */
-    int tid, procid;
-    int chunk = (int) (Kapprox) / cores; /** \brief Number of iterations assigned to each thread at fork */
+    /** \brief Number of iterations assigned to each thread at fork */
+    int chunk = Kapprox / threads;
     if (chunk == 0)
         chunk = 1; /* Auxillary image recursion is not required . So exp(I*omegao*k*img[i][j] has to be found for every k*/
+    int nchunks = (Kapprox + chunk - 1) / chunk;
+    bool failed = false; /** \brief Whether a thread could not allocate its buffers */
+#ifdef _OPENMP
+    /* The auxiliary images are convolved with spatial Gaussian parallelly */
     /* one thread per physical core */
-    omp_set_num_threads(cores);
-#pragma omp parallel shared(chunk, Kapprox, m, n, c, w, sigmas, P, Q, img, F1, coff, omegao) private(k, i, j, tid, procid)
+    omp_set_num_threads(threads);
+#pragma omp parallel shared(chunk, nchunks, Kapprox, m, n, cx, cy, mp, np, spatial, kx, ky, P, Q, guide, img, F1, coff, omegao, threads, failed) private(k, i, j)
 #endif
     {
-#ifdef _OPENMP
-        tid = omp_get_thread_num();
-#ifdef HAVE_SCHED_GETCPU
-        procid = sched_getcpu();
-#else
-        procid = 0;
-#endif
-#endif
         /** \brief Matrices for Auxiliary images */
-        fft_complex **F = alloc_array_complex(m + w - 1, n + w - 1), **G = alloc_array_complex(m + w - 1, n + w -
-                                                                                                          1), **H = alloc_array_complex(
-                m + w - 1, n + w - 1);
+        fft_complex **F = alloc_array_complex(m, n * C), **G = alloc_array_complex(mp, np * C),
+                **H = alloc_array_complex(mp, np * C);
+        /** \brief P and Q private to thread, shared when it is alone */
+        float **P_k = (threads > 1) ? alloc_array(m, n * C) : P, **Q_k = (threads > 1) ? alloc_array(m, n * C) : Q;
+        bool allocated = F != NULL && G != NULL && H != NULL && P_k != NULL && Q_k != NULL;
+        if (!allocated) {
 #ifdef _OPENMP
-        /** \brief P and Q private to thread */
-        float **P_k = alloc_array(m, n), **Q_k = alloc_array(m, n);
-
-        fft_complex tmp;
-        tmp.imag = (omegao * 1.0f);
-        tmp.real = (omegao * 0.0f);
-#pragma omp for schedule(static, chunk) nowait
+#pragma omp critical
 #endif
-        for (k = 0; k < Kapprox; k++) {
-            /* Compute auxiliary images */
-#ifdef _OPENMP
+            failed = true;
+        }
 
-            if (k % chunk == 0) {
-                for (i = 0; i < m; i++) {
-                    for (j = 0; j < n; j++) {
-                        float R = expf((img[i][j] * tmp.real));
-                        float tmp_imag = (img[i][j] * tmp.imag);
-                        F[i + c][j + c].real = R * cosf(tmp_imag);
-                        F[i + c][j + c].imag = R * sinf(tmp_imag);
-
-                        G[i + c][j + c].real = F[i + c][j + c].real;
-                        G[i + c][j + c].imag = -F[i + c][j + c].imag;
-                        H[i + c][j + c].real = (img[i][j] * G[i + c][j + c].real);
-                        H[i + c][j + c].imag = (img[i][j] * G[i + c][j + c].imag);
-                    }
-                }
-#else
-                fft_complex val  ;
-                v.real = 1.0f;
-                v.imag = 0.0f;
-                if (k == 0) {
-                    for (i = 0; i < m; i++)
-                    {
-                        for (j = 0; j < n; j++)
-                        {
-                            F[i + c][j + c] = val;
-                            G[i + c][j + c] = val;
-                            H[i + c][j + c].real = (img[i][j] * G[i + c][j + c].real);
-                            H[i + c][j + c].imag = (img[i][j] * G[i + c][j + c].imag);
-                        }
-                    }
+#ifdef _OPENMP
+#pragma omp for schedule(static, 1) nowait
 #endif
-            } else {
-
+        for (k = 0; k < nchunks; k++) {
+            if (!allocated)
+                continue;
+            shiftableBF_accumulate(m, n, C, k * chunk, min(Kapprox, (k + 1) * chunk), omegao, coff, spatial, &kx, &ky,
+                                   guide, img, F1, F, G, H, P_k, Q_k, NULL);
+        }
 
+        /* Compute global P and Q from their private versions */
+        if (threads > 1 && allocated) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
                 for (i = 0; i < m; i++) {
-                    for (j = 0; j < n; j++) {
-                        F[i + c][j + c].real = F[i + c][j + c].real * F1[i + c][j + c].real -
-                                               F[i + c][j + c].imag * F1[i + c][j + c].imag;
-                        F[i + c][j + c].imag = F[i + c][j + c].real * F1[i + c][j + c].imag +
-                                               F[i + c][j + c].imag * F1[i + c][j + c].real;
-                        G[i + c][j + c].real = F[i + c][j + c].real;
-                        G[i + c][j + c].imag = -F[i + c][j + c].imag;
-                        H[i + c][j + c].real = (img[i][j] * G[i + c][j + c].real);
-                        H[i + c][j + c].imag = (img[i][j] * G[i + c][j + c].imag);
+                    for (j = 0; j < n * C; j++) {
+                        P[i][j] += P_k[i][j];
+                        Q[i][j] += Q_k[i][j];
                     }
                 }
             }
 
-            /* Gaussian filter applied to auxiliary images, algo decided by ratio Tmax/sigmar */
-            if ((Tmax / sigmar) < 3.5) {
-                convolve_deriche2D(m, n, sigmas, H);
-                convolve_deriche2D(m, n, sigmas, G);
+        }
+        if (threads > 1) {
+            /* Deallocate thread private matrices */
+            dealloc_array_fl(P_k, m);
+            dealloc_array_fl(Q_k, m);
+        }
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+    }
 
-            } else {
-                convolve_young2D(m, n, sigmas, H);
-                convolve_young2D(m, n, sigmas, G);
+    dealloc_array_fl_complex(F1, m);
+    if (failed) {
+        printf("Allocating the buffers of the filter failed \n");
+        dealloc_array_fl(P, m);
+        dealloc_array_fl(Q, m);
+        return EXIT_FAILURE;
+    }
+    /* Compute Output Image from P and Q */
+    for (c = 0; c < C; c++) {
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                if (fabsf((Q[i][j * C + c])) <= 0.001f)
+                    outimg[c][i][j] = img[c][i][j];
+                else
+                    outimg[c][i][j] = (P[i][j * C + c] / Q[i][j * C + c]);
             }
-            /* Update P and Q */
-#ifdef _OPENMP
+        }
+    }
+
+    dealloc_array_fl(P, m);
+    dealloc_array_fl(Q, m);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Accumulate the contribution of a range of frequencies
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param k0        First frequency
+ * \param k1        Frequency after the last one
+ * \param omegao    Fundamental frequency 2*pi/(2*T+1)
+ * \param coff      Coefficients of the range kernel fit
+ * \param spatial   Spatial backend
+ * \param kx        Spatial filter constants along rows
+ * \param ky        Spatial filter constants along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param F1        exp(I*omegao*guide), m x n*channels, used when
+ *                  there is more than one frequency
+ * \param F         Auxiliary image, m x n*channels
+ * \param G         Auxiliary image, padded by kx->w and ky->w
+ * \param H         Auxiliary image, padded by kx->w and ky->w
+ * \param P_k       Unnormalized filtered image to add to
+ * \param Q_k       Weight sums to add to
+ * \param low       Reduced grid of the convolutions, or NULL to
+ *                  convolve at full size
+ *
+ * F is computed directly for k0 and recursively from F1 for the
+ * following frequencies. The values of the channels are
+ * interleaved (element j*channels+c of a row). With a reduced
+ * grid, G = exp(-I*omegao*k*guide) and H = img*G are computed from
+ * its planes, and the convolved G and H are interpolated
+ * bilinearly, one reduced row at a time, before multiplying by F.
+ */
+void shiftableBF_accumulate(int m, int n, int channels, int k0, int k1, float omegao, const float *coff,
+                            const spatial_filter *spatial, const spatial_kernel *kx, const spatial_kernel *ky,
+                            float ***guide, float ***img, fft_complex **F1, fft_complex **F, fft_complex **G,
+                            fft_complex **H, float **P_k, float **Q_k, const reduced_grid *low) {
+    int i, j, k, c;
+    const int C = channels;
+    int cx = kx->w, cy = ky->w;
+    const int ml = (low != NULL) ? low->m : m, nl = (low != NULL) ? low->n : n; /** \brief Size of the convolutions */
+    /** \brief Rows of the convolved G and H interpolated along columns */
+    fft_complex *g_row = NULL, *h_row = NULL;
+    if (low != NULL) {
+        g_row = (fft_complex *) calloc(nl * C, sizeof(fft_complex));
+        h_row = (fft_complex *) calloc(nl * C, sizeof(fft_complex));
+    }
 
-            fft_complex t;
+    for (k = k0; k < k1; k++) {
+        /* Compute auxiliary images */
+        if (k == k0) {
+            /* First frequency: F = exp(I*omegao*k*guide) */
             for (i = 0; i < m; i++) {
                 for (j = 0; j < n; j++) {
-                    t.real = coff[k] * F[i + c][j + c].real;
-                    t.imag = coff[k] * F[i + c][j + c].imag;
-                    P_k[i][j] += t.real * H[i + c][j + c].real - t.imag * H[i + c][j + c].imag;
-                    Q_k[i][j] += t.real * G[i + c][j + c].real - t.imag * G[i + c][j + c].imag;
+                    for (c = 0; c < C; c++) {
+                        float phase = (k * omegao) * guide[c][i][j];
+                        F[i][j * C + c].real = cosf(phase);
+                        F[i][j * C + c].imag = sinf(phase);
+                    }
+                }
+            }
+        } else {
+            /* Following frequencies: F = F * F1 */
+            for (i = 0; i < m; i++) {
+                fft_complex *f = F[i], *f1 = F1[i];
+                for (j = 0; j < n * C; j++) {
+                    float real = f[j].real;
+                    f[j].real = real * f1[j].real - f[j].imag * f1[j].imag;
+                    f[j].imag = real * f1[j].imag + f[j].imag * f1[j].real;
                 }
             }
         }
-
-        /* Compute global P and Q from their private versions */
-#pragma omp critical
-        {
+        if (low == NULL) {
             for (i = 0; i < m; i++) {
                 for (j = 0; j < n; j++) {
-                    P[i][j] += P_k[i][j];
-                    Q[i][j] += Q_k[i][j];
+                    for (c = 0; c < C; c++) {
+                        const int jc = (j + cx) * C + c;
+                        G[i + cy][jc].real = F[i][j * C + c].real;
+                        G[i + cy][jc].imag = -F[i][j * C + c].imag;
+                        H[i + cy][jc].real = (img[c][i][j] * G[i + cy][jc].real);
+                        H[i + cy][jc].imag = (img[c][i][j] * G[i + cy][jc].imag);
+                    }
+                }
+            }
+        } else {
+            /* Reduced G = exp(-I*omegao*k*guide) and H = img*G */
+            for (i = 0; i < ml; i++) {
+                for (j = 0; j < nl; j++) {
+                    for (c = 0; c < C; c++) {
+                        const int jc = (j + cx) * C + c;
+                        float phase = (k * omegao) * low->guide[c][i][j];
+                        G[i + cy][jc].real = cosf(phase);
+                        G[i + cy][jc].imag = -sinf(phase);
+                        H[i + cy][jc].real = low->img[c][i][j] * G[i + cy][jc].real;
+                        H[i + cy][jc].imag = low->img[c][i][j] * G[i + cy][jc].imag;
+                    }
                 }
             }
         }
 
-        /* Deallocate thread private matrices */
-        dealloc_array_fl(P_k, m);
-        dealloc_array_fl(Q_k, m);
-#else
-        for (i = 0; i < m; i++)
-        {
-            fft_complex t;
-        for (j=0;j<n;j++)
-        {
-            t.real = coff[k] * F[i + c][j + c].real;
-            t.imag = coff[k] * F[i + c][j + c].imag;
-            P[i][j] += t.real * H[i + c][j + c].real - t.imag * H[i + c][j + c].imag;
-            Q[i][j] += t.real * G[i + c][j + c].real - t.imag * G[i + c][j + c].imag;
-        }
-    }
-}
-#endif
-        dealloc_array_fl_complex(F, m + w - 1);
-        dealloc_array_fl_complex(G, m + w - 1);
-        dealloc_array_fl_complex(H, m + w - 1);
-    }
+        /* Gaussian filter applied to auxiliary images */
+        spatial->convolve2D(ml, nl, C, kx, ky, H);
+        spatial->convolve2D(ml, nl, C, kx, ky, G);
 
-    dealloc_array_fl_complex(F1, m + w - 1);
-    free(coff);
-    /* Compute Output Image from P and Q */
-    for (i = 0; i < m; i++) {
-        for (j = 0; j < n; j++) {
-            if (fabsf((Q[i][j])) <= 0.001f)
-                outimg[i][j] = img[i][j];
-            else
-                outimg[i][j] = (P[i][j] / Q[i][j]);
+        /* Update P and Q */
+        fft_complex t;
+        if (low == NULL) {
+            for (i = 0; i < m; i++) {
+                const fft_complex *f = F[i], *g = G[i + cy] + cx * C, *h = H[i + cy] + cx * C;
+                for (j = 0; j < n * C; j++) {
+                    t.real = coff[k] * f[j].real;
+                    t.imag = coff[k] * f[j].imag;
+                    P_k[i][j] += t.real * h[j].real - t.imag * h[j].imag;
+                    Q_k[i][j] += t.real * g[j].real - t.imag * g[j].imag;
+                }
+            }
+        } else {
+            /* Interpolate the convolved G and H to full size, first along columns */
+            for (i = 0; i < m; i++) {
+                const int i0 = low->iy[i], i1 = min(i0 + 1, ml - 1);
+                const fft_complex *g0 = G[i0 + cy] + cx * C, *g1 = G[i1 + cy] + cx * C;
+                const fft_complex *h0 = H[i0 + cy] + cx * C, *h1 = H[i1 + cy] + cx * C;
+                const float a = low->ay[i];
+                for (j = 0; j < nl * C; j++) {
+                    g_row[j].real = g0[j].real + a * (g1[j].real - g0[j].real);
+                    g_row[j].imag = g0[j].imag + a * (g1[j].imag - g0[j].imag);
+                    h_row[j].real = h0[j].real + a * (h1[j].real - h0[j].real);
+                    h_row[j].imag = h0[j].imag + a * (h1[j].imag - h0[j].imag);
+                }
+                for (j = 0; j < n; j++) {
+                    const int l0 = low->ix[j] * C, l1 = min(low->ix[j] + 1, nl - 1) * C;
+                    const float b = low->ax[j];
+                    for (c = 0; c < C; c++) {
+                        t = F[i][j * C + c];
+                        float gr = g_row[l0 + c].real + b * (g_row[l1 + c].real - g_row[l0 + c].real);
+                        float gi = g_row[l0 + c].imag + b * (g_row[l1 + c].imag - g_row[l0 + c].imag);
+                        float hr = h_row[l0 + c].real + b * (h_row[l1 + c].real - h_row[l0 + c].real);
+                        float hi = h_row[l0 + c].imag + b * (h_row[l1 + c].imag - h_row[l0 + c].imag);
+                        P_k[i][j * C + c] += coff[k] * (t.real * hr - t.imag * hi);
+                        Q_k[i][j * C + c] += coff[k] * (t.real * gr - t.imag * gi);
+                    }
+                }
+            }
         }
     }
-
-    dealloc_array_fl(P, m);
-    dealloc_array_fl(Q, m);
-    return EXIT_SUCCESS;
+    free(g_row);
+    free(h_row);
 }
@@ -8,6 +8,354 @@
 
 #include "headersreq.h"
 #include "timing.h"
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** \brief Largest number of sigmas or sigmar values of a sweep */
+#define SWEEP_MAX 32
+
+/** \brief Side of the tiles of a sharded filter without -t */
+#define SHARD_TILE 1024
+
+/** \brief Where the outputs of a parameter sweep, or the results of a progressive filter, are written */
+typedef struct {
+    const char *output;
+    int rows, columns, channels, filtered, format;
+    const float *input_image;
+    const float *sigmas_x, *sigmas_y, *sigmar;
+} sweep_files;
+
+/** \brief What a run of FBF does, chosen from its options and positional arguments */
+typedef enum {
+    /** \brief Shard worker, -W */
+    RUN_WORKER = 0,
+    /** \brief Daemon serving requests, -D */
+    RUN_DAEMON,
+    /** \brief Client sending requests to a daemon, -C */
+    RUN_CLIENT,
+    /** \brief Directory or list file of images */
+    RUN_BATCH,
+    /** \brief Raw or Y4M frames, -r or a .y4m input */
+    RUN_FRAMES,
+    /** \brief Several values of sigmas or sigmar */
+    RUN_SWEEP,
+    /** \brief Tiles shared with shard workers, -s */
+    RUN_SHARDED,
+    /** \brief Tiles streamed from files, -t */
+    RUN_TILED,
+    /** \brief Rows streamed from files, -l */
+    RUN_SCANLINE,
+    /** \brief Cost query, -Q */
+    RUN_QUERY,
+    /** \brief Progressive filter, -P */
+    RUN_PROGRESSIVE,
+    /** \brief Batch benchmark, -B */
+    RUN_BENCHMARK,
+    /** \brief Filter of an image, then of an edit of it, -R */
+    RUN_EDIT,
+    /** \brief Filter of an image within a time budget, -d */
+    RUN_DEADLINE,
+    /** \brief Joint bilateral upsampling, -u */
+    RUN_UPSAMPLE,
+    /** \brief Filter of an image */
+    RUN_IMAGE,
+    RUN_NUM_MODES
+} run_mode;
+
+/** \brief Options allowed by a run mode */
+typedef struct {
+    /** \brief Name of the mode in the messages */
+    const char *name;
+    /** \brief Letters of the options allowed */
+    const char *options;
+    /** \brief Whether several values of sigmas or sigmar may be given */
+    bool sweeps;
+    /** \brief Whether noise may be added to the input */
+    bool noise;
+} run_options;
+
+/** \brief Options allowed by each run mode, -b, -c, -p and -w being those of the plans of the filters */
+static const run_options run_mode_options[RUN_NUM_MODES] = {
+        [RUN_WORKER] = {"shard workers", "sW", false, false},
+        [RUN_DAEMON] = {"the daemon", "bcDMpw", false, false},
+        [RUN_CLIENT] = {"daemon clients", "Cmnz", false, false},
+        [RUN_BATCH] = {"batches", "bcimMpqw", false, false},
+        [RUN_FRAMES] = {"raw and Y4M frames", "bcprw", false, false},
+        [RUN_SWEEP] = {"sweeps", "bcmpw", true, true},
+        [RUN_SHARDED] = {"sharded filters", "bcjpstw", false, false},
+        [RUN_TILED] = {"tiled filters", "bcMptw", false, false},
+        [RUN_SCANLINE] = {"scanline filters", "bclMpw", false, false},
+        [RUN_QUERY] = {"cost queries", "bcmQ", false, false},
+        [RUN_PROGRESSIVE] = {"progressive filters", "bcmpPw", false, true},
+        [RUN_BENCHMARK] = {"the batch benchmark", "bBcmpw", false, true},
+        [RUN_EDIT] = {"edits", "bcdmMpRw", false, false},
+        [RUN_DEADLINE] = {"time budgets", "bcdmMpw", false, true},
+        [RUN_UPSAMPLE] = {"joint upsampling", "bcgmpuw", false, true},
+        [RUN_IMAGE] = {"the filter of an image", "bcgmMpw", false, true},
+};
+
+/**
+ * \brief Write output planes to a file
+ * \param files     Pointer to the sweep_files
+ * \param name      File name
+ * \param outimg    Pointer to the output planes, one per channel
+ * \return Success or Failure
+ *
+ * Alpha is copied from the input.
+ */
+static int write_planes(const sweep_files *files, const char *name, float ***outimg) {
+    const size_t size = (size_t) files->rows * files->columns;
+    float *output_image = (float *) calloc(files->channels * size, sizeof(float));
+    if (output_image == NULL) {
+        printf("Allocating a %d x %d image failed \n", files->rows, files->columns);
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < files->channels; c++) {
+        for (int i = 0; i < files->rows; i++) {
+            for (int j = 0; j < files->columns; j++) {
+                output_image[c * size + (size_t) i * files->columns + j] = (c < files->filtered) ?
+                        outimg[c][i][j] / 255.0f : files->input_image[c * size + (size_t) i * files->columns + j];
+            }
+        }
+    }
+    int status = write_image(output_image, files->columns, files->rows, name,
+                             IMAGEIO_float | IMAGEIO_PLANAR | files->format, 100);
+    free(output_image);
+    if (status != 1) {
+        printf("Writing image %s failed \n", name);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Write an output of a parameter sweep
+ * \param is        Index of the spatial standard deviation
+ * \param ir        Index of the range standard deviation
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters of the output
+ * \param data      Pointer to the sweep_files
+ * \return Success or Failure
+ *
+ * The file name is the output name with _s<sigmas>_r<sigmar>
+ * inserted before the extension.
+ */
+static int write_sweep_output(int is, int ir, float ***outimg, const program_params *params, void *data) {
+    const sweep_files *files = (const sweep_files *) data;
+    char name[1024], sigmas[64];
+    const char *dot = strrchr(files->output, '.');
+    int base = (dot != NULL) ? (int) (dot - files->output) : (int) strlen(files->output);
+
+    if (files->sigmas_x[is] == files->sigmas_y[is])
+        sprintf(sigmas, "%g", files->sigmas_x[is]);
+    else
+        sprintf(sigmas, "%gx%g", files->sigmas_x[is], files->sigmas_y[is]);
+    snprintf(name, sizeof(name), "%.*s_s%s_r%g%s", base, files->output, sigmas, files->sigmar[ir],
+             (dot != NULL) ? dot : "");
+    if (write_planes(files, name, outimg) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    printf("%s: %d DFT coefficients, spatial filter %s \n", name, params->K, spatial_filters[params->backend].name);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Write a result of a progressive filter
+ * \param done      Number of frequencies accumulated
+ * \param K         Total number of frequencies
+ * \param error     Bound on the error of the range kernel of outimg
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param data      Pointer to the sweep_files
+ * \return Success or Failure
+ *
+ * The file name is the output name with _k<done> inserted before
+ * the extension; the last result is left to the caller, which
+ * writes it to the output name.
+ */
+static int write_progress_output(int done, int K, float error, float ***outimg, void *data) {
+    const sweep_files *files = (const sweep_files *) data;
+    char name[1024];
+    const char *dot = strrchr(files->output, '.');
+    int base = (dot != NULL) ? (int) (dot - files->output) : (int) strlen(files->output);
+
+    if (done == K) {
+        printf("%s: %d of %d DFT coefficients, range kernel error at most %f \n", files->output, done, K, error);
+        return EXIT_SUCCESS;
+    }
+    snprintf(name, sizeof(name), "%.*s_k%d%s", base, files->output, done, (dot != NULL) ? dot : "");
+    if (write_planes(files, name, outimg) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    printf("%s: %d of %d DFT coefficients, range kernel error at most %f \n", name, done, K, error);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Compare the batch filter with a loop of single image filters
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param count     Number of copies of the image filtered
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, filled with the
+ *                  batch output of the first copy
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters; on return they
+ *                  are those of the batch
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The copies are filtered by shiftableBF_batch, then one after
+ * the other by shiftableBF_channels, both from the parameters
+ * given. The images per second of both, and the largest
+ * difference of their outputs, are printed.
+ */
+static int batch_benchmark(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, int count,
+                           float ***img, float ***outimg, int cores, program_params *params, float eps) {
+    const int C = channels;
+    int b, c, i, j, status = EXIT_SUCCESS;
+    float ****in = (float ****) calloc(count, sizeof(float ***));
+    float ****batch_out = (float ****) calloc(count, sizeof(float ***));
+    float ****loop_out = (float ****) calloc(count, sizeof(float ***));
+    if (in == NULL || batch_out == NULL || loop_out == NULL)
+        status = EXIT_FAILURE;
+    for (b = 0; b < count && status == EXIT_SUCCESS; b++) {
+        in[b] = (float ***) calloc(C, sizeof(float **));
+        batch_out[b] = (float ***) calloc(C, sizeof(float **));
+        loop_out[b] = (float ***) calloc(C, sizeof(float **));
+        if (in[b] == NULL || batch_out[b] == NULL || loop_out[b] == NULL) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        for (c = 0; c < C; c++) {
+            in[b][c] = alloc_array(m, n);
+            batch_out[b][c] = alloc_array(m, n);
+            loop_out[b][c] = alloc_array(m, n);
+            if (in[b][c] == NULL || batch_out[b][c] == NULL || loop_out[b][c] == NULL) {
+                status = EXIT_FAILURE;
+                break;
+            }
+            for (i = 0; i < m; i++)
+                memcpy(in[b][c][i], img[c][i], n * sizeof(float));
+        }
+    }
+    if (status != EXIT_SUCCESS)
+        printf("Allocating %d copies of a %d x %d image failed \n", count, m, n);
+
+    double batch_time = 0, loop_time = 0;
+    program_params batch_params = *params, loop_params = *params;
+    if (status == EXIT_SUCCESS) {
+        double start = now();
+        status = shiftableBF_batch(count, m, n, C, sigmas_x, sigmas_y, sigmar, in, batch_out, cores, &batch_params,
+                                   eps);
+        batch_time = calcElapsed(start, now());
+    }
+    if (status == EXIT_SUCCESS) {
+        double start = now();
+        for (b = 0; b < count && status == EXIT_SUCCESS; b++) {
+            loop_params = *params;
+            status = shiftableBF_channels(m, n, C, sigmas_x, sigmas_y, sigmar, in[b], loop_out[b], cores,
+                                          &loop_params, eps);
+            /* Each image of the loop fits its own coefficients */
+            free(loop_params.coeff);
+            loop_params.coeff = NULL;
+        }
+        loop_time = calcElapsed(start, now());
+    }
+    if (status == EXIT_SUCCESS) {
+        float difference = 0;
+        for (b = 0; b < count; b++) {
+            for (c = 0; c < C; c++) {
+                for (i = 0; i < m; i++) {
+                    for (j = 0; j < n; j++)
+                        difference = max(difference, fabsf(batch_out[b][c][i][j] - loop_out[b][c][i][j]));
+                }
+            }
+        }
+        for (c = 0; c < C; c++) {
+            for (i = 0; i < m; i++)
+                memcpy(outimg[c][i], batch_out[0][c][i], n * sizeof(float));
+        }
+        *params = batch_params;
+        printf("Batch of %d images: %f images/s \n", count, count / batch_time);
+        printf("Loop of %d images: %f images/s \n", count, count / loop_time);
+        printf("Largest difference of the outputs: %f \n", difference);
+    }
+
+    for (b = 0; b < count; b++) {
+        for (c = 0; c < C; c++) {
+            if (in != NULL && in[b] != NULL && in[b][c] != NULL)
+                dealloc_array_fl(in[b][c], m);
+            if (batch_out != NULL && batch_out[b] != NULL && batch_out[b][c] != NULL)
+                dealloc_array_fl(batch_out[b][c], m);
+            if (loop_out != NULL && loop_out[b] != NULL && loop_out[b][c] != NULL)
+                dealloc_array_fl(loop_out[b][c], m);
+        }
+        if (in != NULL)
+            free(in[b]);
+        if (batch_out != NULL)
+            free(batch_out[b]);
+        if (loop_out != NULL)
+            free(loop_out[b]);
+    }
+    free(in);
+    free(batch_out);
+    free(loop_out);
+    return status;
+}
+
+/**
+ * \brief Run mode of the options and positional arguments
+ * \param given     Whether each option letter was given
+ * \param batch     Whether the input is a directory or a list file
+ * \param frames    Whether the input is streamed as raw or Y4M frames
+ * \param sweep     Whether several values of sigmas or sigmar are given
+ * \return the first mode, in the order of run_mode, whose option or
+ *         input is given, RUN_IMAGE without any
+ */
+static run_mode select_run_mode(const bool *given, bool batch, bool frames, bool sweep) {
+    const bool selects[RUN_NUM_MODES] = {
+            [RUN_WORKER] = given['W'], [RUN_DAEMON] = given['D'], [RUN_CLIENT] = given['C'],
+            [RUN_BATCH] = batch, [RUN_FRAMES] = frames, [RUN_SWEEP] = sweep,
+            [RUN_SHARDED] = given['s'], [RUN_TILED] = given['t'], [RUN_SCANLINE] = given['l'],
+            [RUN_QUERY] = given['Q'], [RUN_PROGRESSIVE] = given['P'], [RUN_BENCHMARK] = given['B'],
+            [RUN_EDIT] = given['R'], [RUN_DEADLINE] = given['d'], [RUN_UPSAMPLE] = given['u'],
+            [RUN_IMAGE] = true};
+    int mode = RUN_WORKER;
+    while (!selects[mode])
+        mode++;
+    return (run_mode) mode;
+}
+
+/**
+ * \brief Check that the options given are allowed by the run mode
+ * \param mode      Run mode
+ * \param given     Whether each option letter was given
+ * \param sweep     Whether several values of sigmas or sigmar are given
+ * \param noise     Whether noise is added to the input
+ * \return Success or Failure
+ */
+static int check_run_options(run_mode mode, const bool *given, bool sweep, bool noise) {
+    const run_options *allowed = &run_mode_options[mode];
+    for (int opt = 1; opt <= UCHAR_MAX; opt++) {
+        if (given[opt] && strchr(allowed->options, opt) == NULL) {
+            printf("Option -%c cannot be used with %s \n", opt, allowed->name);
+            return EXIT_FAILURE;
+        }
+    }
+    if (sweep && !allowed->sweeps) {
+        printf("Sweeps cannot be used with %s \n", allowed->name);
+        return EXIT_FAILURE;
+    }
+    if (noise && !allowed->noise) {
+        printf("Noise cannot be added with %s \n", allowed->name);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
     int cores;
 #ifdef __linux__
@@ -23,42 +371,457 @@ int main(int argc, char *argv[]) {
 #endif
     if (cores > 8) cores = 8;
 
-    /* Check if there is a right call for algorithm */
-    if (argc > 9) {
-        printf("Too many arguments. \nSyntax is: FBF input sigmas sigmar output eps sigmaref noise_indicator sigman \n");
-        return EXIT_FAILURE;
+    program_params params; /** \brief Program parameters */
+    params.backend = SPATIAL_AUTO;
+    params.planning = PLAN_ESTIMATE;
+    params.memory = 0;
+    params.buffers = 0;
+    const char *wisdom_file = "fbf.wisdom"; /** \brief File remembering measured plans */
+    const char *cache_file = NULL; /** \brief File caching coefficients, none by default */
+    const char *guide_file = NULL; /** \brief Guide image of the joint filter, none by default */
+    int scale = 1; /** \brief Reduction factor of the convolved images */
+    int format = IMAGEIO_GRAYSCALE; /** \brief Channels read from and written to the image files */
+    int channels = 1; /** \brief Number of channels, including alpha */
+    int filtered = 1; /** \brief Number of channels filtered, alpha is copied */
+    float deadline = 0; /** \brief Time budget of the filter in seconds, none by default */
+    int tile = 0; /** \brief Side of the tiles of a filter streamed from files, none by default */
+    int block = 0; /** \brief Rows filtered together by a filter streamed row by row, none by default */
+    const char *shard_dir = NULL; /** \brief Directory shared with the shard workers, none by default */
+    int workers = 1; /** \brief Local worker processes of a sharded filter */
+    int worker_index = -1, worker_count = 1, worker_threads = cores; /** \brief Shards filtered by a worker */
+    const char *colour = "gray"; /** \brief Colour mode sent to a daemon */
+    const char *serve_socket = NULL; /** \brief Socket served by the daemon, none by default */
+    const char *client_socket = NULL; /** \brief Socket of the daemon the requests are sent to, none by default */
+    int requests = 1; /** \brief Requests sent to the daemon */
+    bool shared = false; /** \brief Whether the client passes the planes in shared memory */
+    raw_format raw = RAW_NUM_FORMATS; /** \brief Format of the raw frames streamed, none by default */
+    int raw_width = 0, raw_height = 0; /** \brief Size of the raw frames */
+    bool raw_chroma = false; /** \brief Whether the chroma planes of the raw frames are filtered */
+    bool y4m = false; /** \brief Whether the frames are streamed in a YUV4MPEG2 video */
+    int io_threads = 2; /** \brief Threads decoding, and threads encoding, the files of a batch */
+    int depth = 4; /** \brief Images held between two stages of the pipeline of a batch */
+    int bench = 0; /** \brief Copies of the image filtered by the batch benchmark, none by default */
+    const char *edited_file = NULL; /** \brief Edited input updated after the filter, none by default */
+    int edit_top = 0, edit_left = 0, edit_height = 0, edit_width = 0; /** \brief Edited rectangle */
+
+    /* Options precede the positional arguments */
+    int opt;
+    bool given[UCHAR_MAX + 1] = {false}; /** \brief Whether each option letter was given */
+    while ((opt = getopt(argc, argv, "b:B:c:C:d:D:g:i:j:l:m:M:n:p:Pq:Qr:R:s:t:u:w:W:z")) != -1) {
+        given[(unsigned char) opt] = true;
+        switch (opt) {
+            case 'b': /* Spatial backend */
+                params.backend = spatial_backend_from_name(optarg);
+                if (params.backend == SPATIAL_NUM_BACKENDS) {
+                    printf("Unknown spatial backend %s. \nChoose one of any, auto, deriche, young, box \n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'B': /* Batch benchmark */
+                bench = atoi(optarg);
+                if (bench < 1) {
+                    printf("Number of images of the benchmark must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c': /* Coefficient cache */
+                cache_file = optarg;
+                break;
+            case 'C': /* Client of a daemon */
+                client_socket = optarg;
+                break;
+            case 'd': /* Time budget */
+                deadline = atof(optarg);
+                if (!(deadline > 0)) {
+                    printf("Time budget must be positive \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D': /* Daemon */
+                serve_socket = optarg;
+                break;
+            case 'g': /* Guide image */
+                guide_file = optarg;
+                break;
+            case 'i': /* I/O threads of a batch */
+                io_threads = atoi(optarg);
+                if (io_threads < 1) {
+                    printf("Number of I/O threads must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'j': /* Local shard workers */
+                workers = atoi(optarg);
+                if (workers < 0) {
+                    printf("Number of workers must not be negative \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l': /* Rows streamed from files */
+                block = atoi(optarg);
+                if (block < 1) {
+                    printf("Block of rows must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm': /* Colour mode */
+                colour = optarg;
+                if (strcmp(optarg, "gray") == 0) {
+                    format = IMAGEIO_GRAYSCALE;
+                    channels = filtered = 1;
+                } else if (strcmp(optarg, "rgb") == 0) {
+                    format = IMAGEIO_RGB;
+                    channels = filtered = 3;
+                } else if (strcmp(optarg, "rgba") == 0) {
+                    format = IMAGEIO_RGBA;
+                    channels = 4;
+                    filtered = 3;
+                } else {
+                    printf("Unknown colour mode %s. \nChoose one of gray, rgb, rgba \n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'M': /* Memory budget */
+                if (!(atof(optarg) > 0)) {
+                    printf("Memory budget must be positive \n");
+                    return EXIT_FAILURE;
+                }
+                params.memory = (size_t) (atof(optarg) * 1e6);
+                break;
+            case 'n': /* Requests sent to the daemon */
+                requests = atoi(optarg);
+                if (requests < 1) {
+                    printf("Number of requests must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p': /* Planning mode */
+                if (strcmp(optarg, "measure") == 0)
+                    params.planning = PLAN_MEASURE;
+                else if (strcmp(optarg, "estimate") == 0)
+                    params.planning = PLAN_ESTIMATE;
+                else {
+                    printf("Unknown planning mode %s. \nChoose one of estimate, measure \n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P': /* Progressive filter */
+                break;
+            case 'q': /* Queue depth of a batch */
+                depth = atoi(optarg);
+                if (depth < 1) {
+                    printf("Queue depth must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'Q': /* Cost query */
+                break;
+            case 'r': { /* Raw frames streamed, format:WIDTHxHEIGHT[:chroma] or y4m */
+                char name[16], extra[16] = "";
+                if (strcmp(optarg, "y4m") == 0) {
+                    y4m = true;
+                    break;
+                }
+                if (sscanf(optarg, "%15[^:]:%dx%d:%15s", name, &raw_width, &raw_height, extra) < 3 ||
+                    raw_width < 1 || raw_height < 1 || (extra[0] != '\0' && strcmp(extra, "chroma") != 0)) {
+                    printf("Raw frames must be given as format:WIDTHxHEIGHT[:chroma] or y4m \n");
+                    return EXIT_FAILURE;
+                }
+                raw = raw_format_from_name(name);
+                if (raw == RAW_NUM_FORMATS) {
+                    printf("Unknown raw format %s. \nChoose one of gray8, gray16, yuv420p \n", name);
+                    return EXIT_FAILURE;
+                }
+                raw_chroma = extra[0] != '\0';
+                break;
+            }
+            case 'R': { /* Edited rectangle top,left,height,width:edited image */
+                int length = 0;
+                if (sscanf(optarg, "%d,%d,%d,%d:%n", &edit_top, &edit_left, &edit_height, &edit_width, &length) < 4 ||
+                    length == 0 || optarg[length] == '\0' || edit_height < 1 || edit_width < 1) {
+                    printf("Edit must be given as top,left,height,width:edited \n");
+                    return EXIT_FAILURE;
+                }
+                edited_file = optarg + length;
+                break;
+            }
+            case 's': /* Shard directory */
+                shard_dir = optarg;
+                break;
+            case 't': /* Tiles streamed from files */
+                tile = atoi(optarg);
+                if (tile < 1) {
+                    printf("Tile side must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'u': /* Joint bilateral upsampling */
+                scale = atoi(optarg);
+                if (scale < 1) {
+                    printf("Upsampling factor must be a positive integer \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w': /* Wisdom file */
+                wisdom_file = optarg;
+                break;
+            case 'W': /* Shard worker index/count[/threads] */
+                if (sscanf(optarg, "%d/%d/%d", &worker_index, &worker_count, &worker_threads) < 2 ||
+                    worker_index < 0 || worker_index >= worker_count) {
+                    printf("Worker must be given as index/count[/threads] with index below count \n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'z': /* Planes sent to the daemon in shared memory */
+                shared = true;
+                break;
+            default:
+                printf("Syntax is: FBF [-b backend] [-B images] [-c cache] [-C socket] [-d seconds] [-D socket] [-g guide] [-i threads] [-j workers] [-l rows] [-m colour] [-M megabytes] [-n requests] [-p planning] [-P] [-q depth] [-Q] [-r raw] [-R edit] [-s shards] [-t tile] [-u scale] [-w wisdom] [-z] input sigmas sigmar output eps \n");
+                return EXIT_FAILURE;
+        }
+    }
+    const char *program = argv[0]; /** \brief FBF executable, run by the local shard workers */
+    /* Shift so that argv[1] is the first positional argument */
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    /* Run mode: shard workers and the daemon take no positional argument */
+    bool batch = false, sweep = false;
+    if (!given['W'] && !given['D']) {
+        /* Check if there is a right call for algorithm */
+        if (argc > 9) {
+            printf("Too many arguments. \nSyntax is: FBF [-b backend] [-B images] [-c cache] [-C socket] [-d seconds] [-D socket] [-g guide] [-i threads] [-j workers] [-l rows] [-m colour] [-M megabytes] [-n requests] [-p planning] [-P] [-q depth] [-Q] [-r raw] [-R edit] [-s shards] [-t tile] [-u scale] [-w wisdom] [-z] input sigmas sigmar output eps sigmaref noise_indicator sigman \n");
+            return EXIT_FAILURE;
+        }
+        if (argc < 6) {
+            printf("Not enough arguments. \nSyntax is: FBF [-b backend] [-B images] [-c cache] [-C socket] [-d seconds] [-D socket] [-g guide] [-i threads] [-j workers] [-l rows] [-m colour] [-M megabytes] [-n requests] [-p planning] [-P] [-q depth] [-Q] [-r raw] [-R edit] [-s shards] [-t tile] [-u scale] [-w wisdom] [-z] input sigmas sigmar output eps \n");
+            return EXIT_FAILURE;
+        }
+        const size_t length = strlen(argv[1]);
+        struct stat st;
+        if (raw == RAW_NUM_FORMATS && length > 4 && strcasecmp(argv[1] + length - 4, ".y4m") == 0)
+            y4m = true;
+        batch = (stat(argv[1], &st) == 0 && S_ISDIR(st.st_mode)) ||
+                (length > 4 && strcasecmp(argv[1] + length - 4, ".txt") == 0) ||
+                (length > 5 && strcasecmp(argv[1] + length - 5, ".list") == 0);
+        sweep = strchr(argv[2], ':') != NULL || strchr(argv[3], ':') != NULL;
     }
-    if (argc < 6) {
-        printf("Not enough arguments. \nSyntax is: FBF input sigmas sigmar output eps \n");
+    const run_mode mode = select_run_mode(given, batch, raw != RAW_NUM_FORMATS || y4m, sweep);
+    if (check_run_options(mode, given, sweep, argc > 7) != EXIT_SUCCESS)
         return EXIT_FAILURE;
+
+    if (params.planning == PLAN_MEASURE)
+        wisdom_load(wisdom_file);
+    if (cache_file != NULL)
+        cache_open(cache_file);
+    /* Shard worker: the shards and their plan are in the shard directory */
+    if (mode == RUN_WORKER) {
+        if (shard_dir == NULL) {
+            printf("Shard workers need the shard directory given with -s \n");
+            return EXIT_FAILURE;
+        }
+        double started = now();
+        if (shard_worker(shard_dir, worker_index, worker_count, worker_threads) != EXIT_SUCCESS) {
+            printf("Shard worker %d/%d failed \n", worker_index, worker_count);
+            return EXIT_FAILURE;
+        }
+        printf("Shard worker %d/%d: %f s\n", worker_index, worker_count, calcElapsed(started, now()));
+        return EXIT_SUCCESS;
+    }
+    /* Daemon: the requests give the images and filter parameters */
+    if (mode == RUN_DAEMON) {
+        int status = daemon_serve(serve_socket, cores, &params);
+        if (params.planning == PLAN_MEASURE)
+            wisdom_save(wisdom_file);
+        cache_close();
+        return status;
     }
 
-    program_params params; /** \brief Program parameters */
+    /* Client of a daemon, which filters the images */
+    if (mode == RUN_CLIENT)
+        return daemon_client(client_socket, argv + 1, colour, requests, shared);
 
     /* Declaration parameters */
     float *input_image, *output_image;
     int columns, rows;
       double start ;
-    int i, j, sigmas;
-    float sigmar, eps, sigmaref;
+    int i, j, c;
+    size_t p;
+    float sigmas_x, sigmas_y, sigmar, eps, sigmaref;
+    float sweep_sx[SWEEP_MAX], sweep_sy[SWEEP_MAX], sweep_sr[SWEEP_MAX]; /** \brief Values of a parameter sweep */
+    int nsigmas = 0, nsigmar = 0;
+    char *token, *end;
 
-    /* Read image, image filename input as argv[1] */
-    input_image = (float *) read_image(&columns, &rows, argv[1], IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE);
-
-    sscanf(argv[2], "%d", &sigmas); /* SigmaS input as argv[2] */
-    sscanf(argv[3], "%f", &sigmar); /* SigmaR input as argv[3] */
+    /* SigmaS input as argv[2], either one value or sigmas_x,sigmas_y for rows and columns; a sweep separates values by : */
+    for (token = strtok(argv[2], ":"); token != NULL && nsigmas < SWEEP_MAX; token = strtok(NULL, ":")) {
+        sigmas_x = sigmas_y = strtof(token, &end);
+        if (end != token && *end == ',')
+            sigmas_y = strtof(end + 1, &end);
+        if (end == token || *end != '\0' || !(sigmas_x >= 0.5f && sigmas_y >= 0.5f) || !isfinite(sigmas_x) ||
+            !isfinite(sigmas_y)) {
+            printf("sigmas must be at least 0.5 \n");
+            return EXIT_FAILURE;
+        }
+        sweep_sx[nsigmas] = sigmas_x;
+        sweep_sy[nsigmas++] = sigmas_y;
+    }
+    /* SigmaR input as argv[3] */
+    for (token = strtok(argv[3], ":"); token != NULL && nsigmar < SWEEP_MAX; token = strtok(NULL, ":")) {
+        sweep_sr[nsigmar] = strtof(token, &end);
+        if (end == token || *end != '\0' || !(sweep_sr[nsigmar] > 0) || !isfinite(sweep_sr[nsigmar])) {
+            printf("sigmar must be positive \n");
+            return EXIT_FAILURE;
+        }
+        nsigmar++;
+    }
+    if (nsigmas == 0 || nsigmar == 0) {
+        printf("sigmas and sigmar must be given \n");
+        return EXIT_FAILURE;
+    }
+    sigmas_x = sweep_sx[0];
+    sigmas_y = sweep_sy[0];
+    sigmar = sweep_sr[0];
     sscanf(argv[5], "%f", &eps); /* parameter epsilon input as argv[5] */
     if (argc >= 7)
         sscanf(argv[6], "%f", &sigmaref); /* Parameter to control stretching of the difference images as argv[6] */
     else
         sigmaref = 32;
 
-    float **image = alloc_array(rows, columns); /** \brief Matrix to store input image */
-    float **image_out = alloc_array(rows, columns); /** \brief Matrix to store output image */
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < columns; j++) {
-            image[i][j] = input_image[i * columns + j] * 255.0f;
+    /* Tiled, scanline and sharded filters: the image is streamed from and to PNM files, without difference images */
+    if (mode == RUN_SHARDED || mode == RUN_TILED || mode == RUN_SCANLINE) {
+        start = now();
+        int status;
+        if (mode == RUN_SHARDED)
+            status = shiftableBF_sharded(program, argv[1], argv[4], shard_dir, sigmas_x, sigmas_y, sigmar,
+                                         (tile > 0) ? tile : SHARD_TILE, workers, cores, &params, eps);
+        else if (mode == RUN_TILED)
+            status = shiftableBF_tiled(argv[1], argv[4], sigmas_x, sigmas_y, sigmar, tile, cores, &params, eps);
+        else
+            status = shiftableBF_scanline(argv[1], argv[4], sigmas_x, sigmas_y, sigmar, block, cores, &params, eps);
+        if (status != EXIT_SUCCESS) {
+            printf("Streamed fast bilateral filter failed \n");
+            return EXIT_FAILURE;
+        }
+        printf("Number of DFT coefficients used for approximating range kernel is %d \n", params.K);
+        printf("Spatial filter: %s, threads: %d \n", spatial_filters[params.backend].name, params.threads);
+        printf("Execution time: %f s\n", calcElapsed(start, now()));
+        if (params.planning == PLAN_MEASURE)
+            wisdom_save(wisdom_file);
+        cache_close();
+        return EXIT_SUCCESS;
+    }
+
+    /* Batch: directory or list file of images filtered by a pipeline into the output directory */
+    if (mode == RUN_BATCH) {
+        if (shiftableBF_pipeline(argv[1], argv[4], format, filtered, sigmas_x, sigmas_y, sigmar, io_threads, depth,
+                                 cores, &params, eps) != EXIT_SUCCESS) {
+            printf("Batch fast bilateral filter failed \n");
+            return EXIT_FAILURE;
+        }
+        printf("Number of DFT coefficients used for approximating range kernel is %d \n", params.K);
+        printf("Spatial filter: %s, threads: %d \n", spatial_filters[params.backend].name, params.threads);
+        if (params.planning == PLAN_MEASURE)
+            wisdom_save(wisdom_file);
+        cache_close();
+        return EXIT_SUCCESS;
+    }
+
+    /* Raw and Y4M frames: streamed from and to files or pipes, "-" being stdin or stdout, reports on stderr */
+    if (y4m) {
+        if (shiftableBF_y4m(argv[1], argv[4], sigmas_x, sigmas_y, sigmar, cores, &params, eps) != EXIT_SUCCESS) {
+            fprintf(stderr, "Y4M fast bilateral filter failed \n");
+            return EXIT_FAILURE;
+        }
+    } else if (raw != RAW_NUM_FORMATS) {
+        FILE *in = (strcmp(argv[1], "-") == 0) ? stdin : fopen(argv[1], "rb");
+        FILE *out = (strcmp(argv[4], "-") == 0) ? stdout : fopen(argv[4], "wb");
+        if (in == NULL || out == NULL) {
+            fprintf(stderr, "Opening %s failed \n", (in == NULL) ? argv[1] : argv[4]);
+            return EXIT_FAILURE;
+        }
+        int status = shiftableBF_raw(in, out, raw, raw_width, raw_height, raw_chroma, sigmas_x, sigmas_y, sigmar,
+                                     cores, &params, eps);
+        if (out != stdout && fclose(out) != 0)
+            status = EXIT_FAILURE;
+        if (in != stdin)
+            fclose(in);
+        if (status != EXIT_SUCCESS) {
+            fprintf(stderr, "Raw fast bilateral filter failed \n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (mode == RUN_FRAMES) {
+        fprintf(stderr, "Number of DFT coefficients used for approximating range kernel is %d \n", params.K);
+        fprintf(stderr, "Spatial filter: %s, threads: %d \n", spatial_filters[params.backend].name, params.threads);
+        if (params.planning == PLAN_MEASURE)
+            wisdom_save(wisdom_file);
+        cache_close();
+        return EXIT_SUCCESS;
+    }
+
+    /* Read image, image filename input as argv[1], one plane per channel */
+    input_image = (float *) read_image(&columns, &rows, argv[1], IMAGEIO_float | IMAGEIO_PLANAR | format);
+    if (input_image == NULL) {
+        printf("Reading image %s failed \n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    const size_t size = (size_t) rows * columns; /** \brief Number of pixels of a plane */
+
+    /* Cost query: the predicted time and memory of the filter are printed, and nothing is filtered */
+    if (mode == RUN_QUERY) {
+        cost_estimate estimate;
+        free(input_image);
+        if (cost_predict(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, eps, max(cores, 1), params.backend,
+                         &estimate) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        printf("Number of DFT coefficients used for approximating range kernel is at most %d \n", estimate.K);
+        printf("Range kernel approximation error: %f \n", estimate.error);
+        printf("Spatial filter: %s, threads: %d \n", spatial_filters[estimate.backend].name, max(cores, 1));
+        printf("Predicted time: %f s, memory: %.1f MB \n", estimate.seconds, estimate.bytes / 1e6);
+        cache_close();
+        return EXIT_SUCCESS;
+    }
+
+    /* Read guide image of the joint filter, same size and channels as the input */
+    float *guide_image = NULL;
+    float **guide[4]; /** \brief Matrices to store guide image, one per channel */
+    if (guide_file != NULL) {
+        int guide_columns, guide_rows;
+        guide_image = (float *) read_image(&guide_columns, &guide_rows, guide_file,
+                                           IMAGEIO_float | IMAGEIO_PLANAR | format);
+        if (guide_image == NULL || guide_columns != columns || guide_rows != rows) {
+            printf("Guide image %s must have the size of the input image \n", guide_file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    float **image[4]; /** \brief Matrices to store input image, one per channel */
+    float **image_out[4]; /** \brief Matrices to store output image, one per channel */
+    for (c = 0; c < channels; c++) {
+        image[c] = alloc_array(rows, columns);
+        image_out[c] = alloc_array(rows, columns);
+        if (image[c] == NULL || image_out[c] == NULL) {
+            printf("Allocating a %d x %d image failed \n", rows, columns);
+            return EXIT_FAILURE;
         }
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < columns; j++) {
+                image[c][i][j] = input_image[c * size + (size_t) i * columns + j] * 255.0f;
+            }
+        }
+        if (guide_image != NULL) {
+            guide[c] = alloc_array(rows, columns);
+            if (guide[c] == NULL) {
+                printf("Allocating a %d x %d image failed \n", rows, columns);
+                return EXIT_FAILURE;
+            }
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < columns; j++) {
+                    guide[c][i][j] = guide_image[c * size + (size_t) i * columns + j] * 255.0f;
+                }
+            }
+        } else
+            guide[c] = image[c];
     }
 
     /* Check if noise is added */
@@ -76,101 +839,212 @@ int main(int argc, char *argv[]) {
             printf("Specify standard deviation of noise. \nSyntax is: FBF input sigmas sigmar output eps sigmaref noise_indicator sigman \n");
             return EXIT_FAILURE;
         }
-        if (addgaussiannoise(image, rows, columns, sigman) != EXIT_SUCCESS) {/* adding gaussian noise */
-            printf("Adding gaussian noise failed \n");
+        for (c = 0; c < filtered; c++) {
+            if (addgaussiannoise(image[c], rows, columns, sigman) != EXIT_SUCCESS) {/* adding gaussian noise */
+                printf("Adding gaussian noise failed \n");
+                return EXIT_FAILURE;
+            }
+            /* Clipping the noisy image */
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < columns; j++) {
+                    if (image[c][i][j] < 0.0) image[c][i][j] = 0.0;
+                    if (image[c][i][j] > 255.0) image[c][i][j] = 255.0;
+                }
+            }
+        }
+    }
+    /* Parameter sweep: every output of the grid is written, without difference images */
+    if (mode == RUN_SWEEP) {
+        sweep_files files = {argv[4], rows, columns, channels, filtered, format, input_image, sweep_sx, sweep_sy,
+                             sweep_sr};
+        start = now();
+        if (shiftableBF_sweep(rows, columns, filtered, nsigmas, sweep_sx, sweep_sy, nsigmar, sweep_sr, image,
+                              image_out, cores, &params, eps, write_sweep_output, &files) != EXIT_SUCCESS) {
+            printf("Parameter sweep failed \n");
             return EXIT_FAILURE;
         }
-        /* Clipping the noisy image */
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < columns; j++) {
-                if (image[i][j] < 0.0) image[i][j] = 0.0;
-                if (image[i][j] > 255.0) image[i][j] = 255.0;
-            }
+        printf("Execution time: %f s for %d outputs\n", calcElapsed(start, now()), nsigmas * nsigmar);
+        if (params.planning == PLAN_MEASURE)
+            wisdom_save(wisdom_file);
+        cache_close();
+        for (c = 0; c < channels; c++) {
+            dealloc_array_fl(image[c], rows);
+            dealloc_array_fl(image_out[c], rows);
         }
+        free(input_image);
+        return EXIT_SUCCESS;
     }
+
 	 start = now();
     /* Shiftable Bilateral Filter applied to image and result stored in image_out */
-    if (shiftableBF(rows, columns, sigmas, sigmar, image, image_out, cores, &params, eps) != EXIT_SUCCESS) {
+    int status;
+    sweep_files files = {argv[4], rows, columns, channels, filtered, format, input_image, NULL, NULL, NULL};
+    if (mode == RUN_PROGRESSIVE)
+        status = shiftableBF_progressive(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, image, image_out, cores,
+                                         &params, eps, write_progress_output, &files);
+    else if (mode == RUN_BENCHMARK)
+        status = batch_benchmark(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, bench, image, image_out, cores,
+                                 &params, eps);
+    else if (deadline > 0)
+        status = shiftableBF_deadline(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, image, image_out, cores,
+                                      &params, eps, deadline);
+    else
+        status = shiftableBF_upsample(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, scale, guide, image,
+                                      image_out, cores, &params, eps);
+    if (status != EXIT_SUCCESS) {
         printf("Fast bilateral filter algorithm failed \n");
         return EXIT_FAILURE;
     }
 	double time_interval = calcElapsed(start, now());
+    if (guide_image != NULL) {
+        for (c = 0; c < channels; c++)
+            dealloc_array_fl(guide[c], rows);
+        free(guide_image);
+    }
+    if (params.planning == PLAN_MEASURE)
+        wisdom_save(wisdom_file);
+    cache_close();
 	 
     printf("Number of DFT coefficients used for approximating range kernel is %d \n", params.K);
+    printf("Range kernel approximation error: %f \n", params.error);
+    printf("Spatial filter: %s, threads: %d \n", spatial_filters[params.backend].name, params.threads);
+    if (params.memory > 0 && params.buffers > 0)
+        printf("Filter buffers: %.1f MB of %.1f MB \n", params.buffers / 1e6, params.memory / 1e6);
     printf("Execution time: %f s\n", time_interval);
+    if (deadline > 0)
+        printf("Time budget: %f s, %s by %f s \n", deadline, (time_interval <= deadline) ? "met" : "exceeded",
+               fabs(deadline - time_interval));
+
+    /* Edit: the edited image replaces the input, and the outputs near the edited rectangle are filtered again */
+    if (mode == RUN_EDIT) {
+        int edited_columns, edited_rows;
+        float *edited_image = (float *) read_image(&edited_columns, &edited_rows, edited_file,
+                                                   IMAGEIO_float | IMAGEIO_PLANAR | format);
+        if (edited_image == NULL || edited_columns != columns || edited_rows != rows) {
+            printf("Edited image %s must have the size of the input image \n", edited_file);
+            return EXIT_FAILURE;
+        }
+        for (c = 0; c < channels; c++) {
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < columns; j++)
+                    image[c][i][j] = edited_image[c * size + (size_t) i * columns + j] * 255.0f;
+            }
+        }
+        free(input_image);
+        input_image = edited_image;
+        start = now();
+        status = shiftableBF_region(rows, columns, filtered, sigmas_x, sigmas_y, image, image_out, &params, edit_top,
+                                    edit_left, edit_height, edit_width);
+        if (status != EXIT_SUCCESS) {
+            /* The whole image is filtered again, with coefficients fitted to the edited image */
+            free(params.coeff);
+            params.coeff = NULL;
+            status = shiftableBF_channels(rows, columns, filtered, sigmas_x, sigmas_y, sigmar, image, image_out, cores,
+                                          &params, eps);
+        }
+        if (status != EXIT_SUCCESS) {
+            printf("Fast bilateral filter of the edited image failed \n");
+            return EXIT_FAILURE;
+        }
+        printf("Edit update time: %f s\n", calcElapsed(start, now()));
+    }
 
-    /* Write image, image filename input as argv[4] */
-    output_image = (float *) calloc(rows * columns, sizeof(float));
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < columns; j++) {
-            output_image[i * columns + j] = image_out[i][j] / 255.0f;
+    /* Write image, image filename input as argv[4]; alpha is copied from the input */
+    output_image = (float *) calloc(channels * size, sizeof(float));
+    if (output_image == NULL) {
+        printf("Allocating a %d x %d image failed \n", rows, columns);
+        return EXIT_FAILURE;
+    }
+    for (c = 0; c < channels; c++) {
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < columns; j++) {
+                output_image[c * size + (size_t) i * columns + j] =
+                        (c < filtered) ? image_out[c][i][j] / 255.0f : input_image[c * size + (size_t) i * columns + j];
+            }
         }
+        dealloc_array_fl(image_out[c], rows);
     }
-    if (write_image(output_image, columns, rows, argv[4], IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE, 100) !=
+    if (write_image(output_image, columns, rows, argv[4], IMAGEIO_float | IMAGEIO_PLANAR | format, 100) !=
         1) {
         printf("Writing image failed \n");
         return EXIT_FAILURE;
     }
-    dealloc_array_fl(image_out, rows);
 
+    /* Difference images are written without alpha */
+    const int diff_format = IMAGEIO_float | IMAGEIO_PLANAR | ((filtered == 1) ? IMAGEIO_GRAYSCALE : IMAGEIO_RGB);
+    const size_t diff_size = filtered * size;
 
     /* No noise condition */
     if (addnoise == 0) {
         /* Computing the difference image */
-        float *diff_image = (float *) calloc(rows * columns, sizeof(float));
-        for (i = 0; i < rows * columns; i++)
-            diff_image[i] = (input_image[i] - output_image[i]);
+        float *diff_image = (float *) calloc(diff_size, sizeof(float));
+        if (diff_image == NULL) {
+            printf("Allocating a %d x %d image failed \n", rows, columns);
+            return EXIT_FAILURE;
+        }
+        for (p = 0; p < diff_size; p++)
+            diff_image[p] = (input_image[p] - output_image[p]);
 
         /* Stretching and clipping the difference image */
-        float std = calculatestd(diff_image, rows * columns);
-        for (i = 0; i < rows * columns; i++) {
-            diff_image[i] = (128.0f / 255.0f) + (diff_image[i] * sigmaref / (std * 255));
-            if (diff_image[i] < 0.0f) diff_image[i] = 0.0f;
-            if (diff_image[i] > 1.0f) diff_image[i] = 1.0f;
+        float std = calculatestd(diff_image, diff_size);
+        for (p = 0; p < diff_size; p++) {
+            diff_image[p] = (128.0f / 255.0f) + (diff_image[p] * sigmaref / (std * 255));
+            if (diff_image[p] < 0.0f) diff_image[p] = 0.0f;
+            if (diff_image[p] > 1.0f) diff_image[p] = 1.0f;
         }
 
         /* Writing the difference image */
-        if (write_image(diff_image, columns, rows, "difference.png",
-                        IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE, 100) != 1) {
+        if (write_image(diff_image, columns, rows, "difference.png", diff_format, 100) != 1) {
             printf("Writing image failed \n");
             return EXIT_FAILURE;
         }
-        dealloc_array_fl(image, rows);
+        for (c = 0; c < channels; c++)
+            dealloc_array_fl(image[c], rows);
         free(diff_image);
         free(output_image);
     }
         /* Noisy conditions */
     else {
 
-        float *noisy_image = (float *) calloc(rows * columns, sizeof(float));
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < columns; j++) {
-                noisy_image[i * columns + j] = image[i][j] / 255.0f;
+        float *noisy_image = (float *) calloc(channels * size, sizeof(float));
+        if (noisy_image == NULL) {
+            printf("Allocating a %d x %d image failed \n", rows, columns);
+            return EXIT_FAILURE;
+        }
+        for (c = 0; c < channels; c++) {
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < columns; j++) {
+                    noisy_image[c * size + (size_t) i * columns + j] = image[c][i][j] / 255.0f;
+                }
             }
+            dealloc_array_fl(image[c], rows);
         }
-        dealloc_array_fl(image, rows);
         /* Generating the difference images */
-        float *diff_image = (float *) calloc(rows * columns, sizeof(float));
-        float *diff_noisyimage = (float *) calloc(rows * columns, sizeof(float));
-        for (i = 0; i < rows * columns; i++) {
-            diff_image[i] = (input_image[i] - output_image[i]);
-            diff_noisyimage[i] = (noisy_image[i] - output_image[i]);
+        float *diff_image = (float *) calloc(diff_size, sizeof(float));
+        float *diff_noisyimage = (float *) calloc(diff_size, sizeof(float));
+        if (diff_image == NULL || diff_noisyimage == NULL) {
+            printf("Allocating a %d x %d image failed \n", rows, columns);
+            return EXIT_FAILURE;
+        }
+        for (p = 0; p < diff_size; p++) {
+            diff_image[p] = (input_image[p] - output_image[p]);
+            diff_noisyimage[p] = (noisy_image[p] - output_image[p]);
         }
         /* Stretching and clipping the difference images */
-        float std = calculatestd(diff_image, rows * columns);
-        float stdnoisy = calculatestd(diff_noisyimage, rows * columns);
-        for (i = 0; i < rows * columns; i++) {
+        float std = calculatestd(diff_image, diff_size);
+        float stdnoisy = calculatestd(diff_noisyimage, diff_size);
+        for (p = 0; p < diff_size; p++) {
 
-            diff_image[i] = (128.0f / 255.0f) + (diff_image[i] * sigmaref / (std * 255));
-            if (diff_image[i] < 0.0f) diff_image[i] = 0.0;
-            if (diff_image[i] > 1.0f) diff_image[i] = 1.0;
+            diff_image[p] = (128.0f / 255.0f) + (diff_image[p] * sigmaref / (std * 255));
+            if (diff_image[p] < 0.0f) diff_image[p] = 0.0;
+            if (diff_image[p] > 1.0f) diff_image[p] = 1.0;
 
-            diff_noisyimage[i] = (128.0f / 255.0f) + (diff_noisyimage[i] * sigmaref / (stdnoisy * 255));
-            if (diff_noisyimage[i] < 0.0f) diff_noisyimage[i] = 0.0f;
-            if (diff_noisyimage[i] > 1.0f) diff_noisyimage[i] = 1.0f;
+            diff_noisyimage[p] = (128.0f / 255.0f) + (diff_noisyimage[p] * sigmaref / (stdnoisy * 255));
+            if (diff_noisyimage[p] < 0.0f) diff_noisyimage[p] = 0.0f;
+            if (diff_noisyimage[p] > 1.0f) diff_noisyimage[p] = 1.0f;
         }
         /* Writing the noisy image */
-        if (write_image(noisy_image, columns, rows, "noisy.png", IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE,
+        if (write_image(noisy_image, columns, rows, "noisy.png", IMAGEIO_float | IMAGEIO_PLANAR | format,
                         100) != 1) {
             printf("Writing image failed \n");
             return EXIT_FAILURE;
@@ -178,16 +1052,14 @@ int main(int argc, char *argv[]) {
         free(noisy_image);
 
         /* Writing the difference image : original - filtered */
-        if (write_image(diff_image, columns, rows, "diff_noiseless.png",
-                        IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE, 100) != 1) {
+        if (write_image(diff_image, columns, rows, "diff_noiseless.png", diff_format, 100) != 1) {
             printf("Writing image failed \n");
             return EXIT_FAILURE;
         }
         free(diff_image);
 
         /* Writing the difference image : noisy - filtered */
-        if (write_image(diff_noisyimage, columns, rows, "diff_noisy.png",
-                        IMAGEIO_float | IMAGEIO_PLANAR | IMAGEIO_GRAYSCALE, 100) != 1) {
+        if (write_image(diff_noisyimage, columns, rows, "diff_noisy.png", diff_format, 100) != 1) {
             printf("Writing image failed \n");
             return EXIT_FAILURE;
         }
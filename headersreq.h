@@ -28,6 +28,66 @@ typedef struct {
 #endif
 #define min(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define max(X, Y) (((X) > (Y)) ? (X) : (Y))
+/** \brief Margins of crops filtered apart, in filter radii: the recursive filters have tails beyond one radius */
+#define REGION_MARGIN 2
+/** \brief Largest T of an image, whose values are in [0, 255] */
+#define PIXEL_RANGE 255
+
+/** \brief Algorithms available for the spatial Gaussian convolutions */
+typedef enum {
+    /** \brief Any backend, including the box approximation, may be chosen by the planner */
+    SPATIAL_ANY = -2,
+    /** \brief Choose Deriche or Young from the ratio Tmax/sigmar */
+    SPATIAL_AUTO = -1,
+    /** \brief Deriche's O(3) recursive filter */
+    SPATIAL_DERICHE = 0,
+    /** \brief Young and van Vliet's recursive filter */
+    SPATIAL_YOUNG,
+    /** \brief Cascade of extended box filters (running sums) */
+    SPATIAL_BOX,
+    /** \brief Number of spatial backends */
+    SPATIAL_NUM_BACKENDS
+} spatial_backend;
+
+/** \brief Constants of a 1D spatial Gaussian filter, computed once per sigma */
+typedef struct {
+    /** \brief Backend the constants belong to */
+    spatial_backend backend;
+    /** \brief Standard deviation of the Gaussian */
+    float sigma;
+    /** \brief Filter radius, also the padding width of the auxiliary images */
+    int w;
+    /** \brief Deriche causal/anticausal numerators, denominators and scale */
+    float Nc[3], Dc[3], Na[3], Da[3], scale;
+    /** \brief Young and van Vliet forward/backward coefficients and gain */
+    float bf[3], bb[3], B;
+    /** \brief Box radius, weight of the extension taps and normalization */
+    int r;
+    float alpha, norm;
+} spatial_kernel;
+
+/** \brief Entry of the spatial backend table */
+typedef struct {
+    /** \brief Name used on the command line */
+    const char *name;
+    /** \brief Compute filter constants for standard deviation sigma */
+    void (*init)(spatial_kernel *kernel, float sigma);
+    /** \brief Convolve a padded complex image in place along rows (kx) and columns (ky),
+     *         each pixel holding lanes interleaved values */
+    void (*convolve2D)(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                       fft_complex **ip_padded);
+} spatial_filter;
+
+/** \brief Table of spatial backends indexed by spatial_backend */
+extern const spatial_filter spatial_filters[SPATIAL_NUM_BACKENDS];
+
+/** \brief How the spatial backend and the number of threads are chosen */
+typedef enum {
+    /** \brief Fixed rules: Tmax/sigmar test and one thread per physical core */
+    PLAN_ESTIMATE = 0,
+    /** \brief Time the candidates once and remember the fastest in the wisdom */
+    PLAN_MEASURE
+} plan_mode;
 
 /** \brief struct of program parameters */
 typedef struct {
@@ -37,7 +97,127 @@ typedef struct {
     float *coeff;
     /** \brief T computed by maxfilter */
     float T;
+    /** \brief Approximation error of the range kernel (Linfinity norm) */
+    float error;
+    /** \brief Requested spatial backend, replaced by the one actually used */
+    spatial_backend backend;
+    /** \brief Planning mode */
+    plan_mode planning;
+    /** \brief Number of threads used for the convolutions */
+    int threads;
+    /** \brief Memory budget of the filter buffers in bytes, 0 for none */
+    size_t memory;
+    /** \brief Bytes of the filter buffers used by the last filter */
+    size_t buffers;
 } program_params;
+
+/** \brief Predicted cost of a filter */
+typedef struct {
+    /** \brief Number of terms of the range kernel fit and its error */
+    int K;
+    float error;
+    /** \brief Spatial backend used */
+    spatial_backend backend;
+    /** \brief Time of the filter */
+    double seconds;
+    /** \brief Peak memory of the filter, including the input and output planes */
+    size_t bytes;
+} cost_estimate;
+
+/** \brief Reduced grid on which joint bilateral upsampling performs the convolutions */
+typedef struct {
+    /** \brief Reduced height and width */
+    int m, n;
+    /** \brief Guide and averaged planes at the reduced size, one per channel */
+    float ***guide, ***img;
+    /** \brief Lower reduced index of each full row and column, and weight of the upper one */
+    const int *iy, *ix;
+    const float *ay, *ax;
+} reduced_grid;
+
+/** \brief State of a video filtering session, kept from frame to frame */
+typedef struct {
+    /** \brief Frame size, channels and filter parameters */
+    int m, n, channels;
+    float sigmas_x, sigmas_y, sigmar, eps;
+    /** \brief Range kernel fit, backend and threads of the session */
+    program_params params;
+    /** \brief Spatial filter constants along rows and columns */
+    spatial_kernel kx, ky;
+    /** \brief Frames filtered, range kernel fits and exact T computations */
+    int frames, fits, maxfilters;
+    /** \brief Basis exp(I*omegao*frame), P and Q of the frame */
+    fft_complex **F1;
+    float **P, **Q;
+    /** \brief Auxiliary images and private P and Q of each thread */
+    fft_complex ***F, ***G, ***H;
+    float ***P_k, ***Q_k;
+} video_session;
+
+/** \brief State of a range kernel retune session on one image */
+typedef struct {
+    /** \brief Image size, channels and filter parameters */
+    int m, n, channels;
+    float sigmas_x, sigmas_y, sigmar, eps;
+    /** \brief Input planes, kept by the caller */
+    float ***img;
+    /** \brief T of the image and half period of the planes */
+    float T, Tmax;
+    /** \brief Range kernel fit of the last sigmar, backend and threads */
+    program_params params;
+    /** \brief Number of frequencies of the planes */
+    int K_max;
+    /** \brief Contribution of each frequency to P and Q, without its coefficient */
+    float ***p, ***q;
+} retune_session;
+
+/** \brief Position of the planes of float samples of an image in a shared memory segment */
+typedef struct {
+    /** \brief Image width, height and channels */
+    int width, height, channels;
+    /** \brief Bytes from the start of the segment to the first sample */
+    size_t offset;
+    /** \brief Bytes between the rows of a plane, and between the planes of the channels */
+    size_t stride, plane;
+} shm_layout;
+
+/** \brief Formats of raw video frames */
+typedef enum {
+    /** \brief 8-bit luma plane */
+    RAW_GRAY8 = 0,
+    /** \brief 16-bit little endian luma plane */
+    RAW_GRAY16,
+    /** \brief 8-bit luma plane, then two chroma planes of half the width and height */
+    RAW_YUV420P,
+    RAW_NUM_FORMATS
+} raw_format;
+
+/**
+ * \brief Function receiving the filtered rows of a scanline session
+ * \param row       Index of the row in the image
+ * \param values    Filtered row, one array of width values per channel
+ * \param data      Pointer given to scanline_session_open
+ * \return Success, or Failure to stop
+ */
+typedef int (*scanline_callback)(int row, float **values, void *data);
+
+/** \brief State of a scanline session filtering an image row by row */
+typedef struct {
+    /** \brief Image width, channels and filter parameters */
+    int n, channels;
+    float sigmas_x, sigmas_y;
+    /** \brief Range kernel fit, backend and threads of the session */
+    program_params params;
+    /** \brief Rows filtered together, and rows of halo above and below them */
+    int block, margin;
+    /** \brief Rows received, rows emitted, and image row of the first row held */
+    int received, emitted, first;
+    /** \brief Input and output rows held, block + 2 * margin per channel */
+    float ***rows, ***out;
+    /** \brief Function receiving the filtered rows, and its data */
+    scanline_callback callback;
+    void *data;
+} scanline_session;
 /** ------------------ **/
 /** - Main functions - **/
 /** ------------------ **/
@@ -61,7 +241,7 @@ int core_affinity();
  * \brief Dynamically allocate 2D array of floats
  * \param rows      Number of rows
  * \param columns   Number of columns
- * \return pointer to 2D array
+ * \return pointer to 2D array, or NULL if the allocation failed
  *
  * This routine allocates memory in heap for a 2D
  * array of dimensions rows x columns and datatype
@@ -71,7 +251,7 @@ float **alloc_array(int rows, int columns);
 
 /**
  * \brief Deallocate dynamically allocated 2D array of floats
- * \param arr       Pointer to 2D array
+ * \param arr       Pointer to 2D array, or NULL
  * \param m         Number of rows
  *
  * This routine deallocates heap memory allocated for
@@ -83,7 +263,7 @@ void dealloc_array_fl(float **arr, int m);
  * \brief Dynamically allocate 2D array of complex floats
  * \param rows      Number of rows
  * \param columns   Number of columns
- * \return pointer to 2D array
+ * \return pointer to 2D array, or NULL if the allocation failed
  *
  * This routine allocates memory in heap for a 2D
  * array of dimensions rows x columns and datatype
@@ -93,7 +273,7 @@ fft_complex **alloc_array_complex(int rows, int columns);
 
 /**
  * \brief Deallocate dynamically allocated 2D array of complex floats
- * \param arr       Pointer to 2D array
+ * \param arr       Pointer to 2D array, or NULL
  * \param m         Number of rows
  *
  * This routine deallocates heap memory allocated for
@@ -105,59 +285,135 @@ void dealloc_array_fl_complex(fft_complex **arr, int m);
  * \brief Find T = max{x} ( max{||y||<=R} (|f(x-y)-f(x)|) )
  *        (using Max-Filter Algorithm)
  * \param fin       Pointer to input image
- * \param w         Wdith of spatial kernel
+ * \param wy        Height of spatial kernel
+ * \param wx        Width of spatial kernel
  * \param m         Image height
  * \param n         Image width
  * \return T
  *
  * This routine computes the maximum value T input to the
  * range filter for the input image fin and spatial kernel
- * of width w.
+ * of size wy x wx.
  * Max-Filter Algorithm is used to calculate local maximums.  
  */
-float maxfilterfind(float **fin, int w, int m, int n);
+float maxfilterfind(float **fin, int wy, int wx, int m, int n);
+
+/**
+ * \brief Compute Young and van Vliet filter constants
+ * \param kernel    Pointer to filter constants to fill
+ * \param sigma     Gaussian kernel standard deviation
+ */
+void young_init(spatial_kernel *kernel, float sigma);
 
 /**
  * \brief Apply 2D Gaussian filter to input image
  *        (Young and van Vliet's algorithm) 
  * \param rows      Image height
  * \param columns   Image width
- * \param sigma     Gaussian kernel standard deviation
- * \param ip_padded Pointer to input image
- * \param op_padded Pointer to output image
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from young_init for rows
+ * \param ky        Filter constants from young_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
  *
- * This routine applies 2D Gaussian filter of s.d.
- * sigma to input image ip_padded of dimensions
- * rows x columns and computes output image op_padded.
+ * This routine applies 2D Gaussian filter to input image
+ * ip_padded of dimensions rows x columns in place.
  * 1D filter is first convolved along rows and then
  * along columns. The 1D convolution is performed using
  * Young and van Vliet's fast recursive algorithm.
  */
-void convolve_young2D(int rows, int columns, int sigma, fft_complex **ip_padded);
+void convolve_young2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                           fft_complex **ip_padded);
+
+/**
+ * \brief Compute Deriche filter constants
+ * \param kernel    Pointer to filter constants to fill
+ * \param sigma     Gaussian kernel standard deviation
+ */
+void deriche_init(spatial_kernel *kernel, float sigma);
 
 /**
  * \brief Apply 2D Gaussian filter to input image
  *        (Deriche Recursive Algorithm) 
  * \param rows      Image height
  * \param columns   Image width
- * \param sigma     Gaussian kernel standard deviation
- * \param ip_padded Pointer to input image
- * \param op_padded Pointer to output image
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from deriche_init for rows
+ * \param ky        Filter constants from deriche_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
  *
- * This routine applies 2D Gaussian filter of s.d.
- * sigma to input image ip_padded of dimensions
- * rows x columns and computes output image op_padded.
+ * This routine applies 2D Gaussian filter to input image
+ * ip_padded of dimensions rows x columns in place.
  * 1D filter is first convolved along rows and then
  * along columns. The 1D convolution is performed using
  * Deriche's fast recursive algorithm.
  */
-void convolve_deriche2D(int rows, int columns, int sigma, fft_complex **ip_padded);
+void convolve_deriche2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                             fft_complex **ip_padded);
+
+/**
+ * \brief Compute extended box cascade constants
+ * \param kernel    Pointer to filter constants to fill
+ * \param sigma     Gaussian kernel standard deviation
+ *
+ * The box radius and the weight of the two extension
+ * taps are chosen so that the cascade has variance
+ * exactly sigma^2.
+ */
+void box_init(spatial_kernel *kernel, float sigma);
+
+/**
+ * \brief Apply 2D Gaussian-like filter to input image
+ *        (Extended box filter cascade)
+ * \param rows      Image height
+ * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from box_init for rows
+ * \param ky        Filter constants from box_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
+ *
+ * This routine convolves ip_padded of dimensions rows x columns
+ * in place with a cascade of extended box filters along rows
+ * and then along columns. Each box is evaluated with running
+ * sums, so the cost per pixel is a few additions independent
+ * of sigma.
+ */
+void convolve_box2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                         fft_complex **ip_padded);
+
+/**
+ * \brief Look up a spatial backend by name
+ * \param name      "any", "auto", "deriche", "young" or "box"
+ * \return backend, or SPATIAL_NUM_BACKENDS if name is unknown
+ */
+spatial_backend spatial_backend_from_name(const char *name);
+
+/**
+ * \brief Name of a spatial backend
+ * \param backend   Backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \return name accepted by spatial_backend_from_name
+ */
+const char *spatial_backend_name(spatial_backend backend);
+
+/**
+ * \brief Choose the recursive Gaussian used by default
+ * \param Tmax      Half period of the range kernel
+ * \param sigmar    Standard deviation of range kernel
+ * \return SPATIAL_DERICHE or SPATIAL_YOUNG
+ *
+ * Deriche is more accurate and is preferred while
+ * Tmax/sigmar is small, Young and van Vliet otherwise.
+ */
+spatial_backend select_spatial_backend(float Tmax, float sigmar);
 
 /**
  * \brief Apply fast shiftable bilateral filter to input image
  * \param m         Image height
  * \param n         Image width
- * \param sigmas    Standard deviation of spatial kernel
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
  * \param sigmar    Standard deviation of range kernel
  * \param img       Pointer to input image
  * \param outimg    Pointer to output image
@@ -167,28 +423,1071 @@ void convolve_deriche2D(int rows, int columns, int sigma, fft_complex **ip_padde
  * \return Success or Failure 
  *
  * This routine applies the fast shiftable bilateral filter
- * with parameters sigmas & sigmar to input image img of
+ * with parameters sigmas_x, sigmas_y & sigmar to input image img of
  * dimensions m x n and computes output image outimg.
  * The algorithm used is Fourier Basis approximation.
- * The Gaussian spatial convolutions are performed using
- * Young and van Vliet's fast recursive algorithm.
+ * The Gaussian spatial convolutions are performed with the
+ * backend requested in params->backend (SPATIAL_AUTO picks
+ * Deriche or Young), and the backend used is stored back.
  * The convolutions are performed parallelly with one thread
  * assigned for each physical core on the system.
  */
-int shiftableBF(int m, int n, int sigmas, float sigmar, float **img, float **outimg, int cores, program_params *params,
-                float eps);
+int shiftableBF(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float **img, float **outimg, int cores,
+                program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a multi-channel image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Each channel is filtered independently with its own range
+ * kernel, but T is the largest over the channels so that the
+ * range kernel fit, the spatial constants and the plan are
+ * computed once. The auxiliary images of all channels are
+ * interleaved per pixel so that the spatial recursions of the
+ * channels run in adjacent vector lanes. Alpha channels are
+ * not passed here and are left to the caller.
+ */
+int shiftableBF_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable joint bilateral filter
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Joint (cross) bilateral filter: the range weights come from
+ * differences in guide[c] and are used to average img[c].
+ * The auxiliary images F and G are built from the guide and
+ * H from img, so the cost is that of shiftableBF_channels.
+ */
+int shiftableBF_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***guide,
+                      float ***img, float ***outimg, int cores, program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter with the convolutions
+ *        performed on a downscaled image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param scale     Reduction factor of the convolved images
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ *                  (may be guide)
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Joint bilateral upsampling: the auxiliary images G and H are
+ * computed and convolved on the guide and img reduced by scale,
+ * interpolated bilinearly to full size and combined with F of
+ * the full size guide. The convolutions cost scale^2 times less
+ * than with shiftableBF_joint, which is used for scale 1.
+ */
+int shiftableBF_upsample(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, int scale,
+                         float ***guide, float ***img, float ***outimg, int cores, program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a batch of images
+ * \param count     Number of images
+ * \param m         Height of the images
+ * \param n         Width of the images
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input images, each a pointer to
+ *                  its planes
+ * \param outimg    Pointer to the output images
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters; on return they
+ *                  hold the fit of the largest T, the backend and
+ *                  the number of threads used
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * Filters the images of the batch with one team of threads
+ * taking (image, range of frequencies) work items in turn, with
+ * the buffers of a thread allocated once. Images with the same
+ * T share their range kernel fit; the backend and the spatial
+ * filter constants are shared by the batch. This avoids the
+ * per call thread start and allocations of shiftableBF_channels
+ * for many small images.
+ */
+int shiftableBF_batch(int count, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                      float ****img, float ****outimg, int cores, program_params *params, float eps);
+
+/**
+ * \brief Fit the Fourier approximation of the range kernel
+ * \param Tmax      Half period of the approximation
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the approximation error
+ * \param params    Pointer to Program parameters, T, K, coeff
+ *                  and error are filled
+ * \return Approximation error reached (Linfinity norm)
+ *
+ * This routine adds DFT coefficients of the Gaussian range
+ * kernel on [-Tmax,Tmax] until the approximation error is
+ * less than eps or Tmax+1 coefficients are used.
+ */
+float fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params);
+
+/**
+ * \brief Start a range kernel retune session on an image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Smallest standard deviation of range kernel
+ *                  expected, which needs the most coefficients
+ * \param img       Pointer to the input planes, one per channel,
+ *                  kept by the session
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \return new session, or NULL on failure
+ *
+ * The auxiliary images of each frequency are convolved once and
+ * kept as their contributions to P and Q, 8*K*m*n*channels bytes.
+ */
+retune_session *retune_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                    float ***img, int cores, const program_params *params, float eps);
+
+/**
+ * \brief Filter the image of a retune session with another range kernel
+ * \param session   Pointer to the session
+ * \param sigmar    Standard deviation of range kernel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \return Success or Failure
+ *
+ * While T dominates ceil(3.2*sigmar) and sigmar is not below the
+ * one of the session, this only fits the range kernel and sums
+ * the kept planes with its coefficients.
+ */
+int retune_session_filter(retune_session *session, float sigmar, float ***outimg);
+
+/**
+ * \brief End a retune session and release its planes
+ * \param session   Pointer to the session
+ */
+void retune_session_close(retune_session *session);
+
+/**
+ * \brief Function receiving the intermediate results of a progressive filter
+ * \param done      Number of frequencies accumulated
+ * \param K         Total number of frequencies
+ * \param error     Bound on the error of the range kernel of outimg
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param data      Pointer given to shiftableBF_progressive
+ * \return Success to continue, or Failure to stop with this result
+ */
+typedef int (*progress_callback)(int done, int K, float error, float ***outimg, void *data);
+
+/**
+ * \brief Apply fast shiftable bilateral filter, publishing intermediate
+ *        results
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel,
+ *                  updated after each batch of frequencies
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function called after each batch
+ * \param data      Passed to callback
+ * \return Success or Failure
+ *
+ * The frequencies are accumulated by batches of one per thread,
+ * in decreasing magnitude of their coefficients, and the output
+ * of the frequencies accumulated so far is passed to callback
+ * after each batch with a bound on its range kernel error.
+ */
+int shiftableBF_progressive(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                            float ***outimg, int cores, program_params *params, float eps,
+                            progress_callback callback, void *data);
+
+/**
+ * \brief Function receiving each output of a parameter sweep
+ * \param is        Index of the spatial standard deviation
+ * \param ir        Index of the range standard deviation
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters of the output
+ * \param data      Pointer given to shiftableBF_sweep
+ * \return Success, or Failure to stop the sweep
+ */
+typedef int (*sweep_callback)(int is, int ir, float ***outimg, const program_params *params, void *data);
+
+/**
+ * \brief Filter an image for every (sigmas, sigmar) of a grid
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param nsigmas   Number of spatial standard deviations
+ * \param sigmas_x  Standard deviations of spatial kernel along rows
+ * \param sigmas_y  Standard deviations of spatial kernel along columns
+ * \param nsigmar   Number of range standard deviations
+ * \param sigmar    Standard deviations of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel,
+ *                  overwritten for each point of the grid
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function called with each output
+ * \param data      Passed to callback
+ * \return Success or Failure
+ *
+ * The max-filter runs once per sigmas and the auxiliary images
+ * are convolved once per sigmas and half period, the outputs of
+ * the sigmar sharing it are sums of the same planes (see
+ * retune_session_filter).
+ */
+int shiftableBF_sweep(int m, int n, int channels, int nsigmas, const float *sigmas_x, const float *sigmas_y,
+                      int nsigmar, const float *sigmar, float ***img, float ***outimg, int cores,
+                      const program_params *params, float eps, sweep_callback callback, void *data);
+
+/**
+ * \brief Apply fast shiftable bilateral filter within a time budget
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, error is set to
+ *                  the range kernel error reached
+ * \param eps       Bound on the range kernel approximation error
+ *                  when the budget allows it
+ * \param seconds   Time budget, from the call
+ * \return Success or Failure
+ *
+ * The fit for eps is truncated to the number of terms that the
+ * measured cost of a round of one frequency per thread (see
+ * cost_round) allows in the time left. The backend is resolved
+ * by cost_backend, the cheapest one being used for SPATIAL_ANY.
+ */
+int shiftableBF_deadline(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                         float ***outimg, int cores, program_params *params, float eps, float seconds);
+
+/**
+ * \brief Fit the range kernel and plan the filter of an image file
+ * \param in        File opened by pnm_open_read
+ * \param offset    Position of the first pixel in the file
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles read
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, T, K, coeff,
+ *                  error, backend and threads are set
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * T of the whole image is found tile by tile, then the range kernel
+ * is fitted and the plan chosen once, on the first tile for
+ * PLAN_MEASURE.
+ */
+int tiled_plan(FILE *in, off_t offset, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+               int tile, int cores, program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file tile by tile
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles written
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * All the tiles share T of the whole image, the range kernel fit
+ * and the plan. Each tile is filtered on a crop read from the file
+ * with a halo of REGION_MARGIN filter radii, so that the memory
+ * used depends on the tile size only.
+ */
+int shiftableBF_tiled(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                      int cores, program_params *params, float eps);
+
+/**
+ * \brief Write the shards of an image file and their plan
+ * \param input     Binary PGM or PPM file to filter
+ * \param dir       Shard directory, created if missing
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles of the shards
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set by tiled_plan
+ * \param eps       Bound on the range kernel approximation error
+ * \param shards    Number of shards, set
+ * \return Success or Failure
+ *
+ * Each shard is a tile with the halo of shiftableBF_tiled, written
+ * as shard_<i>.pnm; plan.fbf holds the fit, the backend and the
+ * position of the tiles.
+ */
+int shard_prepare(const char *input, const char *dir, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                  int cores, program_params *params, float eps, int *shards);
+
+/**
+ * \brief Filter the shards of a shard directory assigned to a worker
+ * \param dir       Shard directory
+ * \param index     Index of the worker, from 0
+ * \param count     Number of workers sharing the directory
+ * \param threads   Number of threads of this worker
+ * \return Success or Failure
+ *
+ * Worker index filters the shards i with i % count == index whose
+ * result_<i>.pnm is not complete yet.
+ */
+int shard_worker(const char *dir, int index, int count, int threads);
+
+/**
+ * \brief Stitch the results of a shard directory into the output
+ * \param dir       Shard directory, with all the results complete
+ * \param output    PGM or PPM file written
+ * \return Success or Failure
+ */
+int shard_stitch(const char *dir, const char *output);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file with worker processes
+ * \param program   FBF executable run by the workers
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param dir       Shard directory
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles of the shards
+ * \param workers   Number of local worker processes, 0 to wait for
+ *                  workers started elsewhere
+ * \param cores     Number of physical cores on system, shared by the
+ *                  local workers
+ * \param params    Pointer to Program parameters, set by tiled_plan
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The shards are prepared, filtered by the workers and stitched;
+ * the output matches that of shiftableBF_tiled with the same tile.
+ */
+int shiftableBF_sharded(const char *program, const char *input, const char *output, const char *dir,
+                        float sigmas_x, float sigmas_y, float sigmar, int tile, int workers, int cores,
+                        program_params *params, float eps);
+
+/**
+ * \brief Serve filter requests on a Unix domain socket until "quit"
+ * \param path      Path of the socket, replaced if it exists
+ * \param cores     Number of threads, pinned by the caller
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend, planning mode and memory budget
+ * \return Success or Failure
+ *
+ * Each request line "input output sigmas sigmar eps [colour]" is
+ * answered by "ok K backend hit|miss seconds" or "error message".
+ * The plans of the last requests, keyed by (size, channels, sigmas,
+ * sigmar, eps), are kept with the range kernel fit of their last T.
+ */
+int daemon_serve(const char *path, int cores, const program_params *params);
+
+/**
+ * \brief Send a request to a daemon repeatedly and report its latency
+ * \param path      Path of the socket of the daemon
+ * \param args      input, sigmas, sigmar, output and eps, as given to
+ *                  FBF
+ * \param colour    Colour mode, gray, rgb or rgba
+ * \param count     Number of requests sent, one after the other
+ * \param shared    Whether the planes are passed in a shared memory
+ *                  segment rather than as image files
+ * \return Success or Failure
+ */
+int daemon_client(const char *path, char *const *args, const char *colour, int count, bool shared);
+
+/**
+ * \brief Create a shared memory segment and map it
+ * \param name      Name of the segment, as for shm_attach
+ * \param bytes     Size of the segment
+ * \return mapped segment, or NULL on failure
+ */
+void *shm_create(const char *name, size_t bytes);
+
+/**
+ * \brief Map an existing shared memory segment
+ * \param name      "/name" of a POSIX shared memory object, or path
+ *                  of a file holding more than one '/', such as
+ *                  /proc/<pid>/fd/<fd> of a memfd_create segment
+ * \param bytes     Size of the segment, set
+ * \return mapped segment, readable and writable, or NULL on failure
+ */
+void *shm_attach(const char *name, size_t *bytes);
+
+/**
+ * \brief Unmap a shared memory segment
+ * \param base      Segment mapped by shm_create or shm_attach
+ * \param bytes     Size of the segment
+ */
+void shm_detach(void *base, size_t bytes);
+
+/**
+ * \brief Find the end of the planes of a layout in a segment
+ * \param layout    Position of the planes of float samples in the
+ *                  segment
+ * \param bytes     Size of the segment
+ * \param end       Bytes from the start of the segment to the end of
+ *                  the last sample, set
+ * \return Success, or Failure if the planes do not fit in the segment
+ */
+int shm_extent(const shm_layout *layout, size_t bytes, size_t *end);
+
+/**
+ * \brief Point the rows of planes into a mapped segment
+ * \param base      Mapped segment
+ * \param bytes     Size of the segment
+ * \param layout    Position of the planes of float samples in the
+ *                  segment
+ * \return planes, one per channel, to be released with
+ *         shm_planes_free, or NULL if they do not fit in the segment
+ *
+ * The planes can be passed to any filter of this library, which
+ * then reads or writes the samples of the segment in place.
+ */
+float ***shm_planes(void *base, size_t bytes, const shm_layout *layout);
+
+/**
+ * \brief Release the row pointers of planes in a segment
+ * \param planes    Planes from shm_planes, or NULL
+ * \param channels  Number of channels
+ */
+void shm_planes_free(float ***planes, int channels);
+
+/**
+ * \brief Look up a raw format by name
+ * \param name      "gray8", "gray16" or "yuv420p"
+ * \return format, or RAW_NUM_FORMATS if name is unknown
+ */
+raw_format raw_format_from_name(const char *name);
+
+/**
+ * \brief Size of a raw frame
+ * \param format    Raw format
+ * \param width     Frame width
+ * \param height    Frame height
+ * \return bytes of a frame
+ */
+size_t raw_frame_bytes(raw_format format, int width, int height);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a stream of raw frames
+ * \param in        Stream of input frames
+ * \param out       Stream of output frames
+ * \param format    Raw format of the frames
+ * \param width     Frame width
+ * \param height    Frame height
+ * \param chroma    Whether the chroma planes of yuv420p frames are
+ *                  filtered too, rather than copied
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel, in 8-bit levels
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of the
+ *                  luma session, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The frames are filtered by video sessions kept for the whole
+ * stream, while a helper thread writes the previous frame and reads
+ * the next one. The frame rate is printed on stderr.
+ */
+int shiftableBF_raw(FILE *in, FILE *out, raw_format format, int width, int height, bool chroma, float sigmas_x,
+                    float sigmas_y, float sigmar, int cores, program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a YUV4MPEG2 video
+ * \param input     Y4M file to filter, "-" for stdin
+ * \param output    Y4M file written with the header of input, "-" for
+ *                  stdout
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of the
+ *                  luma session, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The Y, U and V planes are filtered at their own size by video
+ * sessions kept for the whole video, the chroma planes with the
+ * spatial deviations scaled by their subsampling.
+ */
+int shiftableBF_y4m(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int cores,
+                    program_params *params, float eps);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to many image files
+ * \param input     Directory of image files, or list file holding one
+ *                  path per line
+ * \param outdir    Directory of the filtered files, created if needed,
+ *                  which keep the names of the input files
+ * \param format    Channels read from and written to the image files
+ * \param filtered  Number of channels filtered, alpha is copied
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param io_threads Threads decoding, and threads encoding
+ * \param depth     Images held by each queue between two stages
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to the plan of
+ *                  the last image, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success, or Failure if any file could not be listed, read,
+ *         filtered or written
+ *
+ * I/O threads decode the next files ahead and encode the filtered
+ * images behind, while the threads of the filter filter them, the
+ * stages being joined by bounded queues. The images per second and
+ * the utilization of each stage are printed at the end.
+ */
+int shiftableBF_pipeline(const char *input, const char *outdir, int format, int filtered, float sigmas_x,
+                         float sigmas_y, float sigmar, int io_threads, int depth, int cores, program_params *params,
+                         float eps);
+
+/**
+ * \brief Start a scanline session
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param T         Bound of the maximum local dynamic range of the
+ *                  image, PIXEL_RANGE if 0 or less
+ * \param block     Rows filtered together, at least 1
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function receiving the filtered rows in order
+ * \param data      Passed to callback
+ * \return new session, to be released with scanline_session_close, or
+ *         NULL if its rows cannot be allocated
+ *
+ * The session holds block + 2 * margin rows, margin being
+ * REGION_MARGIN radii of the vertical filter, and emits each row
+ * at most block + margin rows after it is pushed.
+ */
+scanline_session *scanline_session_open(int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float T,
+                                        int block, int cores, const program_params *params, float eps,
+                                        scanline_callback callback, void *data);
+
+/**
+ * \brief Push the next row of the image
+ * \param session   Pointer to the session
+ * \param row       Row of the image, one array of width values per
+ *                  channel, copied
+ * \return Success or Failure, including a failure of callback
+ */
+int scanline_session_push(scanline_session *session, float **row);
+
+/**
+ * \brief Emit the last rows once the whole image has been pushed
+ * \param session   Pointer to the session
+ * \return Success or Failure, including a failure of callback
+ */
+int scanline_session_finish(scanline_session *session);
+
+/**
+ * \brief End a scanline session and release its rows
+ * \param session   Pointer to the session
+ */
+void scanline_session_close(scanline_session *session);
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file row by row
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param block     Rows filtered together
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of
+ *                  the session
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ */
+int shiftableBF_scanline(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar,
+                         int block, int cores, program_params *params, float eps);
+
+/**
+ * \brief Refilter the part of an image affected by a local edit
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to the edited input planes, one per channel
+ * \param outimg    Pointer to the output planes of the image before
+ *                  the edit, updated in place
+ * \param params    Pointer to Program parameters of the filter that
+ *                  computed outimg
+ * \param top       First row of the edited rectangle
+ * \param left      First column of the edited rectangle
+ * \param height    Height of the edited rectangle
+ * \param width     Width of the edited rectangle
+ * \return Success, or Failure when the edit raises T above the
+ *         half period of the fit
+ *
+ * Only the rectangle extended by a few filter radii is filtered,
+ * and the outputs near the rectangle are copied to outimg.
+ */
+int shiftableBF_region(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img, float ***outimg,
+                       const program_params *params, int top, int left, int height, int width);
+
+/**
+ * \brief Start a video filtering session
+ * \param m         Frame height
+ * \param n         Frame width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \return new session, to be released with video_session_close
+ */
+video_session *video_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                  int cores, const program_params *params, float eps);
+
+/**
+ * \brief Filter the next frame of a video session
+ * \param session   Pointer to the session
+ * \param frame     Pointer to the input planes, one per channel
+ * \param outframe  Pointer to the output planes, one per channel
+ * \return Success or Failure
+ *
+ * The backend and the buffers are set up with the first frame
+ * and kept for the session. T is bounded cheaply on each frame;
+ * the exact T is computed and the range kernel refitted only
+ * when the bound leaves the band of the current fit.
+ */
+int video_session_filter(video_session *session, float ***frame, float ***outframe);
+
+/**
+ * \brief End a video filtering session and release its buffers
+ * \param session   Pointer to the session
+ */
+void video_session_close(video_session *session);
+
+/**
+ * \brief Accumulate the contribution of a range of frequencies
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param k0        First frequency
+ * \param k1        Frequency after the last one
+ * \param omegao    Fundamental frequency 2*pi/(2*T+1)
+ * \param coff      Coefficients of the range kernel fit
+ * \param spatial   Spatial backend
+ * \param kx        Spatial filter constants along rows
+ * \param ky        Spatial filter constants along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param F1        exp(I*omegao*guide), m x n*channels, used when
+ *                  there is more than one frequency
+ * \param F         Auxiliary image, m x n*channels
+ * \param G         Auxiliary image, padded by kx->w and ky->w
+ * \param H         Auxiliary image, padded by kx->w and ky->w
+ * \param P_k       Unnormalized filtered image to add to
+ * \param Q_k       Weight sums to add to
+ * \param low       Reduced grid of the convolutions, or NULL to
+ *                  convolve at full size
+ *
+ * Core of the filter, shared by the entry points that schedule
+ * the frequencies themselves. The buffers are provided by the
+ * caller so that they can be reused. With a reduced grid, G and H
+ * are padded at the reduced size and built from its planes, and
+ * the convolved G and H are interpolated bilinearly to full size.
+ */
+void shiftableBF_accumulate(int m, int n, int channels, int k0, int k1, float omegao, const float *coff,
+                            const spatial_filter *spatial, const spatial_kernel *kx, const spatial_kernel *ky,
+                            float ***guide, float ***img, fft_complex **F1, fft_complex **F, fft_complex **G,
+                            fft_complex **H, float **P_k, float **Q_k, const reduced_grid *low);
+
+/**
+ * \brief Compute the filtered image from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to input image
+ * \param outimg    Pointer to output image
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ *
+ * This routine performs the convolutions and the weighted
+ * sums of shiftableBF once the range kernel has been fitted
+ * and the plan chosen.
+ */
+int shiftableBF_execute(int m, int n, float sigmas_x, float sigmas_y, float **img, float **outimg,
+                        const program_params *params);
+
+/**
+ * \brief Compute the filtered channels from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ */
+int shiftableBF_execute_channels(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img,
+                                 float ***outimg, const program_params *params);
+
+/**
+ * \brief Compute the joint filtered channels from a fitted range kernel
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff, backend and threads set
+ * \return Success or Failure
+ */
+int shiftableBF_execute_joint(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                              float ***img, float ***outimg, const program_params *params);
+
+/**
+ * \brief Choose the threads and strips of a filter within a memory budget
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param params    Pointer to Program parameters with backend,
+ *                  threads and memory set
+ * \param threads   Number of threads holding buffers, set
+ * \param rows      Rows filtered per strip, m for the whole image,
+ *                  set
+ * \return bytes of the buffers, or 0 if they do not fit in the budget
+ */
+size_t shiftableBF_layout(int m, int n, int channels, float sigmas_x, float sigmas_y, const program_params *params,
+                          int *threads, int *rows);
+
+/**
+ * \brief Compute the filtered channels strip by strip
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param params    Pointer to Program parameters with T, K,
+ *                  coeff and backend set
+ * \param threads   Number of threads
+ * \param rows      Rows of output per strip
+ * \return Success or Failure
+ *
+ * The strips are extended by REGION_MARGIN filter radii above and
+ * below and filtered by shiftableBF_execute_joint.
+ */
+int shiftableBF_execute_strips(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***guide,
+                               float ***img, float ***outimg, const program_params *params, int threads, int rows);
+
+/**
+ * \brief Choose the spatial backend and thread count by timing
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param channels  Number of channels
+ * \param img       Pointer to the input planes, one per channel
+ * \param params    Pointer to Program parameters with the fitted
+ *                  range kernel, the requested backend and the
+ *                  number of cores in threads
+ * \return Success or Failure
+ *
+ * This routine looks up the wisdom for (m, n, sigmas_x, sigmas_y,
+ * channels, K, backend request, cores). Without an entry, it times
+ * shiftableBF_execute_channels on a central crop of the image for
+ * each candidate backend and thread count and records the fastest
+ * in the wisdom.
+ */
+int plan_measure(int m, int n, float sigmas_x, float sigmas_y, int channels, float ***img, program_params *params);
+
+/**
+ * \brief Fit and plan the filter of an image with a plan kept from image to image
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param channels  Number of channels
+ * \param img       Pointer to the input planes, one per channel
+ * \param request   Backend requested, SPATIAL_AUTO or SPATIAL_ANY
+ *                  letting the plan choose
+ * \param plan      Pointer to Program parameters kept by the caller,
+ *                  with the planning mode and threads, and no
+ *                  coefficients before the first image
+ * \return Success or Failure
+ *
+ * This routine refits the range kernel only when T changes, as the
+ * daemon and the pipeline of many files do, and measures the
+ * backend on the first image in the measure mode.
+ */
+int plan_reuse(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float eps, int channels, float ***img,
+               spatial_backend request, program_params *plan);
+
+/**
+ * \brief Load planner wisdom from a file
+ * \param filename  Wisdom file
+ * \return Success or Failure; a missing file is not an error
+ */
+int wisdom_load(const char *filename);
+
+/**
+ * \brief Save planner wisdom to a file if it changed
+ * \param filename  Wisdom file
+ * \return Success or Failure
+ */
+int wisdom_save(const char *filename);
+
+/**
+ * \brief Open the cache file and map its records
+ * \param filename  Cache file, created when the cache is closed
+ * \return Success or Failure
+ *
+ * The cache keeps range kernel fits keyed by (T, sigmar, eps)
+ * and 1D spatial filter constants keyed by (sigma, backend).
+ */
+int cache_open(const char *filename);
+
+/**
+ * \brief Append the records computed by this run and unmap the cache
+ */
+void cache_close(void);
+
+/**
+ * \brief Fit the range kernel, or load the fit from the cache
+ * \param Tmax      Half period of the approximation
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the approximation error
+ * \param params    Pointer to Program parameters, T, K, coeff
+ *                  and error are filled
+ * \return Approximation error reached (Linfinity norm)
+ */
+float cache_fourier_coefficients(float Tmax, float sigmar, float eps, program_params *params);
+
+/**
+ * \brief Compute spatial filter constants, or load them from the cache
+ * \param backend   Spatial backend
+ * \param sigma     Standard deviation of the 1D Gaussian
+ * \param kernel    Pointer to filter constants to fill
+ */
+void cache_spatial_kernel(spatial_backend backend, float sigma, spatial_kernel *kernel);
+
+/**
+ * \brief Time of one frequency per pixel on one thread
+ * \param backend   Spatial backend
+ * \param channels  Number of channels, 1 to 4
+ * \return seconds per pixel
+ *
+ * Measured on a synthetic image the first time it is asked for
+ * each backend and number of channels, and kept for the run.
+ */
+double cost_frequency(spatial_backend backend, int channels);
+
+/**
+ * \brief Wall time of a round of one frequency per thread, per pixel
+ * \param backend   Spatial backend
+ * \param channels  Number of channels, 1 to 4
+ * \param threads   Number of threads
+ * \return seconds per pixel
+ *
+ * Measured as cost_frequency with the threads accumulating one
+ * frequency each at the same time, so that their parallel
+ * efficiency is included; cost_frequency is the round of one
+ * thread.
+ */
+double cost_round(spatial_backend backend, int channels, int threads);
+
+/**
+ * \brief Backend used for a request, without measuring the filter
+ * \param backend   Requested backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \param Tmax      Half period of the range kernel
+ * \param sigmar    Standard deviation of range kernel
+ * \param channels  Number of channels, 1 to 4
+ * \return backend itself, select_spatial_backend for SPATIAL_AUTO,
+ *         or the cheapest of all for SPATIAL_ANY
+ */
+spatial_backend cost_backend(spatial_backend backend, float Tmax, float sigmar, int channels);
+
+/**
+ * \brief Bytes of the buffers of shiftableBF_execute_joint
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param cx        Padding width of the auxiliary images left and right
+ * \param cy        Padding width of the auxiliary images above and below
+ * \param threads   Number of threads holding auxiliary images
+ * \return bytes of P, Q, F1 and the auxiliary images of the threads
+ */
+size_t cost_buffers(int m, int n, int channels, int cx, int cy, int threads);
+
+/**
+ * \brief Predict the time and peak memory of a filter
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered, 1 to 4
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param threads   Number of threads
+ * \param backend   Requested backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \param estimate  Pointer to the prediction to fill
+ * \return Success or Failure
+ *
+ * The costs per pixel are measured on this machine the first time
+ * they are needed. The range kernel is fitted for the largest T
+ * of images in [0, 255], so that the prediction bounds the cost of
+ * shiftableBF_channels with the estimate planning mode.
+ */
+int cost_predict(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float eps, int threads,
+                 spatial_backend backend, cost_estimate *estimate);
+
+/**
+ * \brief Open a binary PGM or PPM file for reading
+ * \param filename  Image file
+ * \param width     Image width, set
+ * \param height    Image height, set
+ * \param channels  1 for PGM, 3 for PPM, set
+ * \param offset    Position of the first pixel in the file, set
+ * \return open file, or NULL on failure
+ */
+FILE *pnm_open_read(const char *filename, int *width, int *height, int *channels, off_t *offset);
+
+/**
+ * \brief Create a binary PGM or PPM file
+ * \param filename  Image file
+ * \param width     Image width
+ * \param height    Image height
+ * \param channels  1 for PGM, 3 for PPM
+ * \param offset    Position of the first pixel in the file, set
+ * \return open file, or NULL on failure
+ */
+FILE *pnm_open_write(const char *filename, int width, int height, int channels, off_t *offset);
+
+/**
+ * \brief Read a rectangle of a PNM file
+ * \param file      File opened by pnm_open_read
+ * \param offset    Position of the first pixel in the file
+ * \param width     Image width
+ * \param channels  Number of channels of the file
+ * \param top       First row of the rectangle
+ * \param left      First column of the rectangle
+ * \param rows      Height of the rectangle
+ * \param columns   Width of the rectangle
+ * \param planes    Planes of at least rows x columns, one per
+ *                  channel, filled with values in [0, 255]
+ * \return Success or Failure
+ */
+int pnm_read_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                  float ***planes);
+
+/**
+ * \brief Write a rectangle of a PNM file
+ * \param file      File opened by pnm_open_write
+ * \param offset    Position of the first pixel in the file
+ * \param width     Image width
+ * \param channels  Number of channels of the file
+ * \param top       First row of the rectangle in the file
+ * \param left      First column of the rectangle in the file
+ * \param rows      Height of the rectangle
+ * \param columns   Width of the rectangle
+ * \param planes    Planes holding the rectangle, one per channel,
+ *                  rounded and clipped to [0, 255]
+ * \param ptop      First row of the rectangle in planes
+ * \param pleft     First column of the rectangle in planes
+ * \return Success or Failure
+ */
+int pnm_write_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                   float ***planes, int ptop, int pleft);
 
 /**
  * \brief Apply symmetric padding to input image
  * \param rows      Image height
  * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
  * \param in Pointer to input image padded with zeros
+ * \param wy        Padding width above and below
+ * \param wx        Padding width left and right
  *
  * This routine applies mirror boundary conditions
  * to input image which is zero padded i.e size of
- * input image will be [rows+2*w, columns+2*w]
+ * input image will be [rows+2*wy, columns+2*wx]
  */
-void symmetric_padding(int rows, int columns, fft_complex **in, int w);
+void symmetric_padding(int rows, int columns, int lanes, fft_complex **in, int wy, int wx);
 
 /**
  * \brief Calculating standard deviation of 1D array 
@@ -199,7 +1498,7 @@ void symmetric_padding(int rows, int columns, fft_complex **in, int w);
  * This routine takes 1D input array 'arr' and
  * calculate standard deviation of the array
  */
-float calculatestd(float *arr, int length);
+float calculatestd(float *arr, size_t length);
 
 /**
  * \brief Adding gaussian noise to input image
@@ -792,7 +792,7 @@ static int write_bmp(const uint32_t *image, int width, int height, FILE *file) {
                                 image, width, height);
 
     /* Decide whether to use 8-bit palette or 24-bit RGB format */
-    if (palette && 2 * num_colors < width * height)
+    if (palette && 2 * (size_t) num_colors < (size_t) width * height)
         use_palette = 1;
     else
         use_palette = num_colors = 0;
@@ -894,27 +894,28 @@ static int write_bmp(const uint32_t *image, int width, int height, FILE *file) {
 /** \brief Convert from RGBA U8 to a specified format */
 static void *convert_to_format(uint32_t *src, int width, int height,
                                unsigned format) {
-    const int num_pixels = width * height;
+    const size_t num_pixels = (size_t) width * height;
     const int num_channels = (format & IMAGEIO_GRAYSCALE) ?
                              1 : ((format & IMAGEIO_STRIP_ALPHA) ? 3 : 4);
-    const int channel_stride = (format & IMAGEIO_PLANAR) ? num_pixels : 1;
-    const int channel_stride2 = 2 * channel_stride;
-    const int channel_stride3 = 3 * channel_stride;
+    const size_t channel_stride = (format & IMAGEIO_PLANAR) ? num_pixels : 1;
+    const size_t channel_stride2 = 2 * channel_stride;
+    const size_t channel_stride3 = 3 * channel_stride;
     float *dest_f64;
     float *dest_f32;
     uint8_t *dest_u8;
     uint32_t pixel;
     int order[4] = {0, 1, 2, 3};
-    int i, x, y, pixel_stride, row_stride;
+    size_t i, pixel_stride, row_stride;
+    int x, y;
 
 
     pixel_stride = (format & IMAGEIO_PLANAR) ? 1 : num_channels;
 
     if (format & IMAGEIO_COLUMNMAJOR) {
         row_stride = pixel_stride;
-        pixel_stride *= height;
+        pixel_stride *= (size_t) height;
     } else
-        row_stride = width * pixel_stride;
+        row_stride = (size_t) width * pixel_stride;
 
     if (format & IMAGEIO_BGRFLIP) {
         order[0] = 2;
@@ -1091,18 +1092,19 @@ static void *convert_to_format(uint32_t *src, int width, int height,
 /** \brief Convert from a specified format to RGBA U8 */
 static uint32_t *convert_from_format(void *src, int width, int height,
                                      unsigned format) {
-    const int num_pixels = width * height;
+    const size_t num_pixels = (size_t) width * height;
     const int num_channels = (format & IMAGEIO_GRAYSCALE) ?
                              1 : ((format & IMAGEIO_STRIP_ALPHA) ? 3 : 4);
-    const int channel_stride = (format & IMAGEIO_PLANAR) ? num_pixels : 1;
-    const int channel_stride2 = 2 * channel_stride;
-    const int channel_stride3 = 3 * channel_stride;
+    const size_t channel_stride = (format & IMAGEIO_PLANAR) ? num_pixels : 1;
+    const size_t channel_stride2 = 2 * channel_stride;
+    const size_t channel_stride3 = 3 * channel_stride;
     float *src_f64 = (float *) src;
     float *src_f32 = (float *) src;
     uint8_t *src_u8 = (uint8_t *) src;
     uint8_t *dest, *dest_ptr;
     int order[4] = {0, 1, 2, 3};
-    int i, x, y, pixel_stride, row_stride;
+    size_t i, pixel_stride, row_stride;
+    int x, y;
 
     if (!(dest = (uint8_t *) malloc(sizeof(uint32_t) * num_pixels)))
         return NULL;
@@ -1112,9 +1114,9 @@ static uint32_t *convert_from_format(void *src, int width, int height,
 
     if (format & IMAGEIO_COLUMNMAJOR) {
         row_stride = pixel_stride;
-        pixel_stride *= height;
+        pixel_stride *= (size_t) height;
     } else
-        row_stride = width * pixel_stride;
+        row_stride = (size_t) width * pixel_stride;
 
     if (format & IMAGEIO_BGRFLIP) {
         order[0] = 2;
@@ -1480,3 +1482,211 @@ int write_image(void *image, int width, int height,
     free(image_u8);
     return success;
 }
+
+
+/** \brief Read a line of at most capacity - 1 chars, without its newline */
+static int read_line(char *line, int capacity, FILE *file) {
+    int c, length = 0;
+
+    while ((c = getc(file)) != EOF && c != '\n') {
+        if (length == capacity - 1)
+            return -1;
+        line[length++] = (char) c;
+    }
+
+    line[length] = '\0';
+    return (c == EOF && length == 0) ? 0 : 1;
+}
+
+
+/**
+* \brief Open a YUV4MPEG2 file for reading
+*
+* \param filename file name, or "-" for the standard input
+*
+* \return Pointer to the stream, or null on failure
+*
+* The stream header is parsed for the frame size (W and H tags) and the
+* chroma subsampling (C tag): 420jpeg, 420paldv, 420mpeg2 and 420 (the
+* default) have chroma planes of half the width and height, 422 of half
+* the width, 444 of the full size, and mono has none. Other tags, such as
+* the frame rate and aspect ratio, are kept in the header. Only 8-bit
+* samples are supported. The stream is released with \c y4m_close.
+*/
+y4m_stream *y4m_open_read(const char *filename) {
+    y4m_stream *stream;
+    char header[Y4M_HEADER_CAPACITY], *token, *save;
+    int sub_x = 2, sub_y = 2, mono = 0;
+
+    if (!(stream = (y4m_stream *) calloc(1, sizeof(y4m_stream))))
+        return NULL;
+
+    stream->file = (strcmp(filename, "-") == 0) ? stdin : fopen(filename, "rb");
+    if (!stream->file || read_line(stream->header, Y4M_HEADER_CAPACITY,
+                                   stream->file) != 1
+        || strncmp(stream->header, "YUV4MPEG2 ", 10)) {
+        fprintf(stderr, "Invalid Y4M header in \"%s\".\n", filename);
+        y4m_close(stream);
+        return NULL;
+    }
+
+    strcpy(header, stream->header);
+    for (token = strtok_r(header + 10, " ", &save); token;
+         token = strtok_r(NULL, " ", &save)) {
+        if (token[0] == 'W')
+            stream->width = atoi(token + 1);
+        else if (token[0] == 'H')
+            stream->height = atoi(token + 1);
+        else if (token[0] == 'C') {
+            if (!strcmp(token, "C420jpeg") || !strcmp(token, "C420paldv")
+                || !strcmp(token, "C420mpeg2") || !strcmp(token, "C420"))
+                sub_x = sub_y = 2;
+            else if (!strcmp(token, "C422")) {
+                sub_x = 2;
+                sub_y = 1;
+            } else if (!strcmp(token, "C444"))
+                sub_x = sub_y = 1;
+            else if (!strcmp(token, "Cmono"))
+                mono = 1;
+            else {
+                fprintf(stderr, "Unsupported Y4M colour space %s.\n",
+                        token + 1);
+                y4m_close(stream);
+                return NULL;
+            }
+        }
+    }
+
+    if (stream->width <= 0 || stream->height <= 0
+        || stream->width > MAX_IMAGE_SIZE || stream->height > MAX_IMAGE_SIZE) {
+        fprintf(stderr, "Invalid Y4M frame size in \"%s\".\n", filename);
+        y4m_close(stream);
+        return NULL;
+    }
+
+    if (!mono) {
+        stream->chroma_width = (stream->width + sub_x - 1) / sub_x;
+        stream->chroma_height = (stream->height + sub_y - 1) / sub_y;
+    }
+
+    return stream;
+}
+
+
+/**
+* \brief Open a YUV4MPEG2 file for writing
+*
+* \param filename file name, or "-" for the standard output
+* \param format stream whose header and frame size are written
+*
+* \return Pointer to the stream, or null on failure
+*/
+y4m_stream *y4m_open_write(const char *filename, const y4m_stream *format) {
+    y4m_stream *stream;
+
+    if (!(stream = (y4m_stream *) malloc(sizeof(y4m_stream))))
+        return NULL;
+
+    *stream = *format;
+    stream->file = (strcmp(filename, "-") == 0) ? stdout : fopen(filename, "wb");
+    if (!stream->file || fprintf(stream->file, "%s\n", stream->header) < 0) {
+        fprintf(stderr, "Failed to write \"%s\".\n", filename);
+        y4m_close(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+/**
+* \brief Size of a frame of a YUV4MPEG2 stream
+*
+* \param stream pointer to the stream
+*
+* \return Number of bytes of the planes of a frame, Y then U then V
+*/
+size_t y4m_frame_size(const y4m_stream *stream) {
+    return (size_t) stream->width * stream->height
+           + 2 * (size_t) stream->chroma_width * stream->chroma_height;
+}
+
+
+/**
+* \brief Read the next frame of a YUV4MPEG2 stream
+*
+* \param stream pointer to the stream
+* \param frame destination of \c y4m_frame_size bytes, filled with the Y,
+*        U and V planes in row major order
+*
+* \return 1 on success, 0 at the end of the stream, -1 on failure
+*
+* The parameters of the frame header are ignored.
+*/
+int y4m_read_frame(y4m_stream *stream, uint8_t *frame) {
+    char line[Y4M_HEADER_CAPACITY];
+    int status = read_line(line, Y4M_HEADER_CAPACITY, stream->file);
+    size_t size = y4m_frame_size(stream);
+
+    if (status == 0)
+        return 0;
+
+    if (status < 0 || strncmp(line, "FRAME", 5)
+        || (line[5] != '\0' && line[5] != ' ')) {
+        fprintf(stderr, "Invalid Y4M frame header.\n");
+        return -1;
+    }
+
+    if (fread(frame, 1, size, stream->file) != size) {
+        fprintf(stderr, "Y4M frame is truncated.\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+
+/**
+* \brief Write a frame to a YUV4MPEG2 stream
+*
+* \param stream pointer to the stream
+* \param frame \c y4m_frame_size bytes of the Y, U and V planes
+*
+* \return 1 on success, 0 on failure
+*/
+int y4m_write_frame(y4m_stream *stream, const uint8_t *frame) {
+    size_t size = y4m_frame_size(stream);
+
+    if (fputs("FRAME\n", stream->file) < 0
+        || fwrite(frame, 1, size, stream->file) != size) {
+        fprintf(stderr, "Error during write to file.\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+* \brief Close a YUV4MPEG2 stream and release it
+*
+* \param stream pointer to the stream, or null
+*
+* \return 1 on success, 0 if pending frames could not be written
+*
+* The standard input and output are flushed but not closed.
+*/
+int y4m_close(y4m_stream *stream) {
+    int success = 1;
+
+    if (!stream)
+        return 1;
+
+    if (stream->file == stdin || stream->file == stdout)
+        success = (fflush(stream->file) == 0 || stream->file == stdin);
+    else if (stream->file)
+        success = (fclose(stream->file) == 0);
+
+    free(stream);
+    return success;
+}
@@ -23,8 +23,9 @@
 #include <stdio.h>
 #include "basic.h"
 
-/** \brief Limit on the maximum allowed image width or height (security). */
-#define MAX_IMAGE_SIZE 10000
+/** \brief Limit on the maximum allowed image width or height (security),
+ * that of the stb_image reader. Pixel counts and offsets are size_t. */
+#define MAX_IMAGE_SIZE (1 << 24)
 
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -57,6 +58,20 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+/** \brief Capacity of the stream header of a YUV4MPEG2 file */
+#define Y4M_HEADER_CAPACITY   1024
+
+/** \brief YUV4MPEG2 (.y4m) video stream of 8-bit planar frames */
+typedef struct {
+    FILE *file;
+    /** \brief Size of the luma plane */
+    int width, height;
+    /** \brief Size of each of the two chroma planes, 0 for Cmono */
+    int chroma_width, chroma_height;
+    /** \brief Stream header, without its newline, written to the output */
+    char header[Y4M_HEADER_CAPACITY];
+} y4m_stream;
+
 int identify_image_type(char *type, const char *filename);
 
 void *read_image(int *width, int *height,
@@ -65,4 +80,16 @@ void *read_image(int *width, int *height,
 int write_image(void *image, int width, int height,
                 const char *filename, unsigned format, int quality);
 
+y4m_stream *y4m_open_read(const char *filename);
+
+y4m_stream *y4m_open_write(const char *filename, const y4m_stream *format);
+
+size_t y4m_frame_size(const y4m_stream *stream);
+
+int y4m_read_frame(y4m_stream *stream, uint8_t *frame);
+
+int y4m_write_frame(y4m_stream *stream, const uint8_t *frame);
+
+int y4m_close(y4m_stream *stream);
+
 #endif /* _IMAGEIO_H_ */
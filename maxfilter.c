@@ -24,26 +24,27 @@
  * \brief Find T = max{x} ( max{||y||<=R} (|f(x-y)-f(x)|) )
  *        (using Max-Filter Algorithm)
  * \param fin       Pointer to input image
- * \param w         Wdith of spatial kernel
+ * \param wy        Height of spatial kernel
+ * \param wx        Width of spatial kernel
  * \param m         Image height
  * \param n         Image width
  * \return T
  *
  * This routine computes the maximum value T input to the
  * range filter for the input image fin and spatial kernel
- * of width w.
+ * of size wy x wx.
  * Max-Filter Algorithm is used to calculate local maximums.  
  */
-float maxfilterfind(float **fin, int w, int m, int n) {
-    /** \brief Radius of spatial kernel */
-    int c = (w - 1) / 2;
-    float T = 0.0f, temp;
+float maxfilterfind(float **fin, int wy, int wx, int m, int n) {
+    /** \brief Radii of spatial kernel */
+    int cy = (wy - 1) / 2, cx = (wx - 1) / 2;
+    float T = 0.0f, temp = 0.0f;
 
     /* Pad to divide rows and columns into integral number of max-filter windows */
-    int rowceilvalue = (int) ceilf((float) m / w);
-    int columnceilvalue = (int) ceilf((float) n / w);
-    int rowpad = (rowceilvalue * w) - m;
-    int columnpad = (columnceilvalue * w) - n;
+    int rowceilvalue = (int) ceilf((float) m / wy);
+    int columnceilvalue = (int) ceilf((float) n / wx);
+    int rowpad = (rowceilvalue * wy) - m;
+    int columnpad = (columnceilvalue * wx) - n;
     int mpad = m + rowpad;
     int npad = n + columnpad;
     float **template = alloc_array(mpad, npad);
@@ -64,7 +65,7 @@ float maxfilterfind(float **fin, int w, int m, int n) {
         R = calloc(npad, sizeof(float));
 
         for (k = 0; k < npad; k++) {
-            if ((k % w) == 0) {
+            if ((k % wx) == 0) {
                 /* Reset the recursion at boundary of parition */
                 L[k] = template[i][k];
                 R[npad - 1 - k] = template[i][npad - 1 - k];
@@ -77,14 +78,14 @@ float maxfilterfind(float **fin, int w, int m, int n) {
 
         /* Compute local maximums along rows from the 2 local running maximums */
         for (k = 0; k < npad; k++) {
-            if (k - c < 0)
+            if (k - cx < 0)
                 r = 0;
             else
-                r = R[k - c];
-            if (k + c > (npad - 1))
+                r = R[k - cx];
+            if (k + cx > (npad - 1))
                 l = 0;
             else
-                l = L[k + c];
+                l = L[k + cx];
             /* Store in template */
             template[i][k] = max(r, l);
         }
@@ -100,7 +101,7 @@ float maxfilterfind(float **fin, int w, int m, int n) {
 
 
         for (k = 0; k < mpad; k++) {
-            if ((k % w) == 0) {
+            if ((k % wy) == 0) {
                 /* Reset the recursion at boundary of parition */
                 L[k] = template[k][j];
                 R[mpad - 1 - k] = template[mpad - 1 - k][j];
@@ -114,14 +115,14 @@ float maxfilterfind(float **fin, int w, int m, int n) {
         /* Compute local maximums along columns from the 2 local running maximums */
         /* This gives the local maximums over 2D spatial kernels, from which T is computed */
         for (k = 0; k < mpad; k++) {
-            if (k - c < 0)
+            if (k - cy < 0)
                 r = 0;
             else
-                r = R[k - c];
-            if (k + c > (npad - 1))
+                r = R[k - cy];
+            if (k + cy > (mpad - 1))
                 l = 0;
             else
-                l = L[k + c];
+                l = L[k + cy];
             if (k < m)
                 temp = max(r, l) - fin[k][j];
             if (temp > T)
@@ -130,6 +131,7 @@ float maxfilterfind(float **fin, int w, int m, int n) {
         free(L);
         free(R);
     }
+    dealloc_array_fl(template, mpad);
     return T;
 }
 
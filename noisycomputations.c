@@ -34,17 +34,16 @@ pid_t getpid();
  * This routine takes 1D input array 'arr' and
  * calculate standard deviation of the array
  */
-float calculatestd(float *arr, int length) {
-    int i;
-    float mean = 0.0, std = 0.0;
+float calculatestd(float *arr, size_t length) {
+    size_t i;
+    double mean = 0.0, std = 0.0; /* Sums over large images lose precision in float */
     for (i = 0; i < length; i++)
         mean += arr[i];
     mean /= length;
     for (i = 0; i < length; i++)
         std += ((arr[i] - mean) * (arr[i] - mean));
     std /= length;
-    std = sqrtf(std);
-    return std;
+    return sqrtf((float) std);
 }
 
 /**
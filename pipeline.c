@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file pipeline.c
+ * @brief Fast bilateral filter of a directory or list of image files
+ *
+ * Decoding and encoding an image file take as long as filtering it,
+ * and leave the cores idle when run in sequence with the filter.
+ * The files are instead filtered by a pipeline of three stages
+ * joined by bounded queues: I/O threads decode the next images
+ * ahead, the team of threads of the filter filters them one after
+ * the other, and other I/O threads encode the filtered images
+ * behind. The queues bound the images held in memory. The range
+ * kernel fit is kept from image to image while T does not change.
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/** \brief Longest path of an image file */
+#define PIPELINE_PATH 4096
+
+int shiftableBF_pipeline(const char *input, const char *outdir, int format, int filtered, float sigmas_x,
+                         float sigmas_y, float sigmar, int io_threads, int depth, int cores, program_params *params,
+                         float eps);
+
+/** \brief Image in flight through the pipeline */
+typedef struct {
+    /** \brief Index in the list of files */
+    int index;
+    int m, n;
+    /** \brief Planes decoded by imageio, in [0, 1] */
+    float *image;
+    /** \brief Filtered channels, in [0, 255] */
+    float **img[4], **out[4];
+} pipeline_image;
+
+/** \brief Bounded queue of images between two stages */
+typedef struct {
+    pipeline_image **items;
+    int capacity, head, count;
+    /** \brief Whether the producing stage is done */
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+} pipeline_queue;
+
+/** \brief State shared by the stages */
+typedef struct {
+    /** \brief Input files, and output files */
+    char **inputs, **outputs;
+    int count;
+    /** \brief Channels read from and written to the files, and number of channels filtered */
+    int format, filtered;
+    /** \brief Next file decoded, decoders running, and files which failed */
+    int next, decoders, failures;
+    /** \brief Seconds spent decoding and encoding by all the I/O threads */
+    double decode_busy, encode_busy;
+    pthread_mutex_t lock;
+    pipeline_queue decoded, filtered_queue;
+} pipeline;
+
+/**
+ * \brief Initialize a queue
+ * \param queue     Pointer to the queue
+ * \param capacity  Images held at most
+ */
+static void pipeline_queue_init(pipeline_queue *queue, int capacity) {
+    queue->items = (pipeline_image **) calloc(capacity, sizeof(pipeline_image *));
+    queue->capacity = capacity;
+    queue->head = queue->count = 0;
+    queue->closed = false;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+}
+
+/**
+ * \brief Release a queue
+ * \param queue     Pointer to the queue, empty
+ */
+static void pipeline_queue_destroy(pipeline_queue *queue) {
+    free(queue->items);
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+/**
+ * \brief Append an image, waiting while the queue is full
+ * \param queue     Pointer to the queue
+ * \param image     Image appended
+ */
+static void pipeline_queue_push(pipeline_queue *queue, pipeline_image *image) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    queue->items[(queue->head + queue->count) % queue->capacity] = image;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * \brief Remove the first image, waiting while the queue is empty
+ * \param queue     Pointer to the queue
+ * \return image, or NULL once the queue is closed and empty
+ */
+static pipeline_image *pipeline_queue_pop(pipeline_queue *queue) {
+    pipeline_image *image = NULL;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    if (queue->count > 0) {
+        image = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return image;
+}
+
+/**
+ * \brief Close a queue once its producing stage is done
+ * \param queue     Pointer to the queue
+ */
+static void pipeline_queue_close(pipeline_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * \brief Release an image and its planes
+ * \param image     Image, or NULL
+ * \param filtered  Number of channels filtered
+ */
+static void pipeline_image_free(pipeline_image *image, int filtered) {
+    if (image == NULL)
+        return;
+    for (int c = 0; c < filtered; c++) {
+        dealloc_array_fl(image->img[c], image->m);
+        dealloc_array_fl(image->out[c], image->m);
+    }
+    free(image->image);
+    free(image);
+}
+
+/**
+ * \brief Count a file which failed
+ * \param pipe      Pointer to the pipeline
+ */
+static void pipeline_failure(pipeline *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    pipe->failures++;
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+/**
+ * \brief Decoding stage: read the next files into the decoded queue
+ * \param arg       Pointer to the pipeline
+ * \return NULL
+ *
+ * The last decoder to finish closes the decoded queue.
+ */
+static void *pipeline_decode(void *arg) {
+    pipeline *pipe = (pipeline *) arg;
+    int index, c, i, j;
+    double busy = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pipe->lock);
+        index = pipe->next++;
+        pthread_mutex_unlock(&pipe->lock);
+        if (index >= pipe->count)
+            break;
+
+        double start = now();
+        pipeline_image *image = (pipeline_image *) calloc(1, sizeof(pipeline_image));
+        image->index = index;
+        image->image = (float *) read_image(&image->n, &image->m, pipe->inputs[index],
+                                            IMAGEIO_float | IMAGEIO_PLANAR | pipe->format);
+        if (image->image == NULL) {
+            fprintf(stderr, "Reading image %s failed \n", pipe->inputs[index]);
+            pipeline_failure(pipe);
+            free(image);
+            busy += calcElapsed(start, now());
+            continue;
+        }
+        const size_t size = (size_t) image->m * image->n;
+        bool allocated = true;
+        for (c = 0; c < pipe->filtered; c++) {
+            image->img[c] = alloc_array(image->m, image->n);
+            image->out[c] = alloc_array(image->m, image->n);
+            allocated = allocated && image->img[c] != NULL && image->out[c] != NULL;
+            for (i = 0; allocated && i < image->m; i++)
+                for (j = 0; j < image->n; j++)
+                    image->img[c][i][j] = image->image[c * size + (size_t) i * image->n + j] * 255.0f;
+        }
+        if (!allocated) {
+            fprintf(stderr, "Allocating the planes of image %s failed \n", pipe->inputs[index]);
+            pipeline_failure(pipe);
+            pipeline_image_free(image, pipe->filtered);
+            busy += calcElapsed(start, now());
+            continue;
+        }
+        busy += calcElapsed(start, now());
+        pipeline_queue_push(&pipe->decoded, image);
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->decode_busy += busy;
+    bool last = --pipe->decoders == 0;
+    pthread_mutex_unlock(&pipe->lock);
+    if (last)
+        pipeline_queue_close(&pipe->decoded);
+    return NULL;
+}
+
+/**
+ * \brief Encoding stage: write the filtered images until the queue is closed
+ * \param arg       Pointer to the pipeline
+ * \return NULL
+ */
+static void *pipeline_encode(void *arg) {
+    pipeline *pipe = (pipeline *) arg;
+    pipeline_image *image;
+    int c, i, j;
+    double busy = 0;
+
+    while ((image = pipeline_queue_pop(&pipe->filtered_queue)) != NULL) {
+        double start = now();
+        const size_t size = (size_t) image->m * image->n;
+        for (c = 0; c < pipe->filtered; c++)
+            for (i = 0; i < image->m; i++)
+                for (j = 0; j < image->n; j++)
+                    image->image[c * size + (size_t) i * image->n + j] = image->out[c][i][j] / 255.0f;
+        if (write_image(image->image, image->n, image->m, pipe->outputs[image->index],
+                        IMAGEIO_float | IMAGEIO_PLANAR | pipe->format, 100) != 1) {
+            fprintf(stderr, "Writing image %s failed \n", pipe->outputs[image->index]);
+            pipeline_failure(pipe);
+        }
+        pipeline_image_free(image, pipe->filtered);
+        busy += calcElapsed(start, now());
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->encode_busy += busy;
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+/**
+ * \brief Whether a file name has the extension of an image read by imageio
+ * \param name      File name
+ * \return true for png, jpg, jpeg, bmp, gif, tga, pgm, ppm and pnm files
+ */
+static bool pipeline_is_image(const char *name) {
+    static const char *extensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".gif", ".tga", ".pgm", ".ppm", ".pnm"};
+    const char *dot = strrchr(name, '.');
+    for (size_t e = 0; dot != NULL && e < sizeof(extensions) / sizeof(extensions[0]); e++) {
+        if (strcasecmp(dot, extensions[e]) == 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Order of two file names
+ * \param a         Pointer to the first name
+ * \param b         Pointer to the second name
+ * \return strcmp of the names
+ */
+static int pipeline_compare(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * \brief List the input files
+ * \param input     Directory, whose image files are listed in name
+ *                  order, or list file holding one path per line
+ * \param count     Number of files, set
+ * \return paths, each and the array to be freed, or NULL if there are
+ *         none or input cannot be read
+ */
+static char **pipeline_list(const char *input, int *count) {
+    char **paths = NULL, line[PIPELINE_PATH];
+    int capacity = 0;
+    struct stat st;
+
+    *count = 0;
+    if (stat(input, &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(input);
+        struct dirent *entry;
+        if (dir == NULL)
+            return NULL;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.' || !pipeline_is_image(entry->d_name))
+                continue;
+            if (*count == capacity) {
+                capacity = max(2 * capacity, 64);
+                paths = (char **) realloc(paths, capacity * sizeof(char *));
+            }
+            paths[*count] = (char *) malloc(strlen(input) + strlen(entry->d_name) + 2);
+            sprintf(paths[(*count)++], "%s/%s", input, entry->d_name);
+        }
+        closedir(dir);
+        if (*count > 0)
+            qsort(paths, *count, sizeof(char *), pipeline_compare);
+    } else {
+        FILE *list = fopen(input, "r");
+        if (list == NULL)
+            return NULL;
+        while (fgets(line, sizeof(line), list) != NULL) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0')
+                continue;
+            if (*count == capacity) {
+                capacity = max(2 * capacity, 64);
+                paths = (char **) realloc(paths, capacity * sizeof(char *));
+            }
+            paths[(*count)++] = strdup(line);
+        }
+        fclose(list);
+    }
+    return paths;
+}
+
+/**
+ * \brief Output file of an input file
+ * \param outdir    Output directory
+ * \param path      Input file
+ * \param full      Whether the output is named after the whole path,
+ *                  rather than the file name
+ * \return outdir/name of path, with the extension png unless it is
+ *         bmp, jpg, jpeg or png, to be freed
+ *
+ * With full, the '/' of the path become '_', and an extension
+ * replaced by png is kept in the name as "_ext", so that dir/x.jpg
+ * is written to outdir/dir_x.jpg and a.pgm to outdir/a_pgm.png.
+ */
+static char *pipeline_output(const char *outdir, const char *path, bool full) {
+    const char *name = strrchr(path, '/');
+    name = (name != NULL) ? name + 1 : path;
+    if (full) {
+        while (strncmp(path, "./", 2) == 0)
+            path += 2;
+        name = path + strspn(path, "/");
+    }
+    const char *dot = strrchr(name, '.');
+    if (dot != NULL && strchr(dot, '/') != NULL)
+        dot = NULL;
+    size_t stem = (dot != NULL) ? (size_t) (dot - name) : strlen(name);
+    bool keep = dot != NULL && (strcasecmp(dot, ".bmp") == 0 || strcasecmp(dot, ".jpg") == 0 ||
+                                strcasecmp(dot, ".jpeg") == 0 || strcasecmp(dot, ".png") == 0);
+    char *output = (char *) malloc(strlen(outdir) + strlen(name) + 6);
+    sprintf(output, "%s/%.*s", outdir, (int) stem, name);
+    char *last = output + strlen(outdir) + 1;
+    if (full) {
+        for (char *p = last; *p != '\0'; p++) {
+            if (*p == '/')
+                *p = '_';
+        }
+    }
+    if (full && dot != NULL && !keep)
+        sprintf(output + strlen(output), "_%s.png", dot + 1);
+    else
+        strcat(output, keep ? dot : ".png");
+    return output;
+}
+
+/**
+ * \brief Order of two output files
+ * \param a         Pointer to a pointer to the first name
+ * \param b         Pointer to a pointer to the second name
+ * \return strcmp of the names
+ */
+static int pipeline_compare_outputs(const void *a, const void *b) {
+    return strcmp(**(char **const *) a, **(char **const *) b);
+}
+
+/**
+ * \brief Name the output files, keeping them distinct
+ * \param outdir    Output directory
+ * \param inputs    Input files
+ * \param count     Number of files
+ * \return output files, each and the array to be freed, or NULL if
+ *         two inputs still share an output
+ *
+ * The outputs are named after the file names of the inputs; those
+ * which collide, from files of the same name in different
+ * directories or with different extensions, are named after the
+ * whole input path instead.
+ */
+static char **pipeline_outputs(const char *outdir, char **inputs, int count) {
+    char **outputs = (char **) calloc(count, sizeof(char *));
+    char ***order = (char ***) calloc(count, sizeof(char **));
+    bool *collides = (bool *) calloc(count, sizeof(bool));
+    int i, j, pass;
+
+    for (i = 0; i < count; i++)
+        outputs[i] = pipeline_output(outdir, inputs[i], false);
+    for (pass = 0; pass < 2; pass++) {
+        bool found = false;
+        for (i = 0; i < count; i++)
+            order[i] = &outputs[i];
+        qsort(order, count, sizeof(char **), pipeline_compare_outputs);
+        for (i = 1; i < count; i++) {
+            if (strcmp(*order[i - 1], *order[i]) == 0) {
+                collides[order[i - 1] - outputs] = collides[order[i] - outputs] = true;
+                found = true;
+            }
+        }
+        if (!found)
+            break;
+        if (pass == 1) {
+            for (i = 1; i < count; i++) {
+                if (strcmp(*order[i - 1], *order[i]) == 0) {
+                    printf("Images %s and %s would both be written to %s \n", inputs[order[i - 1] - outputs],
+                           inputs[order[i] - outputs], *order[i]);
+                    break;
+                }
+            }
+            for (j = 0; j < count; j++)
+                free(outputs[j]);
+            free(outputs);
+            outputs = NULL;
+            break;
+        }
+        for (i = 0; i < count; i++) {
+            if (collides[i]) {
+                free(outputs[i]);
+                outputs[i] = pipeline_output(outdir, inputs[i], true);
+            }
+        }
+    }
+    free(order);
+    free(collides);
+    return outputs;
+}
+
+/**
+ * \brief Filter a decoded image with the plan of the batch
+ * \param image     Decoded image, filtered in place into its output planes
+ * \param filtered  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param defaults  Requested backend and planning mode
+ * \param plan      Plan kept from image to image (see plan_reuse)
+ * \return Success or Failure
+ */
+static int pipeline_filter(pipeline_image *image, int filtered, float sigmas_x, float sigmas_y, float sigmar, float eps,
+                           const program_params *defaults, program_params *plan) {
+    int status = plan_reuse(image->m, image->n, sigmas_x, sigmas_y, sigmar, eps, filtered, image->img,
+                            defaults->backend, plan);
+    if (status == EXIT_SUCCESS)
+        status = shiftableBF_execute_channels(image->m, image->n, filtered, sigmas_x, sigmas_y, image->img, image->out,
+                                              plan);
+    return status;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to many image files
+ * \param input     Directory of image files, or list file holding one
+ *                  path per line
+ * \param outdir    Directory of the filtered files, created if needed,
+ *                  which keep the names of the input files
+ * \param format    Channels read from and written to the image files
+ * \param filtered  Number of channels filtered, alpha is copied
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param io_threads Threads decoding, and threads encoding
+ * \param depth     Images held by each queue between two stages
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to the plan of
+ *                  the last image, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success, or Failure if any file could not be listed, read,
+ *         filtered or written; the other files are still filtered
+ *
+ * The images per second and the utilization of each stage, the
+ * fraction of the time its threads were busy, are printed at the end.
+ */
+int shiftableBF_pipeline(const char *input, const char *outdir, int format, int filtered, float sigmas_x,
+                         float sigmas_y, float sigmar, int io_threads, int depth, int cores, program_params *params,
+                         float eps) {
+    pipeline pipe;
+    program_params plan = *params;
+    double start = now(), filter_busy = 0;
+    int t, done = 0;
+    struct stat st;
+
+    pipe.inputs = pipeline_list(input, &pipe.count);
+    if (pipe.inputs == NULL || pipe.count == 0) {
+        printf("No image file listed in %s \n", input);
+        free(pipe.inputs);
+        return EXIT_FAILURE;
+    }
+    if (mkdir(outdir, 0755) != 0 && (stat(outdir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+        printf("Creating directory %s failed \n", outdir);
+        for (t = 0; t < pipe.count; t++)
+            free(pipe.inputs[t]);
+        free(pipe.inputs);
+        return EXIT_FAILURE;
+    }
+    pipe.outputs = pipeline_outputs(outdir, pipe.inputs, pipe.count);
+    if (pipe.outputs == NULL) {
+        for (t = 0; t < pipe.count; t++)
+            free(pipe.inputs[t]);
+        free(pipe.inputs);
+        return EXIT_FAILURE;
+    }
+    pipe.format = format;
+    pipe.filtered = filtered;
+    pipe.next = pipe.failures = 0;
+    pipe.decoders = io_threads;
+    pipe.decode_busy = pipe.encode_busy = 0;
+    pthread_mutex_init(&pipe.lock, NULL);
+    pipeline_queue_init(&pipe.decoded, depth);
+    pipeline_queue_init(&pipe.filtered_queue, depth);
+    plan.coeff = NULL;
+    plan.T = 0;
+    plan.threads = max(cores, 1);
+
+    pthread_t *decoders = (pthread_t *) calloc(io_threads, sizeof(pthread_t));
+    pthread_t *encoders = (pthread_t *) calloc(io_threads, sizeof(pthread_t));
+    int decoding = 0, encoding = 0; /** \brief Threads started in each I/O stage */
+    for (t = 0; t < io_threads; t++) {
+        if (pthread_create(&decoders[decoding], NULL, pipeline_decode, &pipe) == 0)
+            decoding++;
+        if (pthread_create(&encoders[encoding], NULL, pipeline_encode, &pipe) == 0)
+            encoding++;
+    }
+    /* The decoders not started are done, and without encoders no more file is decoded */
+    pthread_mutex_lock(&pipe.lock);
+    pipe.decoders -= io_threads - decoding;
+    bool closed = pipe.decoders == 0;
+    if (encoding == 0)
+        pipe.next = pipe.count;
+    pthread_mutex_unlock(&pipe.lock);
+    if (closed)
+        pipeline_queue_close(&pipe.decoded);
+    if (decoding < io_threads || encoding < io_threads)
+        printf("Started %d of %d decoders and %d of %d encoders \n", decoding, io_threads, encoding, io_threads);
+
+    /* Filtering stage, on this thread with the team of the filter */
+    pipeline_image *image;
+    while ((image = pipeline_queue_pop(&pipe.decoded)) != NULL) {
+        double begin = now();
+        if (pipeline_filter(image, filtered, sigmas_x, sigmas_y, sigmar, eps, params, &plan) != EXIT_SUCCESS) {
+            fprintf(stderr, "Filtering image %s failed \n", pipe.inputs[image->index]);
+            pipeline_failure(&pipe);
+            pipeline_image_free(image, filtered);
+        } else if (encoding == 0) {
+            pipeline_failure(&pipe);
+            pipeline_image_free(image, filtered);
+        } else {
+            filter_busy += calcElapsed(begin, now());
+            pipeline_queue_push(&pipe.filtered_queue, image);
+        }
+        if (++done % 100 == 0)
+            printf("%d images, %.2f images/s \n", done, done / calcElapsed(start, now()));
+    }
+    pipeline_queue_close(&pipe.filtered_queue);
+    for (t = 0; t < decoding; t++)
+        pthread_join(decoders[t], NULL);
+    for (t = 0; t < encoding; t++)
+        pthread_join(encoders[t], NULL);
+
+    double elapsed = calcElapsed(start, now());
+    printf("%d images of %d in %f s, %.2f images/s, %d failed \n", pipe.count - pipe.failures, pipe.count, elapsed,
+           (pipe.count - pipe.failures) / elapsed, pipe.failures);
+    printf("Utilization: decode %.0f%%, filter %.0f%%, encode %.0f%% (%d I/O threads per stage, %d filter threads) \n",
+           100 * pipe.decode_busy / (elapsed * max(decoding, 1)), 100 * filter_busy / elapsed,
+           100 * pipe.encode_busy / (elapsed * max(encoding, 1)), io_threads, plan.threads);
+
+    int status = (pipe.failures == 0 && decoding > 0 && encoding > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    free(plan.coeff);
+    plan.coeff = NULL;
+    *params = plan;
+    for (t = 0; t < pipe.count; t++) {
+        free(pipe.inputs[t]);
+        free(pipe.outputs[t]);
+    }
+    free(pipe.inputs);
+    free(pipe.outputs);
+    free(decoders);
+    free(encoders);
+    pipeline_queue_destroy(&pipe.decoded);
+    pipeline_queue_destroy(&pipe.filtered_queue);
+    pthread_mutex_destroy(&pipe.lock);
+    return status;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file planner.c
+ * @brief Measured choice of spatial backend and thread count,
+ * remembered across runs in a wisdom file
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+
+/** \brief Largest side of the crop used for timing candidates */
+#define PLAN_CROP_SIZE 256
+/** \brief Maximum number of plans kept in the wisdom */
+#define WISDOM_MAX 256
+/** \brief First line of a wisdom file, carries the format version */
+#define WISDOM_HEADER "# fbf wisdom 3"
+
+/** \brief Plan remembered for one problem */
+typedef struct {
+    /** \brief Problem: image size, spatial s.d. along rows and columns, channels, number of coefficients */
+    int m, n;
+    float sigmas_x, sigmas_y;
+    int channels, K;
+    /** \brief Physical cores available and backend requested */
+    int cores;
+    spatial_backend request;
+    /** \brief Plan: fastest backend and number of threads */
+    spatial_backend backend;
+    int threads;
+    /** \brief Time measured for the crop */
+    float seconds;
+} wisdom_entry;
+
+static wisdom_entry wisdom[WISDOM_MAX];
+static int wisdom_count = 0;
+static bool wisdom_changed = false;
+
+int plan_measure(int m, int n, float sigmas_x, float sigmas_y, int channels, float ***img, program_params *params);
+
+int plan_reuse(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float eps, int channels, float ***img,
+               spatial_backend request, program_params *plan);
+
+int wisdom_load(const char *filename);
+
+int wisdom_save(const char *filename);
+
+/**
+ * \brief Add a plan to the wisdom
+ * \param entry     Plan to add
+ *
+ * When the wisdom is full the oldest plan is dropped.
+ */
+static void wisdom_add(const wisdom_entry *entry) {
+    if (wisdom_count == WISDOM_MAX) {
+        memmove(wisdom, wisdom + 1, (WISDOM_MAX - 1) * sizeof(wisdom_entry));
+        wisdom_count--;
+    }
+    wisdom[wisdom_count++] = *entry;
+}
+
+/**
+ * \brief Load planner wisdom from a file
+ * \param filename  Wisdom file
+ * \return Success or Failure; a missing file is not an error
+ */
+int wisdom_load(const char *filename) {
+    char line[256], request[16], backend[16];
+    wisdom_entry e;
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+        return EXIT_SUCCESS;
+    if (fgets(line, sizeof(line), file) == NULL || strncmp(line, WISDOM_HEADER, strlen(WISDOM_HEADER)) != 0) {
+        printf("Ignoring wisdom file %s with unknown format \n", filename);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%d %d %f %f %d %d %d %15s %15s %d %f", &e.m, &e.n, &e.sigmas_x, &e.sigmas_y, &e.channels,
+                   &e.K, &e.cores, request, backend, &e.threads, &e.seconds) != 11)
+            continue;
+        e.request = spatial_backend_from_name(request);
+        e.backend = spatial_backend_from_name(backend);
+        if (e.request == SPATIAL_NUM_BACKENDS || e.backend < 0 || e.backend == SPATIAL_NUM_BACKENDS)
+            continue;
+        wisdom_add(&e);
+    }
+    fclose(file);
+    wisdom_changed = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Save planner wisdom to a file if it changed
+ * \param filename  Wisdom file
+ * \return Success or Failure
+ */
+int wisdom_save(const char *filename) {
+    if (!wisdom_changed)
+        return EXIT_SUCCESS;
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Cannot write wisdom file %s \n", filename);
+        return EXIT_FAILURE;
+    }
+    fprintf(file, "%s\n# m n sigmas_x sigmas_y channels K cores request backend threads seconds\n", WISDOM_HEADER);
+    for (int i = 0; i < wisdom_count; i++) {
+        const wisdom_entry *e = &wisdom[i];
+        fprintf(file, "%d %d %.9g %.9g %d %d %d %s %s %d %g\n", e->m, e->n, e->sigmas_x, e->sigmas_y, e->channels,
+                e->K, e->cores,
+                spatial_backend_name(e->request), spatial_backend_name(e->backend), e->threads, e->seconds);
+    }
+    fclose(file);
+    wisdom_changed = false;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Choose the spatial backend and thread count by timing
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param channels  Number of channels
+ * \param img       Pointer to the input planes, one per channel
+ * \param params    Pointer to Program parameters with the fitted
+ *                  range kernel, the requested backend and the
+ *                  number of cores in threads
+ * \return Success or Failure
+ *
+ * This routine looks up the wisdom for (m, n, sigmas_x, sigmas_y,
+ * channels, K, backend request, cores). Without an entry, it times
+ * shiftableBF_execute_channels on a central crop of the image for
+ * each candidate backend and thread count and records the fastest
+ * in the wisdom.
+ * SPATIAL_AUTO lets the planner choose between the two recursive
+ * Gaussians, SPATIAL_ANY also considers the box cascade, and an
+ * explicit backend only has its thread count tuned.
+ */
+int plan_measure(int m, int n, float sigmas_x, float sigmas_y, int channels, float ***img, program_params *params) {
+    int i, b, t, c;
+    wisdom_entry best;
+    best.m = m;
+    best.n = n;
+    best.sigmas_x = sigmas_x;
+    best.sigmas_y = sigmas_y;
+    best.channels = channels;
+    best.K = params->K;
+    best.cores = params->threads;
+    best.request = params->backend;
+
+    /* Plan from a previous run */
+    for (i = wisdom_count - 1; i >= 0; i--) {
+        const wisdom_entry *e = &wisdom[i];
+        if (e->m == m && e->n == n && e->sigmas_x == sigmas_x && e->sigmas_y == sigmas_y && e->channels == channels &&
+            e->K == params->K && e->cores == params->threads && e->request == params->backend) {
+            params->backend = e->backend;
+            params->threads = e->threads;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    /* Candidate backends */
+    int first = params->backend, last = params->backend;
+    if (params->backend == SPATIAL_AUTO) {
+        first = SPATIAL_DERICHE;
+        last = SPATIAL_YOUNG;
+    } else if (params->backend == SPATIAL_ANY) {
+        first = 0;
+        last = SPATIAL_NUM_BACKENDS - 1;
+    }
+
+    /* Central crop of the image, sharing its rows */
+    int mc = min(m, PLAN_CROP_SIZE), nc = min(n, PLAN_CROP_SIZE);
+    int r0 = (m - mc) / 2, c0 = (n - nc) / 2;
+    float ***crop = (float ***) calloc(channels, sizeof(float **));
+    float ***out = (float ***) calloc(channels, sizeof(float **));
+    for (c = 0; c < channels; c++) {
+        crop[c] = (float **) calloc(mc, sizeof(float *));
+        for (i = 0; i < mc; i++)
+            crop[c][i] = img[c][r0 + i] + c0;
+        out[c] = alloc_array(mc, nc);
+    }
+
+    int cores = max(params->threads, 1);
+    program_params trial = *params;
+    trial.threads = cores;
+    trial.backend = (spatial_backend) first;
+    /* Warm up caches and the thread pool before timing */
+    int status = EXIT_SUCCESS;
+    for (c = 0; c < channels && status == EXIT_SUCCESS; c++) {
+        if (out[c] == NULL) {
+            printf("Allocating a %d x %d crop failed \n", mc, nc);
+            status = EXIT_FAILURE;
+        }
+    }
+    if (status == EXIT_SUCCESS)
+        status = shiftableBF_execute_channels(mc, nc, channels, sigmas_x, sigmas_y, crop, out, &trial);
+
+    best.seconds = -1;
+    for (b = first; b <= last && status == EXIT_SUCCESS; b++) {
+        trial.backend = (spatial_backend) b;
+        /* Thread counts 1, 2, 4, ... and the number of cores */
+        for (t = 1; t <= cores; t = (t == cores) ? cores + 1 : min(2 * t, cores)) {
+            trial.threads = t;
+            double start = now();
+            shiftableBF_execute_channels(mc, nc, channels, sigmas_x, sigmas_y, crop, out, &trial);
+            float seconds = (float) calcElapsed(start, now());
+            if (best.seconds < 0 || seconds < best.seconds) {
+                best.seconds = seconds;
+                best.backend = trial.backend;
+                best.threads = trial.threads;
+            }
+        }
+    }
+    for (c = 0; c < channels; c++) {
+        free(crop[c]);
+        dealloc_array_fl(out[c], mc);
+    }
+    free(crop);
+    free(out);
+    if (status != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    wisdom_add(&best);
+    wisdom_changed = true;
+    params->backend = best.backend;
+    params->threads = best.threads;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Fit and plan the filter of an image with a plan kept from image to image
+ * \param m         Image height
+ * \param n         Image width
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param eps       Bound on the range kernel approximation error
+ * \param channels  Number of channels
+ * \param img       Pointer to the input planes, one per channel
+ * \param request   Backend requested, SPATIAL_AUTO or SPATIAL_ANY
+ *                  letting the plan choose
+ * \param plan      Pointer to Program parameters kept by the caller,
+ *                  with the planning mode and threads, and no
+ *                  coefficients before the first image
+ * \return Success or Failure
+ *
+ * The range kernel is fitted again only when T of the image
+ * changes, and the backend is measured on the first image in the
+ * measure mode, otherwise chosen for T when the request lets the
+ * plan choose. A plan whose measure failed is left without
+ * coefficients, to be planned again by the next image.
+ */
+int plan_reuse(int m, int n, float sigmas_x, float sigmas_y, float sigmar, float eps, int channels, float ***img,
+               spatial_backend request, program_params *plan) {
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+    float T = 0;
+    for (int c = 0; c < channels; c++)
+        T = max(T, maxfilterfind(img[c], wy, wx, m, n));
+    float Tmax = max(T, ceilf(3.2f * sigmar));
+    int status = EXIT_SUCCESS;
+    bool planned = plan->coeff != NULL; /** \brief Whether the plan was measured by an earlier image */
+    if (!planned || plan->T != Tmax) {
+        free(plan->coeff);
+        cache_fourier_coefficients(Tmax, sigmar, eps, plan);
+        if (!planned && plan->planning == PLAN_MEASURE)
+            status = plan_measure(m, n, sigmas_x, sigmas_y, channels, img, plan);
+        else if (request < 0 && plan->planning != PLAN_MEASURE)
+            plan->backend = select_spatial_backend(Tmax, sigmar);
+        if (status != EXIT_SUCCESS) {
+            free(plan->coeff);
+            plan->coeff = NULL;
+        }
+    }
+    return status;
+}
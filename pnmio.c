@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file pnmio.c
+ * @brief Access to rectangles of binary PGM and PPM files
+ *
+ * Images too large to be held in memory are read and written a
+ * rectangle at a time. Binary PGM (P5) and PPM (P6) files with
+ * 8-bit samples store the pixels row after row after a short
+ * header, so any rectangle is reached by seeking to its rows.
+ **/
+
+#include "headersreq.h"
+
+FILE *pnm_open_read(const char *filename, int *width, int *height, int *channels, off_t *offset);
+
+FILE *pnm_open_write(const char *filename, int width, int height, int channels, off_t *offset);
+
+int pnm_read_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                  float ***planes);
+
+int pnm_write_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                   float ***planes, int ptop, int pleft);
+
+/**
+ * \brief Read the next number of a PNM header, skipping comments
+ * \param file      Open file
+ * \param value     Number read
+ * \return Success or Failure
+ */
+static int pnm_header_value(FILE *file, int *value) {
+    int ch;
+    while ((ch = getc(file)) != EOF) {
+        if (ch == '#') {
+            while ((ch = getc(file)) != EOF && ch != '\n');
+        } else if (!isspace(ch)) {
+            ungetc(ch, file);
+            return (fscanf(file, "%d", value) == 1) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+/**
+ * \brief Open a binary PGM or PPM file for reading
+ * \param filename  Image file
+ * \param width     Image width, set
+ * \param height    Image height, set
+ * \param channels  1 for PGM, 3 for PPM, set
+ * \param offset    Position of the first pixel in the file, set
+ * \return open file, or NULL on failure
+ */
+FILE *pnm_open_read(const char *filename, int *width, int *height, int *channels, off_t *offset) {
+    FILE *file = fopen(filename, "rb");
+    int maxval;
+    char magic[3] = {0};
+
+    if (file == NULL) {
+        printf("Opening %s failed \n", filename);
+        return NULL;
+    }
+    if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6') ||
+        pnm_header_value(file, width) != EXIT_SUCCESS || pnm_header_value(file, height) != EXIT_SUCCESS ||
+        pnm_header_value(file, &maxval) != EXIT_SUCCESS || maxval != 255 || *width < 1 || *height < 1) {
+        printf("%s is not a binary PGM or PPM file with 8-bit samples \n", filename);
+        fclose(file);
+        return NULL;
+    }
+    getc(file); /* Single whitespace before the pixels */
+    *channels = (magic[1] == '5') ? 1 : 3;
+    *offset = ftello(file);
+    return file;
+}
+
+/**
+ * \brief Create a binary PGM or PPM file
+ * \param filename  Image file
+ * \param width     Image width
+ * \param height    Image height
+ * \param channels  1 for PGM, 3 for PPM
+ * \param offset    Position of the first pixel in the file, set
+ * \return open file, or NULL on failure
+ *
+ * Only the header is written; the pixels are written by
+ * pnm_write_rect in any order.
+ */
+FILE *pnm_open_write(const char *filename, int width, int height, int channels, off_t *offset) {
+    FILE *file = fopen(filename, "w+b");
+
+    if (file == NULL || (channels != 1 && channels != 3)) {
+        printf("Creating %s failed \n", filename);
+        if (file != NULL)
+            fclose(file);
+        return NULL;
+    }
+    fprintf(file, "P%c\n%d %d\n255\n", (channels == 1) ? '5' : '6', width, height);
+    *offset = ftello(file);
+    return file;
+}
+
+/**
+ * \brief Read a rectangle of a PNM file
+ * \param file      File opened by pnm_open_read
+ * \param offset    Position of the first pixel in the file
+ * \param width     Image width
+ * \param channels  Number of channels of the file
+ * \param top       First row of the rectangle
+ * \param left      First column of the rectangle
+ * \param rows      Height of the rectangle
+ * \param columns   Width of the rectangle
+ * \param planes    Planes of at least rows x columns, one per
+ *                  channel, filled with values in [0, 255]
+ * \return Success or Failure
+ */
+int pnm_read_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                  float ***planes) {
+    unsigned char *line = (unsigned char *) malloc((size_t) columns * channels);
+    int i, j, c, status = EXIT_SUCCESS;
+
+    for (i = 0; i < rows && status == EXIT_SUCCESS; i++) {
+        if (fseeko(file, offset + ((off_t) (top + i) * width + left) * channels, SEEK_SET) != 0 ||
+            fread(line, channels, columns, file) != (size_t) columns) {
+            printf("Reading row %d of the image failed \n", top + i);
+            status = EXIT_FAILURE;
+            break;
+        }
+        for (j = 0; j < columns; j++) {
+            for (c = 0; c < channels; c++)
+                planes[c][i][j] = line[j * channels + c];
+        }
+    }
+    free(line);
+    return status;
+}
+
+/**
+ * \brief Write a rectangle of a PNM file
+ * \param file      File opened by pnm_open_write
+ * \param offset    Position of the first pixel in the file
+ * \param width     Image width
+ * \param channels  Number of channels of the file
+ * \param top       First row of the rectangle in the file
+ * \param left      First column of the rectangle in the file
+ * \param rows      Height of the rectangle
+ * \param columns   Width of the rectangle
+ * \param planes    Planes holding the rectangle, one per channel,
+ *                  rounded and clipped to [0, 255]
+ * \param ptop      First row of the rectangle in planes
+ * \param pleft     First column of the rectangle in planes
+ * \return Success or Failure
+ */
+int pnm_write_rect(FILE *file, off_t offset, int width, int channels, int top, int left, int rows, int columns,
+                   float ***planes, int ptop, int pleft) {
+    unsigned char *line = (unsigned char *) malloc((size_t) columns * channels);
+    int i, j, c, status = EXIT_SUCCESS;
+
+    for (i = 0; i < rows && status == EXIT_SUCCESS; i++) {
+        for (j = 0; j < columns; j++) {
+            for (c = 0; c < channels; c++) {
+                float v = planes[c][ptop + i][pleft + j] + 0.5f;
+                line[j * channels + c] = (unsigned char) ((v < 0) ? 0 : (v > 255) ? 255 : v);
+            }
+        }
+        if (fseeko(file, offset + ((off_t) (top + i) * width + left) * channels, SEEK_SET) != 0 ||
+            fwrite(line, channels, columns, file) != (size_t) columns) {
+            printf("Writing row %d of the image failed \n", top + i);
+            status = EXIT_FAILURE;
+        }
+    }
+    free(line);
+    return status;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file progressive.c
+ * @brief Fast bilateral filter publishing refined results as the
+ * frequencies are accumulated
+ **/
+
+#include "headersreq.h"
+
+int shiftableBF_progressive(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                            float ***outimg, int cores, program_params *params, float eps,
+                            progress_callback callback, void *data);
+
+/**
+ * \brief Apply fast shiftable bilateral filter, publishing intermediate
+ *        results
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel,
+ *                  updated after each batch of frequencies
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function called after each batch
+ * \param data      Passed to callback
+ * \return Success or Failure; callback stopping the filter early
+ *         is a success
+ *
+ * T, the range kernel fit and the plan are found as in
+ * shiftableBF_channels. The frequencies are then accumulated in
+ * decreasing order of the magnitude of their coefficients, one
+ * per thread in each batch, and outimg is computed from P and Q
+ * after each batch, clipped to the range of the input until all
+ * the frequencies are accumulated. The error bound passed to
+ * callback is the error of the fit plus the magnitudes of the
+ * coefficients not yet accumulated, as the range kernel of the
+ * output differs from the fitted one by at most this sum.
+ */
+int shiftableBF_progressive(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float ***img,
+                            float ***outimg, int cores, program_params *params, float eps,
+                            progress_callback callback, void *data) {
+    int i, j, k, c, t;
+    const int C = channels;
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+
+    /* Fourier Basis Algorithm */
+    float T = 0;
+    for (c = 0; c < C; c++)
+        T = max(T, maxfilterfind(img[c], wy, wx, m, n));
+    float Tmax = max(T, ceilf(3.2f * sigmar));
+    float error = cache_fourier_coefficients(Tmax, sigmar, eps, params);
+    params->threads = max(cores, 1);
+    if (params->planning == PLAN_MEASURE) {
+        if (plan_measure(m, n, sigmas_x, sigmas_y, C, img, params) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    } else if (params->backend < 0) {
+        params->backend = select_spatial_backend(Tmax, sigmar);
+    }
+
+    int Kapprox = params->K;
+    const float *coff = params->coeff;
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    const spatial_filter *spatial = &spatial_filters[params->backend];
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(params->backend, sigmas_x, &kx);
+    cache_spatial_kernel(params->backend, sigmas_y, &ky);
+    int mp = m + 2 * ky.w, np = n + 2 * kx.w; /** \brief Size of the padded auxiliary images */
+
+    /* Frequencies in decreasing magnitude of their coefficients, and error bound before any */
+    int *order = (int *) calloc(Kapprox, sizeof(int));
+    for (k = 0; k < Kapprox; k++) {
+        for (t = k; t > 0 && fabsf(coff[order[t - 1]]) < fabsf(coff[k]); t--)
+            order[t] = order[t - 1];
+        order[t] = k;
+        error += fabsf(coff[k]);
+    }
+
+    /* Range of each channel: the filtered values are averages of the input */
+    float *lo = (float *) calloc(C, sizeof(float)), *hi = (float *) calloc(C, sizeof(float));
+    for (c = 0; c < C; c++) {
+        lo[c] = hi[c] = img[c][0][0];
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                lo[c] = min(lo[c], img[c][i][j]);
+                hi[c] = max(hi[c], img[c][i][j]);
+            }
+        }
+    }
+
+    float **P = alloc_array(m, n * C); /** \brief Matrix to store unnormalized filtered image */
+    float **Q = alloc_array(m, n * C); /** \brief Matrix to store weight sums for normalization */
+    int batch = params->threads; /** \brief Frequencies accumulated between two results */
+    bool stop = false; /** \brief Set when callback asks to stop */
+    bool failed = P == NULL || Q == NULL; /** \brief Set when a buffer cannot be allocated */
+
+#ifdef _OPENMP
+    omp_set_num_threads(params->threads);
+#pragma omp parallel shared(Kapprox, order, batch, lo, hi, spatial, kx, ky, P, Q, img, outimg, coff, omegao, mp, np, error, stop, failed) private(k, i, j, c)
+#endif
+    {
+        fft_complex **F = alloc_array_complex(m, n * C), **G = alloc_array_complex(mp, np * C),
+                **H = alloc_array_complex(mp, np * C);
+        float **P_k = alloc_array(m, n * C), **Q_k = alloc_array(m, n * C);
+        if (F == NULL || G == NULL || H == NULL || P_k == NULL || Q_k == NULL) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            failed = true;
+        }
+        /* Every thread has to see a failure before the first batch */
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+
+        for (int first = 0; first < Kapprox && !stop && !failed; first += batch) {
+            int last = min(first + batch, Kapprox);
+#ifdef _OPENMP
+#pragma omp for schedule(static, 1)
+#endif
+            for (k = first; k < last; k++) {
+                shiftableBF_accumulate(m, n, C, order[k], order[k] + 1, omegao, coff, spatial, &kx, &ky, img, img,
+                                       NULL, F, G, H, P_k, Q_k, NULL);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+                {
+                    for (i = 0; i < m; i++) {
+                        for (j = 0; j < n * C; j++) {
+                            P[i][j] += P_k[i][j];
+                            Q[i][j] += Q_k[i][j];
+                        }
+                    }
+                    error -= fabsf(coff[order[k]]);
+                }
+                for (i = 0; i < m; i++) {
+                    memset(P_k[i], 0, n * C * sizeof(float));
+                    memset(Q_k[i], 0, n * C * sizeof(float));
+                }
+            }
+
+            /* Result of the frequencies accumulated so far */
+#ifdef _OPENMP
+#pragma omp single
+#endif
+            {
+                for (c = 0; c < C; c++) {
+                    for (i = 0; i < m; i++) {
+                        for (j = 0; j < n; j++) {
+                            if (fabsf((Q[i][j * C + c])) <= 0.001f)
+                                outimg[c][i][j] = img[c][i][j];
+                            else
+                                outimg[c][i][j] = (P[i][j * C + c] / Q[i][j * C + c]);
+                            /* Partial sums may have Q close to 0, clip their ratio to the input range */
+                            if (last < Kapprox)
+                                outimg[c][i][j] = min(max(outimg[c][i][j], lo[c]), hi[c]);
+                        }
+                    }
+                }
+                if (callback(last, Kapprox, max(error, 0.0f), outimg, data) != EXIT_SUCCESS)
+                    stop = true;
+            }
+        }
+
+        dealloc_array_fl(P_k, m);
+        dealloc_array_fl(Q_k, m);
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+    }
+
+    free(order);
+    free(lo);
+    free(hi);
+    dealloc_array_fl(P, m);
+    dealloc_array_fl(Q, m);
+    if (failed) {
+        printf("Allocating the buffers of the filter failed \n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file rawio.c
+ * @brief Fast bilateral filter of a stream of raw or Y4M video frames
+ *
+ * Decoders and encoders such as ffmpeg exchange raw frames of a
+ * fixed size through pipes: gray8 and gray16 (little endian) frames
+ * hold one plane, yuv420p frames a luma plane followed by two
+ * chroma planes of half the width and height. YUV4MPEG2 streams
+ * give the frame size and chroma subsampling in their header, and
+ * precede each frame by a frame header. The luma plane, and
+ * optionally the chroma planes, are filtered by video sessions kept
+ * for the whole stream, so that the plan and range kernel fit are
+ * reused from frame to frame. While a frame is filtered, a helper
+ * thread writes the previous frame and reads the next one.
+ **/
+
+#include "headersreq.h"
+#include "timing.h"
+#include <pthread.h>
+
+raw_format raw_format_from_name(const char *name);
+
+size_t raw_frame_bytes(raw_format format, int width, int height);
+
+int shiftableBF_raw(FILE *in, FILE *out, raw_format format, int width, int height, bool chroma, float sigmas_x,
+                    float sigmas_y, float sigmar, int cores, program_params *params, float eps);
+
+int shiftableBF_y4m(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int cores,
+                    program_params *params, float eps);
+
+/** \brief Names of the raw formats, indexed by raw_format */
+static const char *raw_format_names[RAW_NUM_FORMATS] = {"gray8", "gray16", "yuv420p"};
+
+/** \brief Planes of the frames of a stream */
+typedef struct {
+    /** \brief Size of the luma plane, and of each chroma plane, 0 without chroma planes */
+    int m, n, mc, nc;
+    /** \brief Bytes of a luma sample, 1 or 2 (little endian), chroma samples having 1 */
+    int depth;
+    /** \brief Whether the chroma planes are filtered, rather than copied */
+    bool chroma;
+    /** \brief Bytes of a frame */
+    size_t bytes;
+} raw_layout;
+
+/** \brief Frame reader of a stream: 1 on success, 0 at the end of the input, -1 on failure */
+typedef int (*raw_reader)(void *stream, unsigned char *frame, size_t bytes);
+
+/** \brief Frame writer of a stream: true on success */
+typedef bool (*raw_writer)(void *stream, const unsigned char *frame, size_t bytes);
+
+/** \brief Transfers of the I/O thread during the filter of a frame */
+typedef struct {
+    raw_reader reader;
+    raw_writer writer;
+    void *in, *out;
+    /** \brief Frame written, or NULL, and frame read, or NULL */
+    const unsigned char *write;
+    unsigned char *read;
+    size_t bytes;
+    /** \brief Whether the write succeeded, and result of the read */
+    bool written;
+    int received;
+} raw_io;
+
+/**
+ * \brief Look up a raw format by name
+ * \param name      "gray8", "gray16" or "yuv420p"
+ * \return format, or RAW_NUM_FORMATS if name is unknown
+ */
+raw_format raw_format_from_name(const char *name) {
+    int f;
+    for (f = 0; f < RAW_NUM_FORMATS; f++) {
+        if (strcmp(name, raw_format_names[f]) == 0)
+            break;
+    }
+    return (raw_format) f;
+}
+
+/**
+ * \brief Size of a raw frame
+ * \param format    Raw format
+ * \param width     Frame width
+ * \param height    Frame height
+ * \return bytes of a frame
+ */
+size_t raw_frame_bytes(raw_format format, int width, int height) {
+    size_t luma = (size_t) width * height;
+    if (format == RAW_GRAY16)
+        return 2 * luma;
+    if (format == RAW_YUV420P)
+        return luma + 2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+    return luma;
+}
+
+/**
+ * \brief Write the previous frame and read the next one
+ * \param arg       Pointer to the raw_io
+ * \return NULL
+ */
+static void *raw_io_run(void *arg) {
+    raw_io *io = (raw_io *) arg;
+    if (io->write != NULL)
+        io->written = io->writer(io->out, io->write, io->bytes);
+    if (io->read != NULL)
+        io->received = io->reader(io->in, io->read, io->bytes);
+    return NULL;
+}
+
+/**
+ * \brief Read a raw frame from a file
+ * \param stream    FILE of the frames
+ * \param frame     Frame, filled
+ * \param bytes     Bytes of a frame
+ * \return 1 on success, 0 at the end of the file, -1 if it ends within the frame
+ */
+static int raw_file_read(void *stream, unsigned char *frame, size_t bytes) {
+    size_t got = fread(frame, 1, bytes, (FILE *) stream);
+    if (got == bytes)
+        return 1;
+    if (got == 0)
+        return 0;
+    fprintf(stderr, "Frame is truncated to %zu of %zu bytes \n", got, bytes);
+    return -1;
+}
+
+/**
+ * \brief Write a raw frame to a file
+ * \param stream    FILE of the frames
+ * \param frame     Frame
+ * \param bytes     Bytes of a frame
+ * \return whether the frame was written
+ */
+static bool raw_file_write(void *stream, const unsigned char *frame, size_t bytes) {
+    return fwrite(frame, 1, bytes, (FILE *) stream) == bytes;
+}
+
+/**
+ * \brief Read a frame from a Y4M stream
+ * \param stream    y4m_stream of the frames
+ * \param frame     Frame, filled
+ * \param bytes     Bytes of a frame, those of the stream
+ * \return 1 on success, 0 at the end of the stream, -1 on failure
+ */
+static int raw_y4m_read(void *stream, unsigned char *frame, size_t bytes) {
+    (void) bytes;
+    return y4m_read_frame((y4m_stream *) stream, frame);
+}
+
+/**
+ * \brief Write a frame to a Y4M stream
+ * \param stream    y4m_stream of the frames
+ * \param frame     Frame
+ * \param bytes     Bytes of a frame, those of the stream
+ * \return whether the frame was written
+ */
+static bool raw_y4m_write(void *stream, const unsigned char *frame, size_t bytes) {
+    (void) bytes;
+    return y4m_write_frame((y4m_stream *) stream, frame) == 1;
+}
+
+/**
+ * \brief Convert a plane of 8-bit samples to floats
+ * \param src       Samples, row after row
+ * \param m         Plane height
+ * \param n         Plane width
+ * \param plane     Float plane, filled
+ */
+static void raw_unpack8(const unsigned char *src, int m, int n, float **plane) {
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            plane[i][j] = src[(size_t) i * n + j];
+}
+
+/**
+ * \brief Convert a float plane to 8-bit samples, rounded and clipped
+ * \param plane     Float plane
+ * \param m         Plane height
+ * \param n         Plane width
+ * \param dst       Samples, row after row, filled
+ */
+static void raw_pack8(float **plane, int m, int n, unsigned char *dst) {
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            float v = plane[i][j] + 0.5f;
+            dst[(size_t) i * n + j] = (unsigned char) ((v < 0) ? 0 : (v > 255) ? 255 : v);
+        }
+    }
+}
+
+/**
+ * \brief Filter a stream of frames
+ * \param io        Reader and writer of the frames, with their streams
+ * \param layout    Planes of the frames
+ * \param name      Format of the frames, for the report
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel, in 8-bit levels
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of the
+ *                  luma session, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure, including an input ending within a
+ *         frame or before the first one
+ *
+ * 16-bit luma samples are scaled by 1/257 to [0, 255] so that sigmar
+ * is in 8-bit levels whatever the depth. The chroma planes are
+ * filtered by a session of two channels at their own size, with
+ * the spatial deviations scaled by their subsampling (at least 0.5).
+ * The frame rate is printed on stderr, as the output may be stdout.
+ */
+static int raw_stream(raw_io *io, const raw_layout *layout, const char *name, float sigmas_x, float sigmas_y,
+                      float sigmar, int cores, program_params *params, float eps) {
+    const int m = layout->m, n = layout->n, mc = layout->mc, nc = layout->nc;
+    const bool chroma = layout->chroma && mc > 0;
+    const size_t bytes = layout->bytes;
+    int c, i, j, frames = 0, status = EXIT_SUCCESS;
+    double start = now();
+
+    video_session *luma = video_session_open(m, n, 1, sigmas_x, sigmas_y, sigmar, cores, params, eps);
+    video_session *uv = chroma ? video_session_open(mc, nc, 2, max(sigmas_x * nc / n, 0.5f),
+                                                    max(sigmas_y * mc / m, 0.5f), sigmar, cores, params, eps) : NULL;
+    float **y = alloc_array(m, n), **yout = alloc_array(m, n);
+    float **u[2], **uout[2];
+    for (c = 0; c < 2 && chroma; c++) {
+        u[c] = alloc_array(mc, nc);
+        uout[c] = alloc_array(mc, nc);
+    }
+
+    /* Two input and two output frames: one being filtered, one being transferred */
+    unsigned char *frame[2], *result[2];
+    for (i = 0; i < 2; i++) {
+        frame[i] = (unsigned char *) malloc(bytes);
+        result[i] = (unsigned char *) malloc(bytes);
+    }
+    bool allocated = y != NULL && yout != NULL && frame[0] != NULL && frame[1] != NULL && result[0] != NULL &&
+                     result[1] != NULL;
+    for (c = 0; c < 2 && chroma; c++)
+        allocated = allocated && u[c] != NULL && uout[c] != NULL;
+    if (!allocated) {
+        fprintf(stderr, "Allocating the frames of %dx%d failed \n", n, m);
+        status = EXIT_FAILURE;
+    }
+    int received = allocated ? io->reader(io->in, frame[0], bytes) : 0;
+    pthread_t thread;
+    io->bytes = bytes;
+
+    while (received == 1 && status == EXIT_SUCCESS) {
+        const unsigned char *src = frame[frames % 2];
+        unsigned char *dst = result[frames % 2];
+        io->write = (frames > 0) ? result[(frames + 1) % 2] : NULL;
+        io->read = frame[(frames + 1) % 2];
+        io->written = true;
+        io->received = 0;
+        /* Without a thread, the transfers are done before the filter */
+        bool started = pthread_create(&thread, NULL, raw_io_run, io) == 0;
+        if (!started)
+            raw_io_run(io);
+
+        /* Luma, scaled to [0, 255] */
+        if (layout->depth == 2) {
+            for (i = 0; i < m; i++)
+                for (j = 0; j < n; j++)
+                    y[i][j] = (src[2 * ((size_t) i * n + j)] | (src[2 * ((size_t) i * n + j) + 1] << 8)) / 257.0f;
+        } else
+            raw_unpack8(src, m, n, y);
+        status = video_session_filter(luma, &y, &yout);
+        if (layout->depth == 2) {
+            for (i = 0; i < m; i++) {
+                for (j = 0; j < n; j++) {
+                    float v = yout[i][j] * 257.0f + 0.5f;
+                    unsigned int s = (unsigned int) ((v < 0) ? 0 : (v > 65535) ? 65535 : v);
+                    dst[2 * ((size_t) i * n + j)] = s & 0xff;
+                    dst[2 * ((size_t) i * n + j) + 1] = s >> 8;
+                }
+            }
+        } else
+            raw_pack8(yout, m, n, dst);
+
+        /* Chroma, filtered or copied */
+        if (mc > 0) {
+            const size_t luma_bytes = (size_t) layout->depth * m * n, chroma_bytes = (size_t) mc * nc;
+            if (chroma) {
+                for (c = 0; c < 2; c++)
+                    raw_unpack8(src + luma_bytes + c * chroma_bytes, mc, nc, u[c]);
+                if (status == EXIT_SUCCESS)
+                    status = video_session_filter(uv, u, uout);
+                for (c = 0; c < 2; c++)
+                    raw_pack8(uout[c], mc, nc, dst + luma_bytes + c * chroma_bytes);
+            } else
+                memcpy(dst + luma_bytes, src + luma_bytes, 2 * chroma_bytes);
+        }
+
+        if (started)
+            pthread_join(thread, NULL);
+        if (!io->written) {
+            fprintf(stderr, "Writing frame %d failed \n", frames - 1);
+            status = EXIT_FAILURE;
+        }
+        received = io->received;
+        frames++;
+        if (frames % 100 == 0)
+            fprintf(stderr, "%d frames, %.2f fps \n", frames, frames / calcElapsed(start, now()));
+    }
+    if (frames > 0 && status == EXIT_SUCCESS && !io->writer(io->out, result[(frames + 1) % 2], bytes)) {
+        fprintf(stderr, "Writing frame %d failed \n", frames - 1);
+        status = EXIT_FAILURE;
+    }
+    if (received < 0)
+        status = EXIT_FAILURE;
+    else if (status == EXIT_SUCCESS && frames == 0) {
+        fprintf(stderr, "No frame was read \n");
+        status = EXIT_FAILURE;
+    }
+    fprintf(stderr, "%d frames of %dx%d %s, %.2f fps \n", frames, n, m, name, frames / calcElapsed(start, now()));
+
+    *params = luma->params;
+    params->coeff = NULL;
+    for (i = 0; i < 2; i++) {
+        free(frame[i]);
+        free(result[i]);
+    }
+    for (c = 0; c < 2 && chroma; c++) {
+        dealloc_array_fl(u[c], mc);
+        dealloc_array_fl(uout[c], mc);
+    }
+    dealloc_array_fl(y, m);
+    dealloc_array_fl(yout, m);
+    video_session_close(luma);
+    if (uv != NULL)
+        video_session_close(uv);
+    return status;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a stream of raw frames
+ * \param in        Stream of input frames
+ * \param out       Stream of output frames
+ * \param format    Raw format of the frames
+ * \param width     Frame width
+ * \param height    Frame height
+ * \param chroma    Whether the chroma planes of yuv420p frames are
+ *                  filtered too, rather than copied
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel, in 8-bit levels
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of the
+ *                  luma session, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure, including an input ending within a
+ *         frame or before the first one
+ */
+int shiftableBF_raw(FILE *in, FILE *out, raw_format format, int width, int height, bool chroma, float sigmas_x,
+                    float sigmas_y, float sigmar, int cores, program_params *params, float eps) {
+    raw_layout layout = {.m = height, .n = width, .depth = (format == RAW_GRAY16) ? 2 : 1, .chroma = chroma,
+                         .bytes = raw_frame_bytes(format, width, height)};
+    if (format == RAW_YUV420P) {
+        layout.mc = (height + 1) / 2;
+        layout.nc = (width + 1) / 2;
+    }
+    raw_io io = {.reader = raw_file_read, .writer = raw_file_write, .in = in, .out = out};
+    int status = raw_stream(&io, &layout, raw_format_names[format], sigmas_x, sigmas_y, sigmar, cores, params, eps);
+    if (fflush(out) != 0)
+        status = EXIT_FAILURE;
+    return status;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to a YUV4MPEG2 video
+ * \param input     Y4M file to filter, "-" for stdin
+ * \param output    Y4M file written with the header of input, "-" for
+ *                  stdout
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of the
+ *                  luma session, without coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The Y, U and V planes are all filtered at their own size, the
+ * chroma planes with the spatial deviations scaled by their
+ * subsampling.
+ */
+int shiftableBF_y4m(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int cores,
+                    program_params *params, float eps) {
+    y4m_stream *in = y4m_open_read(input);
+    if (in == NULL)
+        return EXIT_FAILURE;
+    y4m_stream *out = y4m_open_write(output, in);
+    if (out == NULL) {
+        y4m_close(in);
+        return EXIT_FAILURE;
+    }
+
+    raw_layout layout = {.m = in->height, .n = in->width, .mc = in->chroma_height, .nc = in->chroma_width,
+                         .depth = 1, .chroma = true, .bytes = y4m_frame_size(in)};
+    raw_io io = {.reader = raw_y4m_read, .writer = raw_y4m_write, .in = in, .out = out};
+    int status = raw_stream(&io, &layout, "y4m", sigmas_x, sigmas_y, sigmar, cores, params, eps);
+    if (!y4m_close(out))
+        status = EXIT_FAILURE;
+    y4m_close(in);
+    return status;
+}
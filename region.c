@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file region.c
+ * @brief Incremental update of a filtered image after a local edit
+ **/
+
+#include "headersreq.h"
+
+int shiftableBF_region(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img, float ***outimg,
+                       const program_params *params, int top, int left, int height, int width);
+
+/**
+ * \brief Refilter the part of an image affected by a local edit
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param img       Pointer to the edited input planes, one per channel
+ * \param outimg    Pointer to the output planes of the image before
+ *                  the edit, updated in place
+ * \param params    Pointer to Program parameters of the filter that
+ *                  computed outimg (T, K, coeff, backend and threads)
+ * \param top       First row of the edited rectangle
+ * \param left      First column of the edited rectangle
+ * \param height    Height of the edited rectangle
+ * \param width     Width of the edited rectangle
+ * \return Success, or Failure when the edit raises T above the
+ *         half period of the fit and the whole image has to be
+ *         filtered again
+ *
+ * The outputs within REGION_MARGIN filter radii (w of the spatial
+ * kernel) of the rectangle are computed with
+ * shiftableBF_execute_channels on a crop extended by the same
+ * margin on each side, so that the padding of the crop does not
+ * reach them, and spliced into outimg. On the image borders the
+ * crop has the padding of the whole image. The result matches a
+ * full recompute up to the tail of the spatial filters beyond the
+ * margins, below 0.01 grey levels.
+ */
+int shiftableBF_region(int m, int n, int channels, float sigmas_x, float sigmas_y, float ***img, float ***outimg,
+                       const program_params *params, int top, int left, int height, int width) {
+    int i, c;
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(params->backend, sigmas_x, &kx);
+    cache_spatial_kernel(params->backend, sigmas_y, &ky);
+
+    /* Edited rectangle, outputs that depend on it, and inputs of these outputs */
+    int y0 = max(top, 0), y1 = min(top + height, m), x0 = max(left, 0), x1 = min(left + width, n);
+    if (y0 >= y1 || x0 >= x1)
+        return EXIT_SUCCESS;
+    int my = REGION_MARGIN * ky.w, mx = REGION_MARGIN * kx.w;
+    int oy0 = max(y0 - my, 0), oy1 = min(y1 + my, m), ox0 = max(x0 - mx, 0), ox1 = min(x1 + mx, n);
+    int iy0 = max(oy0 - my, 0), iy1 = min(oy1 + my, m), ix0 = max(ox0 - mx, 0), ix1 = min(ox1 + mx, n);
+    int mc = iy1 - iy0, nc = ix1 - ix0;
+
+    /* Crop of the image, sharing its rows */
+    float ***crop = (float ***) calloc(channels, sizeof(float **));
+    float ***out = (float ***) calloc(channels, sizeof(float **));
+    for (c = 0; c < channels; c++) {
+        crop[c] = (float **) calloc(mc, sizeof(float *));
+        for (i = 0; i < mc; i++)
+            crop[c][i] = img[c][iy0 + i] + ix0;
+        out[c] = alloc_array(mc, nc);
+    }
+
+    /* The fit holds while the local dynamic range of the crop stays within T */
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1, wy = 2 * (int) ceilf(3 * sigmas_y) + 1;
+    int status = EXIT_SUCCESS;
+    for (c = 0; c < channels && status == EXIT_SUCCESS; c++) {
+        if (out[c] == NULL) {
+            printf("Allocating a %d x %d crop failed \n", mc, nc);
+            status = EXIT_FAILURE;
+        } else if (maxfilterfind(crop[c], wy, wx, mc, nc) > params->T) {
+            printf("Edit raises T above %g, the whole image has to be filtered \n", params->T);
+            status = EXIT_FAILURE;
+        }
+    }
+    if (status == EXIT_SUCCESS)
+        status = shiftableBF_execute_channels(mc, nc, channels, sigmas_x, sigmas_y, crop, out, params);
+    if (status == EXIT_SUCCESS) {
+        for (c = 0; c < channels; c++) {
+            for (i = oy0; i < oy1; i++)
+                memcpy(outimg[c][i] + ox0, out[c][i - iy0] + (ox0 - ix0), (ox1 - ox0) * sizeof(float));
+        }
+    }
+
+    for (c = 0; c < channels; c++) {
+        free(crop[c]);
+        dealloc_array_fl(out[c], mc);
+    }
+    free(crop);
+    free(out);
+    return status;
+}
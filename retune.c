@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file retune.c
+ * @brief Fast bilateral filter of one image for many range kernels
+ *
+ * With the half period T fixed, the frequencies k*omegao and the
+ * convolved auxiliary images do not depend on sigmar: only the
+ * coefficients of the range kernel fit do. A retune session keeps,
+ * for each frequency k, the real parts of F*conv(H) and F*conv(G),
+ * so that filtering with another sigmar is a weighted sum of these
+ * planes. Parameter sweeps over a grid of (sigmas, sigmar) use one
+ * session per sigmas.
+ **/
+
+#include "headersreq.h"
+
+retune_session *retune_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                    float ***img, int cores, const program_params *params, float eps);
+
+int retune_session_filter(retune_session *session, float sigmar, float ***outimg);
+
+void retune_session_close(retune_session *session);
+
+int shiftableBF_sweep(int m, int n, int channels, int nsigmas, const float *sigmas_x, const float *sigmas_y,
+                      int nsigmar, const float *sigmar, float ***img, float ***outimg, int cores,
+                      const program_params *params, float eps, sweep_callback callback, void *data);
+
+/**
+ * \brief Release the planes of a retune session
+ * \param session   Pointer to the session
+ */
+static void retune_free_planes(retune_session *session) {
+    for (int k = 0; k < session->K_max; k++) {
+        dealloc_array_fl(session->p[k], session->m);
+        dealloc_array_fl(session->q[k], session->m);
+    }
+    free(session->p);
+    free(session->q);
+    session->p = NULL;
+    session->q = NULL;
+    session->K_max = 0;
+}
+
+/**
+ * \brief Compute the planes of the frequencies of a range kernel fit
+ * \param session   Pointer to the session, with params fitted for
+ *                  the smallest sigmar to be used
+ * \return Success or Failure
+ *
+ * Plane k holds the contribution of frequency k to P and Q
+ * without its coefficient.
+ */
+static int retune_build(retune_session *session) {
+    program_params *params = &session->params;
+    const int m = session->m, n = session->n, C = session->channels;
+    int k;
+
+    retune_free_planes(session);
+    session->K_max = params->K;
+    session->p = (float ***) calloc(params->K, sizeof(float **));
+    session->q = (float ***) calloc(params->K, sizeof(float **));
+    float *unit = (float *) calloc(params->K, sizeof(float));
+    bool failed = false;
+    for (k = 0; k < params->K; k++) {
+        session->p[k] = alloc_array(m, n * C);
+        session->q[k] = alloc_array(m, n * C);
+        failed = failed || session->p[k] == NULL || session->q[k] == NULL;
+        unit[k] = 1;
+    }
+    if (failed) {
+        printf("Allocating the planes of the retune session failed \n");
+        free(unit);
+        retune_free_planes(session);
+        return EXIT_FAILURE;
+    }
+
+    if (params->planning == PLAN_MEASURE) {
+        if (plan_measure(m, n, session->sigmas_x, session->sigmas_y, C, session->img, params) != EXIT_SUCCESS) {
+            free(unit);
+            retune_free_planes(session);
+            return EXIT_FAILURE;
+        }
+    } else if (params->backend < 0) {
+        params->backend = select_spatial_backend(params->T, session->sigmar);
+    }
+    const spatial_filter *spatial = &spatial_filters[params->backend];
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(params->backend, session->sigmas_x, &kx);
+    cache_spatial_kernel(params->backend, session->sigmas_y, &ky);
+    int mp = m + 2 * ky.w, np = n + 2 * kx.w; /** \brief Size of the padded auxiliary images */
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    int Kapprox = params->K;
+
+#ifdef _OPENMP
+    omp_set_num_threads(params->threads);
+#pragma omp parallel shared(Kapprox, session, spatial, kx, ky, unit, omegao, mp, np, failed) private(k)
+#endif
+    {
+        fft_complex **F = alloc_array_complex(m, n * C), **G = alloc_array_complex(mp, np * C),
+                **H = alloc_array_complex(mp, np * C);
+        bool allocated = F != NULL && G != NULL && H != NULL;
+        if (!allocated) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            failed = true;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1) nowait
+#endif
+        for (k = 0; k < Kapprox; k++) {
+            if (!allocated)
+                continue;
+            /* Single frequency with a unit coefficient, F1 is not used */
+            shiftableBF_accumulate(m, n, C, k, k + 1, omegao, unit, spatial, &kx, &ky, session->img, session->img,
+                                   NULL, F, G, H, session->p[k], session->q[k], NULL);
+        }
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+    }
+    free(unit);
+    if (failed) {
+        printf("Allocating the buffers of the filter failed \n");
+        retune_free_planes(session);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Start a range kernel retune session on an image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Smallest standard deviation of range kernel
+ *                  expected, which needs the most coefficients
+ * \param img       Pointer to the input planes, one per channel,
+ *                  kept by the session
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \return new session, or NULL on failure
+ *
+ * T is found and the planes of the K_max frequencies of the fit
+ * for sigmar are computed.
+ */
+retune_session *retune_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                    float ***img, int cores, const program_params *params, float eps) {
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+    retune_session *session = (retune_session *) calloc(1, sizeof(retune_session));
+    session->m = m;
+    session->n = n;
+    session->channels = channels;
+    session->sigmas_x = sigmas_x;
+    session->sigmas_y = sigmas_y;
+    session->sigmar = sigmar;
+    session->eps = eps;
+    session->img = img;
+    session->params = *params;
+    session->params.threads = max(cores, 1);
+    for (int c = 0; c < channels; c++)
+        session->T = max(session->T, maxfilterfind(img[c], wy, wx, m, n));
+
+    session->Tmax = max(session->T, ceilf(3.2f * sigmar));
+    cache_fourier_coefficients(session->Tmax, sigmar, eps, &session->params);
+    if (retune_build(session) != EXIT_SUCCESS) {
+        retune_session_close(session);
+        return NULL;
+    }
+    return session;
+}
+
+/**
+ * \brief Filter the image of a retune session with another range kernel
+ * \param session   Pointer to the session
+ * \param sigmar    Standard deviation of range kernel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \return Success or Failure
+ *
+ * While the half period max(T, ceil(3.2*sigmar)) is the one of the
+ * session and the fit needs at most K_max coefficients, only the
+ * range kernel is fitted and P and Q are summed from the planes.
+ * Otherwise the planes are computed again for sigmar.
+ */
+int retune_session_filter(retune_session *session, float sigmar, float ***outimg) {
+    program_params *params = &session->params;
+    const int m = session->m, n = session->n, C = session->channels;
+    float Tmax = max(session->T, ceilf(3.2f * sigmar));
+    int i, j, k, c;
+
+    free(params->coeff);
+    cache_fourier_coefficients(Tmax, sigmar, session->eps, params);
+    if (Tmax != session->Tmax || params->K > session->K_max) {
+        session->sigmar = sigmar;
+        session->Tmax = Tmax;
+        if (retune_build(session) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
+    const float *coff = params->coeff;
+    int Kapprox = params->K;
+
+#ifdef _OPENMP
+    omp_set_num_threads(params->threads);
+#pragma omp parallel for schedule(static) private(j, k, c)
+#endif
+    for (i = 0; i < m; i++) {
+        float *P = (float *) calloc(n * C, sizeof(float)), *Q = (float *) calloc(n * C, sizeof(float));
+        for (k = 0; k < Kapprox; k++) {
+            const float *p = session->p[k][i], *q = session->q[k][i];
+            for (j = 0; j < n * C; j++) {
+                P[j] += coff[k] * p[j];
+                Q[j] += coff[k] * q[j];
+            }
+        }
+        for (c = 0; c < C; c++) {
+            for (j = 0; j < n; j++) {
+                if (fabsf((Q[j * C + c])) <= 0.001f)
+                    outimg[c][i][j] = session->img[c][i][j];
+                else
+                    outimg[c][i][j] = (P[j * C + c] / Q[j * C + c]);
+            }
+        }
+        free(P);
+        free(Q);
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief End a retune session and release its planes
+ * \param session   Pointer to the session
+ */
+void retune_session_close(retune_session *session) {
+    retune_free_planes(session);
+    free(session->params.coeff);
+    free(session);
+}
+
+/**
+ * \brief Filter an image for every (sigmas, sigmar) of a grid
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param nsigmas   Number of spatial standard deviations
+ * \param sigmas_x  Standard deviations of spatial kernel along rows
+ * \param sigmas_y  Standard deviations of spatial kernel along columns
+ * \param nsigmar   Number of range standard deviations
+ * \param sigmar    Standard deviations of range kernel
+ * \param img       Pointer to the input planes, one per channel
+ * \param outimg    Pointer to the output planes, one per channel,
+ *                  overwritten for each point of the grid
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function called with each output
+ * \param data      Passed to callback
+ * \return Success or Failure, including a failure of callback
+ *
+ * For each sigmas, T is found once and a retune session is opened
+ * for the smallest sigmar. The sigmar are filtered in increasing
+ * order, so that the convolved planes are computed once for each
+ * distinct half period max(T, ceil(3.2*sigmar)).
+ */
+int shiftableBF_sweep(int m, int n, int channels, int nsigmas, const float *sigmas_x, const float *sigmas_y,
+                      int nsigmar, const float *sigmar, float ***img, float ***outimg, int cores,
+                      const program_params *params, float eps, sweep_callback callback, void *data) {
+    int s, r, t, status = EXIT_SUCCESS;
+
+    /* Order of the sigmar, increasing */
+    int *order = (int *) calloc(nsigmar, sizeof(int));
+    for (r = 0; r < nsigmar; r++) {
+        for (t = r; t > 0 && sigmar[order[t - 1]] > sigmar[r]; t--)
+            order[t] = order[t - 1];
+        order[t] = r;
+    }
+
+    for (s = 0; s < nsigmas && status == EXIT_SUCCESS; s++) {
+        retune_session *session = retune_session_open(m, n, channels, sigmas_x[s], sigmas_y[s], sigmar[order[0]],
+                                                      img, cores, params, eps);
+        if (session == NULL) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        for (r = 0; r < nsigmar && status == EXIT_SUCCESS; r++) {
+            status = retune_session_filter(session, sigmar[order[r]], outimg);
+            if (status == EXIT_SUCCESS)
+                status = callback(s, order[r], outimg, &session->params, data);
+        }
+        retune_session_close(session);
+    }
+    free(order);
+    return status;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file scanline.c
+ * @brief Fast bilateral filter of an image received row by row
+ *
+ * The vertical passes of the spatial filters run over whole
+ * columns, the anticausal one from the last row. A scanline
+ * session instead holds a window of rows: each block of rows is
+ * filtered with a halo of REGION_MARGIN filter radii of rows above
+ * and below, so that the backward pass starts within the halo, and
+ * is emitted once the rows of its lower halo are received. The
+ * range kernel is fitted once for a bound of T given when opening
+ * the session, as T of the whole image is not known in advance.
+ **/
+
+#include "headersreq.h"
+
+scanline_session *scanline_session_open(int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float T,
+                                        int block, int cores, const program_params *params, float eps,
+                                        scanline_callback callback, void *data);
+
+int scanline_session_push(scanline_session *session, float **row);
+
+int scanline_session_finish(scanline_session *session);
+
+void scanline_session_close(scanline_session *session);
+
+int shiftableBF_scanline(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar,
+                         int block, int cores, program_params *params, float eps);
+
+/**
+ * \brief Start a scanline session
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param T         Bound of the maximum local dynamic range of the
+ *                  image, PIXEL_RANGE if 0 or less
+ * \param block     Rows filtered together, at least 1
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend
+ * \param eps       Bound on the range kernel approximation error
+ * \param callback  Function receiving the filtered rows in order
+ * \param data      Passed to callback
+ * \return new session, to be released with scanline_session_close, or
+ *         NULL if its rows cannot be allocated
+ *
+ * The session holds block + 2 * margin rows of input and output,
+ * margin being REGION_MARGIN radii of the vertical filter. A row
+ * is emitted at most block + margin rows after it is pushed. The
+ * estimate planning mode is used, as no image is available to
+ * measure the backends on.
+ */
+scanline_session *scanline_session_open(int n, int channels, float sigmas_x, float sigmas_y, float sigmar, float T,
+                                        int block, int cores, const program_params *params, float eps,
+                                        scanline_callback callback, void *data) {
+    scanline_session *session = (scanline_session *) calloc(1, sizeof(scanline_session));
+    session->n = n;
+    session->channels = channels;
+    session->sigmas_x = sigmas_x;
+    session->sigmas_y = sigmas_y;
+    session->callback = callback;
+    session->data = data;
+    session->params = *params;
+    session->params.threads = max(cores, 1);
+
+    float Tmax = max((T > 0) ? T : PIXEL_RANGE, ceilf(3.2f * sigmar));
+    cache_fourier_coefficients(Tmax, sigmar, eps, &session->params);
+    if (session->params.backend < 0)
+        session->params.backend = select_spatial_backend(Tmax, sigmar);
+
+    spatial_kernel ky;
+    cache_spatial_kernel(session->params.backend, sigmas_y, &ky);
+    session->block = max(block, 1);
+    session->margin = REGION_MARGIN * ky.w;
+    session->rows = (float ***) calloc(channels, sizeof(float **));
+    session->out = (float ***) calloc(channels, sizeof(float **));
+    bool allocated = true;
+    for (int c = 0; c < channels; c++) {
+        session->rows[c] = alloc_array(session->block + 2 * session->margin, n);
+        session->out[c] = alloc_array(session->block + 2 * session->margin, n);
+        allocated = allocated && session->rows[c] != NULL && session->out[c] != NULL;
+    }
+    if (!allocated) {
+        printf("Allocating %d rows of width %d failed \n", session->block + 2 * session->margin, n);
+        scanline_session_close(session);
+        return NULL;
+    }
+    return session;
+}
+
+/**
+ * \brief Filter and emit the next block of rows
+ * \param session   Pointer to the session, holding the rows of the
+ *                  block and of its halo
+ * \return Success or Failure, including a failure of callback
+ *
+ * The rows no longer needed as upper halo are then dropped, their
+ * buffers being moved to the end of the window for reuse.
+ */
+static int scanline_block(scanline_session *session) {
+    const int C = session->channels;
+    int y0 = session->emitted, y1 = min(session->emitted + session->block, session->received);
+    int held = session->received - session->first, status, i, c;
+    float *values[4];
+
+    status = shiftableBF_execute_channels(held, session->n, C, session->sigmas_x, session->sigmas_y, session->rows,
+                                          session->out, &session->params);
+    for (i = y0; i < y1 && status == EXIT_SUCCESS; i++) {
+        for (c = 0; c < C; c++)
+            values[c] = session->out[c][i - session->first];
+        status = session->callback(i, values, session->data);
+    }
+    session->emitted = y1;
+
+    /* Rotate the rows above the next upper halo to the end of the window */
+    int drop = max(y1 - session->margin, 0) - session->first;
+    int capacity = session->block + 2 * session->margin;
+    for (c = 0; c < C && drop > 0; c++) {
+        float **rows = session->rows[c];
+        float **dropped = (float **) malloc(drop * sizeof(float *));
+        memcpy(dropped, rows, drop * sizeof(float *));
+        memmove(rows, rows + drop, (capacity - drop) * sizeof(float *));
+        memcpy(rows + capacity - drop, dropped, drop * sizeof(float *));
+        free(dropped);
+    }
+    session->first += max(drop, 0);
+    return status;
+}
+
+/**
+ * \brief Push the next row of the image
+ * \param session   Pointer to the session
+ * \param row       Row of the image, one array of width values per
+ *                  channel, copied
+ * \return Success or Failure, including a failure of callback
+ *
+ * The next block is filtered and emitted as soon as the rows of
+ * its lower halo are received.
+ */
+int scanline_session_push(scanline_session *session, float **row) {
+    for (int c = 0; c < session->channels; c++)
+        memcpy(session->rows[c][session->received - session->first], row[c], session->n * sizeof(float));
+    session->received++;
+    if (session->received == session->emitted + session->block + session->margin)
+        return scanline_block(session);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Emit the last rows once the whole image has been pushed
+ * \param session   Pointer to the session
+ * \return Success or Failure, including a failure of callback
+ *
+ * The last blocks are filtered with the bottom of the image as
+ * lower border, as the filter of the whole image does.
+ */
+int scanline_session_finish(scanline_session *session) {
+    int status = EXIT_SUCCESS;
+    while (session->emitted < session->received && status == EXIT_SUCCESS)
+        status = scanline_block(session);
+    return status;
+}
+
+/**
+ * \brief End a scanline session and release its rows
+ * \param session   Pointer to the session
+ */
+void scanline_session_close(scanline_session *session) {
+    for (int c = 0; c < session->channels; c++) {
+        dealloc_array_fl(session->rows[c], session->block + 2 * session->margin);
+        dealloc_array_fl(session->out[c], session->block + 2 * session->margin);
+    }
+    free(session->rows);
+    free(session->out);
+    free(session->params.coeff);
+    free(session);
+}
+
+/** \brief Output file of shiftableBF_scanline */
+typedef struct {
+    FILE *file;
+    off_t offset;
+    int n, channels;
+} scanline_file;
+
+/**
+ * \brief Write a filtered row to the output file
+ * \param row       Index of the row in the image
+ * \param values    Filtered row, one array per channel
+ * \param data      Pointer to the scanline_file
+ * \return Success or Failure
+ */
+static int scanline_write(int row, float **values, void *data) {
+    scanline_file *out = (scanline_file *) data;
+    float **planes[4];
+    for (int c = 0; c < out->channels; c++)
+        planes[c] = &values[c];
+    return pnm_write_rect(out->file, out->offset, out->n, out->channels, row, 0, 1, out->n, planes, 0, 0);
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file row by row
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param block     Rows filtered together
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set to those of
+ *                  the session
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The rows are read one at a time and pushed to a scanline session
+ * fitted for T = PIXEL_RANGE, which writes the filtered rows.
+ */
+int shiftableBF_scanline(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar,
+                         int block, int cores, program_params *params, float eps) {
+    int m, n, C, i, c, status = EXIT_SUCCESS;
+    off_t offset;
+    scanline_file out;
+
+    FILE *in = pnm_open_read(input, &n, &m, &C, &offset);
+    if (in == NULL)
+        return EXIT_FAILURE;
+    out.file = pnm_open_write(output, n, m, C, &out.offset);
+    if (out.file == NULL) {
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    out.n = n;
+    out.channels = C;
+
+    scanline_session *session = scanline_session_open(n, C, sigmas_x, sigmas_y, sigmar, 0, block, cores, params, eps,
+                                                      scanline_write, &out);
+    float ***row = (float ***) calloc(C, sizeof(float **));
+    float *values[4];
+    if (session == NULL) {
+        free(row);
+        fclose(in);
+        fclose(out.file);
+        return EXIT_FAILURE;
+    }
+    for (c = 0; c < C; c++) {
+        row[c] = alloc_array(1, n);
+        if (row[c] == NULL) {
+            printf("Allocating a row of width %d failed \n", n);
+            status = EXIT_FAILURE;
+        } else {
+            values[c] = row[c][0];
+        }
+    }
+    for (i = 0; i < m && status == EXIT_SUCCESS; i++) {
+        status = pnm_read_rect(in, offset, n, C, i, 0, 1, n, row);
+        if (status == EXIT_SUCCESS)
+            status = scanline_session_push(session, values);
+    }
+    if (status == EXIT_SUCCESS)
+        status = scanline_session_finish(session);
+
+    *params = session->params;
+    params->coeff = (float *) calloc(params->K, sizeof(float));
+    memcpy(params->coeff, session->params.coeff, params->K * sizeof(float));
+    for (c = 0; c < C; c++)
+        dealloc_array_fl(row[c], 1);
+    free(row);
+    scanline_session_close(session);
+    fclose(in);
+    if (fclose(out.file) != 0)
+        status = EXIT_FAILURE;
+    return status;
+}
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file shard.c
+ * @brief Fast bilateral filter of an image shared by worker processes
+ *
+ * The driver finds T of the whole image, fits the range kernel and
+ * plans the filter once, as the tiled filter does, then writes each
+ * tile extended by a halo of REGION_MARGIN filter radii as a shard
+ * file in a shared directory, with a plan file describing the fit
+ * and the shards. Independent FBF worker processes, on this machine
+ * or on any machine sharing the directory, filter the shards with
+ * the plan and write the tiles as result files, which the driver
+ * stitches into the output. The directory holds:
+ *
+ *  - plan.fbf, written once all the shards are written
+ *  - shard_<i>.pnm, tile i with its halo
+ *  - result_<i>.pnm, filtered tile i without its halo, renamed from
+ *    a temporary file once complete
+ *  - result_<i>.failed, written by a worker that failed on tile i
+ **/
+
+#include "headersreq.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SHARD_HEADER "# fbf shard plan 1"
+
+/** \brief Seconds the driver waits for a new result of workers run elsewhere before failing */
+#define SHARD_WAIT_LIMIT 3600
+
+/** \brief Shard plan read back from plan.fbf */
+typedef struct {
+    /** \brief Image height, width and channels */
+    int m, n, channels;
+    /** \brief Standard deviations of the spatial kernel */
+    float sigmas_x, sigmas_y;
+    /** \brief Range kernel fit and backend */
+    program_params params;
+    /** \brief Number of shards */
+    int shards;
+    /** \brief Per shard: tile in the image, its size and its position in the shard */
+    int *top, *left, *rows, *columns, *ptop, *pleft;
+} shard_plan;
+
+int shard_prepare(const char *input, const char *dir, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                  int cores, program_params *params, float eps, int *shards);
+
+int shard_worker(const char *dir, int index, int count, int threads);
+
+int shard_stitch(const char *dir, const char *output);
+
+int shiftableBF_sharded(const char *program, const char *input, const char *output, const char *dir,
+                        float sigmas_x, float sigmas_y, float sigmar, int tile, int workers, int cores,
+                        program_params *params, float eps);
+
+/**
+ * \brief Release a shard plan
+ * \param plan      Pointer to the plan read by shard_plan_read
+ */
+static void shard_plan_free(shard_plan *plan) {
+    free(plan->params.coeff);
+    free(plan->top);
+    free(plan->left);
+    free(plan->rows);
+    free(plan->columns);
+    free(plan->ptop);
+    free(plan->pleft);
+}
+
+/**
+ * \brief Read the next line of a plan file that is not a comment
+ * \param file      Open plan file
+ * \param line      Buffer of the line
+ * \param size      Size of the buffer
+ * \return Success or Failure at the end of the file
+ */
+static int shard_plan_line(FILE *file, char *line, int size) {
+    while (fgets(line, size, file) != NULL) {
+        if (line[0] != '#')
+            return EXIT_SUCCESS;
+    }
+    return EXIT_FAILURE;
+}
+
+/**
+ * \brief Read the plan file of a shard directory
+ * \param dir       Shard directory
+ * \param plan      Pointer to the plan, filled
+ * \return Success or Failure
+ */
+static int shard_plan_read(const char *dir, shard_plan *plan) {
+    char path[1024], line[256], backend[16];
+    int i, k, status = EXIT_SUCCESS;
+
+    snprintf(path, sizeof(path), "%s/plan.fbf", dir);
+    memset(plan, 0, sizeof(shard_plan));
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Opening shard plan %s failed \n", path);
+        return EXIT_FAILURE;
+    }
+    if (fgets(line, sizeof(line), file) == NULL || strncmp(line, SHARD_HEADER, strlen(SHARD_HEADER)) != 0 ||
+        shard_plan_line(file, line, sizeof(line)) != EXIT_SUCCESS ||
+        sscanf(line, "%d %d %d %f %f %f %d %f %15s %d", &plan->m, &plan->n, &plan->channels, &plan->sigmas_x,
+               &plan->sigmas_y, &plan->params.T, &plan->params.K, &plan->params.error, backend,
+               &plan->shards) != 10) {
+        printf("%s is not a shard plan \n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    plan->params.backend = spatial_backend_from_name(backend);
+    plan->params.planning = PLAN_ESTIMATE;
+    plan->params.coeff = (float *) calloc(plan->params.K, sizeof(float));
+    plan->top = (int *) calloc(plan->shards, sizeof(int));
+    plan->left = (int *) calloc(plan->shards, sizeof(int));
+    plan->rows = (int *) calloc(plan->shards, sizeof(int));
+    plan->columns = (int *) calloc(plan->shards, sizeof(int));
+    plan->ptop = (int *) calloc(plan->shards, sizeof(int));
+    plan->pleft = (int *) calloc(plan->shards, sizeof(int));
+    if (plan->params.backend < 0 || plan->params.backend == SPATIAL_NUM_BACKENDS)
+        status = EXIT_FAILURE;
+    for (k = 0; k < plan->params.K && status == EXIT_SUCCESS; k++) {
+        if (shard_plan_line(file, line, sizeof(line)) != EXIT_SUCCESS ||
+            sscanf(line, "%f", &plan->params.coeff[k]) != 1)
+            status = EXIT_FAILURE;
+    }
+    for (i = 0; i < plan->shards && status == EXIT_SUCCESS; i++) {
+        if (shard_plan_line(file, line, sizeof(line)) != EXIT_SUCCESS ||
+            sscanf(line, "%d %d %d %d %d %d", &plan->top[i], &plan->left[i], &plan->rows[i], &plan->columns[i],
+                   &plan->ptop[i], &plan->pleft[i]) != 6)
+            status = EXIT_FAILURE;
+    }
+    fclose(file);
+    if (status != EXIT_SUCCESS) {
+        printf("Shard plan %s is truncated \n", path);
+        shard_plan_free(plan);
+    }
+    return status;
+}
+
+/**
+ * \brief Write the shards of an image file and their plan
+ * \param input     Binary PGM or PPM file to filter
+ * \param dir       Shard directory, created if missing
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles of the shards
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, set by tiled_plan
+ * \param eps       Bound on the range kernel approximation error
+ * \param shards    Number of shards, set
+ * \return Success or Failure
+ *
+ * The fit and the backend are those of shiftableBF_tiled, and each
+ * shard extends its tile by the same halo. The plan file is written
+ * last, under a temporary name renamed once complete, so that a
+ * worker never reads the plan of shards still being written. The
+ * plan of a previous run is removed before any shard is written.
+ */
+int shard_prepare(const char *input, const char *dir, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                  int cores, program_params *params, float eps, int *shards) {
+    int m, n, C, c, k, y0, x0, status;
+    off_t in_offset, offset;
+    char path[1024], final[1024];
+
+    FILE *in = pnm_open_read(input, &n, &m, &C, &in_offset);
+    if (in == NULL)
+        return EXIT_FAILURE;
+    if (mkdir(dir, 0777) != 0 && access(dir, W_OK) != 0) {
+        printf("Cannot write to shard directory %s \n", dir);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    snprintf(final, sizeof(final), "%s/plan.fbf", dir);
+    if (remove(final) != 0 && access(final, F_OK) == 0) {
+        printf("Cannot remove the previous shard plan %s \n", final);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    tile = max(1, min(tile, max(m, n)));
+    status = tiled_plan(in, in_offset, m, n, C, sigmas_x, sigmas_y, sigmar, tile, cores, params, eps);
+
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(max(params->backend, SPATIAL_DERICHE), sigmas_x, &kx);
+    cache_spatial_kernel(max(params->backend, SPATIAL_DERICHE), sigmas_y, &ky);
+    int mc = min(tile + 2 * REGION_MARGIN * ky.w, m), nc = min(tile + 2 * REGION_MARGIN * kx.w, n);
+    float ***crop = (float ***) calloc(C, sizeof(float **));
+    for (c = 0; c < C; c++) {
+        crop[c] = alloc_array(mc, nc);
+        if (status == EXIT_SUCCESS && crop[c] == NULL) {
+            printf("Allocating a %d x %d shard failed \n", mc, nc);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/plan.fbf.part", dir);
+    FILE *plan = fopen(path, "w");
+    if (plan == NULL) {
+        printf("Cannot write shard plan %s \n", path);
+        status = EXIT_FAILURE;
+    }
+    *shards = ((m + tile - 1) / tile) * ((n + tile - 1) / tile);
+    if (status == EXIT_SUCCESS) {
+        fprintf(plan, "%s\n# m n channels sigmas_x sigmas_y T K error backend shards\n", SHARD_HEADER);
+        fprintf(plan, "%d %d %d %.9g %.9g %.9g %d %g %s %d\n# coefficients\n", m, n, C, sigmas_x, sigmas_y,
+                params->T, params->K, params->error, spatial_backend_name(params->backend), *shards);
+        for (k = 0; k < params->K; k++)
+            fprintf(plan, "%.9g\n", params->coeff[k]);
+        fprintf(plan, "# top left rows columns ptop pleft\n");
+    }
+
+    /* Each tile extended by the halo of the spatial filter */
+    int i = 0;
+    for (y0 = 0; y0 < m && status == EXIT_SUCCESS; y0 += tile) {
+        for (x0 = 0; x0 < n && status == EXIT_SUCCESS; x0 += tile, i++) {
+            int y1 = min(y0 + tile, m), x1 = min(x0 + tile, n);
+            int iy0 = max(y0 - REGION_MARGIN * ky.w, 0), iy1 = min(y1 + REGION_MARGIN * ky.w, m);
+            int ix0 = max(x0 - REGION_MARGIN * kx.w, 0), ix1 = min(x1 + REGION_MARGIN * kx.w, n);
+            status = pnm_read_rect(in, in_offset, n, C, iy0, ix0, iy1 - iy0, ix1 - ix0, crop);
+            snprintf(path, sizeof(path), "%s/shard_%d.pnm", dir, i);
+            FILE *shard = (status == EXIT_SUCCESS) ? pnm_open_write(path, ix1 - ix0, iy1 - iy0, C, &offset) : NULL;
+            if (shard == NULL)
+                status = EXIT_FAILURE;
+            if (status == EXIT_SUCCESS)
+                status = pnm_write_rect(shard, offset, ix1 - ix0, C, 0, 0, iy1 - iy0, ix1 - ix0, crop, 0, 0);
+            if (shard != NULL && fclose(shard) != 0)
+                status = EXIT_FAILURE;
+            snprintf(path, sizeof(path), "%s/result_%d.pnm", dir, i); /* Stale result of a previous run */
+            remove(path);
+            snprintf(path, sizeof(path), "%s/result_%d.failed", dir, i);
+            remove(path);
+            fprintf(plan, "%d %d %d %d %d %d\n", y0, x0, y1 - y0, x1 - x0, y0 - iy0, x0 - ix0);
+        }
+    }
+
+    for (c = 0; c < C; c++)
+        dealloc_array_fl(crop[c], mc);
+    free(crop);
+    fclose(in);
+    if (plan != NULL) {
+        snprintf(path, sizeof(path), "%s/plan.fbf.part", dir);
+        if (fclose(plan) != 0 || (status == EXIT_SUCCESS && rename(path, final) != 0))
+            status = EXIT_FAILURE;
+    }
+    return status;
+}
+
+/**
+ * \brief Filter the shards of a shard directory assigned to a worker
+ * \param dir       Shard directory
+ * \param index     Index of the worker, from 0
+ * \param count     Number of workers sharing the directory
+ * \param threads   Number of threads of this worker
+ * \return Success or Failure
+ *
+ * Worker index filters the shards i with i % count == index, and
+ * skips those whose result file is already complete, so that a
+ * failed worker can be rerun. Each result is written under a
+ * temporary name renamed once complete; a tile that fails is marked
+ * by a result_<i>.failed file instead.
+ */
+int shard_worker(const char *dir, int index, int count, int threads) {
+    shard_plan plan;
+    char path[1024], final[1024];
+    int i, c, m, n, C, status;
+    off_t offset;
+
+    status = shard_plan_read(dir, &plan);
+    if (status != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    plan.params.threads = max(threads, 1);
+    for (i = index; i < plan.shards && status == EXIT_SUCCESS; i += count) {
+        snprintf(final, sizeof(final), "%s/result_%d.pnm", dir, i);
+        if (access(final, F_OK) == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/shard_%d.pnm", dir, i);
+        FILE *shard = pnm_open_read(path, &n, &m, &C, &offset);
+        if (shard == NULL) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        float ***crop = (float ***) calloc(C, sizeof(float **));
+        float ***outcrop = (float ***) calloc(C, sizeof(float **));
+        bool allocated = true;
+        for (c = 0; c < C; c++) {
+            crop[c] = alloc_array(m, n);
+            outcrop[c] = alloc_array(m, n);
+            allocated = allocated && crop[c] != NULL && outcrop[c] != NULL;
+        }
+        if (!allocated)
+            printf("Allocating a %d x %d shard failed \n", m, n);
+        status = allocated ? pnm_read_rect(shard, offset, n, C, 0, 0, m, n, crop) : EXIT_FAILURE;
+        fclose(shard);
+        if (status == EXIT_SUCCESS)
+            status = shiftableBF_execute_channels(m, n, C, plan.sigmas_x, plan.sigmas_y, crop, outcrop,
+                                                  &plan.params);
+
+        /* The tile without its halo */
+        snprintf(path, sizeof(path), "%s/result_%d.pnm.part", dir, i);
+        FILE *result = (status == EXIT_SUCCESS) ? pnm_open_write(path, plan.columns[i], plan.rows[i], C, &offset)
+                                                : NULL;
+        if (result == NULL)
+            status = EXIT_FAILURE;
+        if (status == EXIT_SUCCESS)
+            status = pnm_write_rect(result, offset, plan.columns[i], C, 0, 0, plan.rows[i], plan.columns[i],
+                                    outcrop, plan.ptop[i], plan.pleft[i]);
+        if (result != NULL && (fclose(result) != 0 || (status == EXIT_SUCCESS && rename(path, final) != 0)))
+            status = EXIT_FAILURE;
+        for (c = 0; c < C; c++) {
+            dealloc_array_fl(crop[c], m);
+            dealloc_array_fl(outcrop[c], m);
+        }
+        free(crop);
+        free(outcrop);
+        snprintf(path, sizeof(path), "%s/result_%d.failed", dir, i);
+        if (status != EXIT_SUCCESS) {
+            FILE *failed = fopen(path, "w");
+            if (failed != NULL)
+                fclose(failed);
+        } else {
+            remove(path);
+        }
+    }
+    shard_plan_free(&plan);
+    return status;
+}
+
+/**
+ * \brief Stitch the results of a shard directory into the output
+ * \param dir       Shard directory, with all the results complete
+ * \param output    PGM or PPM file written, with the channels of the
+ *                  input
+ * \return Success or Failure
+ *
+ * The shard and result files are removed once the output is
+ * written; the plan is kept.
+ */
+int shard_stitch(const char *dir, const char *output) {
+    shard_plan plan;
+    char path[1024];
+    int i, c, m, n, C, status;
+    off_t offset, out_offset;
+
+    status = shard_plan_read(dir, &plan);
+    if (status != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    FILE *out = pnm_open_write(output, plan.n, plan.m, plan.channels, &out_offset);
+    if (out == NULL) {
+        shard_plan_free(&plan);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < plan.shards && status == EXIT_SUCCESS; i++) {
+        snprintf(path, sizeof(path), "%s/result_%d.pnm", dir, i);
+        FILE *result = pnm_open_read(path, &n, &m, &C, &offset);
+        if (result == NULL || m != plan.rows[i] || n != plan.columns[i] || C != plan.channels) {
+            printf("Result %s does not match its shard \n", path);
+            if (result != NULL)
+                fclose(result);
+            status = EXIT_FAILURE;
+            break;
+        }
+        float ***tile = (float ***) calloc(C, sizeof(float **));
+        bool allocated = true;
+        for (c = 0; c < C; c++) {
+            tile[c] = alloc_array(m, n);
+            allocated = allocated && tile[c] != NULL;
+        }
+        if (!allocated)
+            printf("Allocating a %d x %d tile failed \n", m, n);
+        status = allocated ? pnm_read_rect(result, offset, n, C, 0, 0, m, n, tile) : EXIT_FAILURE;
+        fclose(result);
+        if (status == EXIT_SUCCESS)
+            status = pnm_write_rect(out, out_offset, plan.n, C, plan.top[i], plan.left[i], m, n, tile, 0, 0);
+        for (c = 0; c < C; c++)
+            dealloc_array_fl(tile[c], m);
+        free(tile);
+    }
+    if (fclose(out) != 0)
+        status = EXIT_FAILURE;
+    for (i = 0; i < plan.shards && status == EXIT_SUCCESS; i++) {
+        snprintf(path, sizeof(path), "%s/shard_%d.pnm", dir, i);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/result_%d.pnm", dir, i);
+        remove(path);
+    }
+    shard_plan_free(&plan);
+    return status;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file with worker processes
+ * \param program   FBF executable run by the workers
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param dir       Shard directory
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles of the shards
+ * \param workers   Number of local worker processes, 0 to wait for
+ *                  workers started elsewhere
+ * \param cores     Number of physical cores on system, shared by the
+ *                  local workers
+ * \param params    Pointer to Program parameters, set by tiled_plan
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The local workers run "program -s dir -W index/workers/threads".
+ * Without local workers, the result files are polled every second
+ * until all are complete, and the driver fails when a worker marks a
+ * tile as failed or when no new result appears for SHARD_WAIT_LIMIT
+ * seconds.
+ */
+int shiftableBF_sharded(const char *program, const char *input, const char *output, const char *dir,
+                        float sigmas_x, float sigmas_y, float sigmar, int tile, int workers, int cores,
+                        program_params *params, float eps) {
+    char path[1024], spec[64];
+    int i, shards, status;
+
+    status = shard_prepare(input, dir, sigmas_x, sigmas_y, sigmar, tile, cores, params, eps, &shards);
+    if (status != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    if (workers > 0) {
+        /* Independent processes, started after flushing so that they do not repeat buffered output */
+        fflush(stdout);
+        for (i = 0; i < workers; i++) {
+            snprintf(spec, sizeof(spec), "%d/%d/%d", i, workers, max(cores / workers, 1));
+            pid_t pid = fork();
+            if (pid == 0) {
+                execlp(program, program, "-s", dir, "-W", spec, (char *) NULL);
+                printf("Starting worker %s failed \n", program);
+                _exit(EXIT_FAILURE);
+            }
+            if (pid < 0)
+                status = EXIT_FAILURE;
+        }
+        int child;
+        while (wait(&child) > 0) {
+            if (!WIFEXITED(child) || WEXITSTATUS(child) != EXIT_SUCCESS)
+                status = EXIT_FAILURE;
+        }
+    } else {
+        printf("Waiting for the workers of %s \n", dir);
+        fflush(stdout);
+        int idle = 0;
+        for (i = 0; i < shards && status == EXIT_SUCCESS;) {
+            snprintf(path, sizeof(path), "%s/result_%d.pnm", dir, i);
+            if (access(path, F_OK) == 0) {
+                i++;
+                idle = 0;
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/result_%d.failed", dir, i);
+            if (access(path, F_OK) == 0) {
+                printf("A worker failed on tile %d \n", i);
+                status = EXIT_FAILURE;
+            } else if (idle >= SHARD_WAIT_LIMIT) {
+                printf("No result of tile %d after %d s \n", i, idle);
+                status = EXIT_FAILURE;
+            } else {
+                sleep(1);
+                idle++;
+            }
+        }
+    }
+    if (status != EXIT_SUCCESS) {
+        printf("Shard workers failed \n");
+        return EXIT_FAILURE;
+    }
+    return shard_stitch(dir, output);
+}
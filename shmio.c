@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file shmio.c
+ * @brief Image planes in shared memory segments
+ *
+ * The filter reads and writes images as arrays of row pointers, so
+ * planes of float samples held by another process in a shared
+ * memory segment are filtered in place by pointing the rows into
+ * the mapped segment, without copying the samples. A segment is
+ * named either as a POSIX shared memory object ("/name", see
+ * shm_open) or by a path to a file or file descriptor, such as
+ * "/proc/<pid>/fd/<fd>" for a segment created by memfd_create.
+ **/
+
+#include "headersreq.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void *shm_create(const char *name, size_t bytes);
+
+void *shm_attach(const char *name, size_t *bytes);
+
+void shm_detach(void *base, size_t bytes);
+
+int shm_extent(const shm_layout *layout, size_t bytes, size_t *end);
+
+float ***shm_planes(void *base, size_t bytes, const shm_layout *layout);
+
+void shm_planes_free(float ***planes, int channels);
+
+/**
+ * \brief Open a segment by name
+ * \param name      "/name" of a POSIX shared memory object, or path
+ *                  of a file holding more than one '/'
+ * \param flags     Flags of open
+ * \return file descriptor, or -1 on failure
+ */
+static int shm_open_name(const char *name, int flags) {
+    if (name[0] == '/' && strchr(name + 1, '/') == NULL)
+        return shm_open(name, flags, 0600);
+    return open(name, flags, 0600);
+}
+
+/**
+ * \brief Create a shared memory segment and map it
+ * \param name      Name of the segment, as for shm_attach
+ * \param bytes     Size of the segment
+ * \return mapped segment, or NULL on failure
+ *
+ * An existing segment of that name is resized. The segment
+ * persists after shm_detach until it is unlinked with shm_unlink.
+ */
+void *shm_create(const char *name, size_t bytes) {
+    int fd = shm_open_name(name, O_RDWR | O_CREAT);
+    if (fd < 0 || ftruncate(fd, (off_t) bytes) != 0) {
+        printf("Creating segment %s failed \n", name);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (base == MAP_FAILED) ? NULL : base;
+}
+
+/**
+ * \brief Map an existing shared memory segment
+ * \param name      "/name" of a POSIX shared memory object, or path
+ *                  of a file holding more than one '/'
+ * \param bytes     Size of the segment, set
+ * \return mapped segment, readable and writable, or NULL on failure
+ */
+void *shm_attach(const char *name, size_t *bytes) {
+    struct stat st;
+    int fd = shm_open_name(name, O_RDWR);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    *bytes = (size_t) st.st_size;
+    void *base = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (base == MAP_FAILED) ? NULL : base;
+}
+
+/**
+ * \brief Unmap a shared memory segment
+ * \param base      Segment mapped by shm_create or shm_attach
+ * \param bytes     Size of the segment
+ */
+void shm_detach(void *base, size_t bytes) {
+    munmap(base, bytes);
+}
+
+/**
+ * \brief Find the end of the planes of a layout in a segment
+ * \param layout    Position of the planes of float samples in the
+ *                  segment
+ * \param bytes     Size of the segment
+ * \param end       Bytes from the start of the segment to the end of
+ *                  the last sample, set
+ * \return Success, or Failure if the planes do not fit in the segment
+ *
+ * The extent is computed against the room left in the segment, so
+ * that offsets, strides and planes read from a request cannot wrap
+ * around.
+ */
+int shm_extent(const shm_layout *layout, size_t bytes, size_t *end) {
+    const int m = layout->height, n = layout->width, C = layout->channels;
+    if (m < 1 || n < 1 || C < 1 || layout->stride < n * sizeof(float) ||
+        (layout->offset | layout->stride | layout->plane) % sizeof(float) != 0 || layout->offset > bytes)
+        return EXIT_FAILURE;
+    size_t room = bytes - layout->offset;
+    if ((size_t) (m - 1) > room / layout->stride)
+        return EXIT_FAILURE;
+    room -= (m - 1) * layout->stride;
+    if (n * sizeof(float) > room)
+        return EXIT_FAILURE;
+    room -= n * sizeof(float);
+    if (layout->plane != 0 && (size_t) (C - 1) > room / layout->plane)
+        return EXIT_FAILURE;
+    room -= (C - 1) * layout->plane;
+    *end = bytes - room;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Point the rows of planes into a mapped segment
+ * \param base      Mapped segment
+ * \param bytes     Size of the segment
+ * \param layout    Position of the planes of float samples in the
+ *                  segment
+ * \return planes, one per channel, to be released with
+ *         shm_planes_free, or NULL if they do not fit in the segment
+ *
+ * Only the row pointers are allocated; the samples are those of
+ * the segment, which must be aligned for floats.
+ */
+float ***shm_planes(void *base, size_t bytes, const shm_layout *layout) {
+    const int m = layout->height, C = layout->channels;
+    size_t end;
+    if (shm_extent(layout, bytes, &end) != EXIT_SUCCESS)
+        return NULL;
+
+    float ***planes = (float ***) calloc(C, sizeof(float **));
+    for (int c = 0; c < C; c++) {
+        char *first = (char *) base + layout->offset + c * layout->plane;
+        planes[c] = (float **) calloc(m, sizeof(float *));
+        for (int i = 0; i < m; i++)
+            planes[c][i] = (float *) (first + (size_t) i * layout->stride);
+    }
+    return planes;
+}
+
+/**
+ * \brief Release the row pointers of planes in a segment
+ * \param planes    Planes from shm_planes, or NULL
+ * \param channels  Number of channels
+ */
+void shm_planes_free(float ***planes, int channels) {
+    if (planes == NULL)
+        return;
+    for (int c = 0; c < channels; c++)
+        free(planes[c]);
+    free(planes);
+}
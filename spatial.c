@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file spatial.c
+ * @brief Table of spatial Gaussian backends and backend selection
+ **/
+
+#include "headersreq.h"
+
+/** \brief Table of spatial backends indexed by spatial_backend */
+const spatial_filter spatial_filters[SPATIAL_NUM_BACKENDS] = {
+        {"deriche", deriche_init, convolve_deriche2D},
+        {"young",   young_init,   convolve_young2D},
+        {"box",     box_init,     convolve_box2D},
+};
+
+/**
+ * \brief Look up a spatial backend by name
+ * \param name      "any", "auto", "deriche", "young" or "box"
+ * \return backend, or SPATIAL_NUM_BACKENDS if name is unknown
+ */
+spatial_backend spatial_backend_from_name(const char *name) {
+    if (strcmp(name, "any") == 0)
+        return SPATIAL_ANY;
+    if (strcmp(name, "auto") == 0)
+        return SPATIAL_AUTO;
+    for (int b = 0; b < SPATIAL_NUM_BACKENDS; b++) {
+        if (strcmp(name, spatial_filters[b].name) == 0)
+            return (spatial_backend) b;
+    }
+    return SPATIAL_NUM_BACKENDS;
+}
+
+/**
+ * \brief Name of a spatial backend
+ * \param backend   Backend, SPATIAL_AUTO or SPATIAL_ANY
+ * \return name accepted by spatial_backend_from_name
+ */
+const char *spatial_backend_name(spatial_backend backend) {
+    if (backend == SPATIAL_ANY)
+        return "any";
+    if (backend == SPATIAL_AUTO)
+        return "auto";
+    return spatial_filters[backend].name;
+}
+
+/**
+ * \brief Choose the recursive Gaussian used by default
+ * \param Tmax      Half period of the range kernel
+ * \param sigmar    Standard deviation of range kernel
+ * \return SPATIAL_DERICHE or SPATIAL_YOUNG
+ *
+ * Deriche is more accurate and is preferred while
+ * Tmax/sigmar is small, Young and van Vliet otherwise.
+ */
+spatial_backend select_spatial_backend(float Tmax, float sigmar) {
+    if ((Tmax / sigmar) < 3.5)
+        return SPATIAL_DERICHE;
+    return SPATIAL_YOUNG;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file test_large.c
+ * @brief Test of the sample counts and offsets of images of more
+ * than 2^31 samples
+ *
+ * convert_to_format writes the planes of an RGBA image of more than
+ * 2^29 pixels, and calculatestd reads an array of more than 2^31
+ * samples. The inputs are anonymous mappings reserved without
+ * backing store, so that their untouched pages are shared zero
+ * pages; only the planes written by convert_to_format use memory.
+ * The test is skipped (exit code TEST_SKIPPED) on 32-bit systems
+ * and when that memory is not available.
+ *
+ * convert_to_format is static: imageio.c is compiled into the test,
+ * which is linked without imageio.o. read_image cannot reach it with
+ * such an image, as stb_image rejects more than 2^31 bytes.
+ **/
+
+#include "headersreq.h"
+#include "imageio.c"
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/** \brief Exit code of a skipped test */
+#define TEST_SKIPPED 77
+
+/** \brief Size of the RGBA image, 4 x 32768 x 16400 samples > 2^31 */
+#define LARGE_WIDTH 32768
+#define LARGE_HEIGHT 16400
+
+/** \brief Number of samples of the standard deviation, > 2^31 */
+#define LARGE_LENGTH (((size_t) 1 << 31) + ((size_t) 1 << 20))
+
+/**
+ * \brief Reserve a zero filled array without backing store
+ * \param bytes     Size of the array
+ * \return array, or NULL if the address space is short
+ */
+static void *reserve(size_t bytes) {
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (base == MAP_FAILED) ? NULL : base;
+}
+
+/**
+ * \brief Check the planes converted from an RGBA image of more than 2^31 samples
+ * \return Success, Failure, or TEST_SKIPPED
+ */
+static int check_convert(void) {
+    const size_t pixels = (size_t) LARGE_WIDTH * LARGE_HEIGHT;
+    uint32_t *src = (uint32_t *) reserve(pixels * sizeof(uint32_t));
+    if (src == NULL) {
+        printf("Reserving %zu pixels failed, skipped \n", pixels);
+        return TEST_SKIPPED;
+    }
+    /* Distinct pixels at the start, in the middle and at the end, the last planes lying beyond 2^31 samples */
+    const size_t probes[] = {0, pixels / 2, pixels - LARGE_WIDTH, pixels - 1};
+    const size_t nprobes = sizeof(probes) / sizeof(probes[0]);
+    size_t p;
+    for (p = 0; p < nprobes; p++) {
+        uint8_t *rgba = (uint8_t *) &src[probes[p]];
+        rgba[0] = (uint8_t) (10 + p);
+        rgba[1] = (uint8_t) (20 + p);
+        rgba[2] = (uint8_t) (30 + p);
+        rgba[3] = (uint8_t) (40 + p);
+    }
+
+    int status = EXIT_SUCCESS;
+    uint8_t *planes = (uint8_t *) convert_to_format(src, LARGE_WIDTH, LARGE_HEIGHT, IMAGEIO_U8 | IMAGEIO_PLANAR |
+                                                                                   IMAGEIO_RGBA);
+    if (planes == NULL) {
+        printf("Converting %zu pixels failed, skipped \n", pixels);
+        status = TEST_SKIPPED;
+    }
+    for (p = 0; p < nprobes && status == EXIT_SUCCESS; p++) {
+        for (int c = 0; c < 4; c++) {
+            if (planes[c * pixels + probes[p]] != 10 * (c + 1) + p) {
+                printf("Sample %d of pixel %zu is %d, not %d \n", c, probes[p], planes[c * pixels + probes[p]],
+                       (int) (10 * (c + 1) + p));
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    if (status == EXIT_SUCCESS)
+        printf("convert_to_format: %zu samples \n", 4 * pixels);
+    free(planes);
+    munmap(src, pixels * sizeof(uint32_t));
+    return status;
+}
+
+/**
+ * \brief Check the standard deviation of an array of more than 2^31 samples
+ * \return Success, Failure, or TEST_SKIPPED
+ */
+static int check_std(void) {
+    const size_t length = LARGE_LENGTH;
+    float *arr = (float *) reserve(length * sizeof(float));
+    if (arr == NULL) {
+        printf("Reserving %zu samples failed, skipped \n", length);
+        return TEST_SKIPPED;
+    }
+    /* Two samples, one of them beyond 2^31 */
+    const float a = 1 << 20, b = -(1 << 19);
+    arr[0] = b;
+    arr[length - 1] = a;
+    double mean = ((double) a + b) / length;
+    double expected = sqrt(((double) a * a + (double) b * b) / length - mean * mean);
+    float std = calculatestd(arr, length);
+    munmap(arr, length * sizeof(float));
+    printf("calculatestd: %zu samples, %f (expected %f) \n", length, std, expected);
+    if (!(fabs(std - expected) <= 1e-4 * expected)) {
+        printf("Standard deviation differs \n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    if (sizeof(size_t) < 8) {
+        printf("32-bit system, skipped \n");
+        return TEST_SKIPPED;
+    }
+    /* The converted planes are written; the inputs stay zero pages */
+    const size_t needed = (size_t) 4 * LARGE_WIDTH * LARGE_HEIGHT + ((size_t) 256 << 20);
+    long pages = sysconf(_SC_AVPHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page > 0 && (size_t) pages * page < needed) {
+        printf("%zu MB of memory available, %zu MB needed, skipped \n", (size_t) pages * page >> 20, needed >> 20);
+        return TEST_SKIPPED;
+    }
+
+    int status = check_std();
+    if (status != EXIT_FAILURE) {
+        int convert = check_convert();
+        status = (convert == EXIT_SUCCESS && status == EXIT_SUCCESS) ? EXIT_SUCCESS :
+                 (convert == EXIT_FAILURE) ? EXIT_FAILURE : TEST_SKIPPED;
+    }
+    return status;
+}
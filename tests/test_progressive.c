@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file test_progressive.c
+ * @brief Test of the intermediate results of the progressive filter
+ *
+ * The error bound passed with each result must decrease to the
+ * error of the range kernel fit, and the last result must be the
+ * output of shiftableBF_channels.
+ **/
+
+#include "headersreq.h"
+
+/** \brief Largest difference allowed between the last result and the filter, in grey levels */
+#define PROGRESSIVE_TOLERANCE 0.01f
+
+/** \brief Size of the test image */
+#define TEST_ROWS 120
+#define TEST_COLUMNS 150
+
+/** \brief Results received from the progressive filter */
+typedef struct {
+    int calls, last_done, last_K;
+    float last_error;
+    bool decreasing;
+} progress_record;
+
+/**
+ * \brief Record a result of the progressive filter
+ * \param done      Number of frequencies accumulated
+ * \param K         Total number of frequencies
+ * \param error     Bound on the error of the range kernel
+ * \param outimg    Pointer to the output planes
+ * \param data      Pointer to the progress_record
+ * \return Success
+ */
+static int record_progress(int done, int K, float error, float ***outimg, void *data) {
+    progress_record *record = (progress_record *) data;
+    (void) outimg;
+    if (record->calls > 0 && !(error < record->last_error && done > record->last_done))
+        record->decreasing = false;
+    printf("%d of %d frequencies: error at most %f \n", done, K, error);
+    record->calls++;
+    record->last_done = done;
+    record->last_K = K;
+    record->last_error = error;
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    const float sigmas = 3, sigmar = 20, eps = 0.001f;
+    const int C = 2;
+    float **img[2], **progressive[2], **direct[2];
+    int i, j, c, status = EXIT_SUCCESS;
+    for (c = 0; c < C; c++) {
+        img[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        progressive[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        direct[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        for (i = 0; i < TEST_ROWS; i++) {
+            for (j = 0; j < TEST_COLUMNS; j++) {
+                float block = (((i + 5 * c) / 19 + j / 13) % 2) ? 220.0f : 30.0f;
+                img[c][i][j] = block + (float) ((i * 7 + j * 3 + c) % 23);
+            }
+        }
+    }
+
+    progress_record record = {0, 0, 0, 0, true};
+    program_params params = {0};
+    params.backend = SPATIAL_AUTO;
+    params.planning = PLAN_ESTIMATE;
+    if (shiftableBF_progressive(TEST_ROWS, TEST_COLUMNS, C, sigmas, sigmas, sigmar, img, progressive, 1, &params, eps,
+                                record_progress, &record) != EXIT_SUCCESS) {
+        printf("Progressive filter failed \n");
+        status = EXIT_FAILURE;
+    }
+    program_params direct_params = {0};
+    direct_params.backend = params.backend;
+    direct_params.planning = PLAN_ESTIMATE;
+    if (status == EXIT_SUCCESS &&
+        shiftableBF_channels(TEST_ROWS, TEST_COLUMNS, C, sigmas, sigmas, sigmar, img, direct, 1, &direct_params,
+                             eps) != EXIT_SUCCESS) {
+        printf("Filter failed \n");
+        status = EXIT_FAILURE;
+    }
+
+    if (status == EXIT_SUCCESS) {
+        if (record.calls < 2 || !record.decreasing) {
+            printf("The error bound must decrease over several results \n");
+            status = EXIT_FAILURE;
+        }
+        if (record.last_done != record.last_K || record.last_K != direct_params.K ||
+            fabsf(record.last_error - direct_params.error) > 1e-4f) {
+            printf("The last result must use the %d frequencies of the fit, with its error %f \n", direct_params.K,
+                   direct_params.error);
+            status = EXIT_FAILURE;
+        }
+        float difference = 0;
+        for (c = 0; c < C; c++) {
+            for (i = 0; i < TEST_ROWS; i++) {
+                for (j = 0; j < TEST_COLUMNS; j++)
+                    difference = max(difference, fabsf(progressive[c][i][j] - direct[c][i][j]));
+            }
+        }
+        printf("Largest difference of the last result: %g \n", difference);
+        if (!(difference <= PROGRESSIVE_TOLERANCE)) {
+            printf("Difference above %g \n", PROGRESSIVE_TOLERANCE);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (c = 0; c < C; c++) {
+        dealloc_array_fl(img[c], TEST_ROWS);
+        dealloc_array_fl(progressive[c], TEST_ROWS);
+        dealloc_array_fl(direct[c], TEST_ROWS);
+    }
+    return status;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file test_region.c
+ * @brief Test of the incremental update of a filtered image
+ *
+ * An image is filtered, a rectangle of it edited, and the output
+ * updated by shiftableBF_region is compared with the filter of the
+ * whole edited image, for each backend and for rectangles inside
+ * the image and on its borders.
+ **/
+
+#include "headersreq.h"
+
+/** \brief Largest difference allowed between the update and a full recompute, in grey levels */
+#define REGION_TOLERANCE 0.01f
+
+/** \brief Size of the test image */
+#define TEST_ROWS 160
+#define TEST_COLUMNS 200
+
+/**
+ * \brief Fill a test image with blocks of 0 and 255 and a gradient
+ * \param img       Pointer to the planes, one per channel
+ * \param channels  Number of channels
+ * \param seed      Offset of the pattern
+ */
+static void fill_image(float ***img, int channels, int seed) {
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < TEST_ROWS; i++) {
+            for (int j = 0; j < TEST_COLUMNS; j++) {
+                float block = (((i + seed) / 23 + (j + 7 * c) / 17) % 2) ? 255.0f : 0.0f;
+                img[c][i][j] = 0.7f * block + 0.3f * (255.0f * ((i * 3 + j * 5 + seed) % 97) / 96.0f);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Check one edit against a full recompute
+ * \param backend   Spatial backend
+ * \param channels  Number of channels
+ * \param top       First row of the edited rectangle
+ * \param left      First column of the edited rectangle
+ * \param height    Height of the edited rectangle
+ * \param width     Width of the edited rectangle
+ * \return Success or Failure
+ */
+static int check_edit(spatial_backend backend, int channels, int top, int left, int height, int width) {
+    const float sigmas = 3, sigmar = 30, eps = 0.01f;
+    float **img[3], **edited[3], **updated[3], **full[3];
+    int i, j, c, status = EXIT_SUCCESS;
+    for (c = 0; c < channels; c++) {
+        img[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        edited[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        updated[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+        full[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+    }
+    fill_image(img, channels, 0);
+    fill_image(edited, channels, 0);
+    /* The edit replaces the rectangle by a shifted pattern, within the range of the image */
+    float **patch[3];
+    for (c = 0; c < channels; c++)
+        patch[c] = alloc_array(TEST_ROWS, TEST_COLUMNS);
+    fill_image(patch, channels, 11);
+    for (c = 0; c < channels; c++) {
+        for (i = max(top, 0); i < min(top + height, TEST_ROWS); i++) {
+            for (j = max(left, 0); j < min(left + width, TEST_COLUMNS); j++)
+                edited[c][i][j] = patch[c][i][j];
+        }
+        dealloc_array_fl(patch[c], TEST_ROWS);
+    }
+
+    program_params params = {0};
+    params.backend = backend;
+    params.planning = PLAN_ESTIMATE;
+    if (shiftableBF_channels(TEST_ROWS, TEST_COLUMNS, channels, sigmas, sigmas, sigmar, img, updated, 1, &params,
+                             eps) != EXIT_SUCCESS ||
+        shiftableBF_region(TEST_ROWS, TEST_COLUMNS, channels, sigmas, sigmas, edited, updated, &params, top, left,
+                           height, width) != EXIT_SUCCESS) {
+        printf("Filtering failed \n");
+        status = EXIT_FAILURE;
+    }
+    program_params full_params = {0};
+    full_params.backend = backend;
+    full_params.planning = PLAN_ESTIMATE;
+    if (status == EXIT_SUCCESS &&
+        shiftableBF_channels(TEST_ROWS, TEST_COLUMNS, channels, sigmas, sigmas, sigmar, edited, full, 1,
+                             &full_params, eps) != EXIT_SUCCESS) {
+        printf("Filtering failed \n");
+        status = EXIT_FAILURE;
+    }
+
+    if (status == EXIT_SUCCESS) {
+        float difference = 0;
+        for (c = 0; c < channels; c++) {
+            for (i = 0; i < TEST_ROWS; i++) {
+                for (j = 0; j < TEST_COLUMNS; j++)
+                    difference = max(difference, fabsf(updated[c][i][j] - full[c][i][j]));
+            }
+        }
+        printf("%s, %d channels, rectangle %d,%d %dx%d: largest difference %g \n",
+               spatial_filters[params.backend].name, channels, top, left, height, width, difference);
+        if (!(difference <= REGION_TOLERANCE)) {
+            printf("Difference above %g \n", REGION_TOLERANCE);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (c = 0; c < channels; c++) {
+        dealloc_array_fl(img[c], TEST_ROWS);
+        dealloc_array_fl(edited[c], TEST_ROWS);
+        dealloc_array_fl(updated[c], TEST_ROWS);
+        dealloc_array_fl(full[c], TEST_ROWS);
+    }
+    return status;
+}
+
+int main(void) {
+    /** \brief Edited rectangles: inside, on the top left corner, on the bottom right corner, and a row */
+    const int rects[][4] = {{60, 80, 20, 30}, {0, 0, 15, 25}, {140, 170, 40, 40}, {90, 0, 1, TEST_COLUMNS}};
+    int status = EXIT_SUCCESS;
+    for (int b = 0; b < SPATIAL_NUM_BACKENDS; b++) {
+        for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); r++) {
+            if (check_edit((spatial_backend) b, 1, rects[r][0], rects[r][1], rects[r][2], rects[r][3]) !=
+                EXIT_SUCCESS)
+                status = EXIT_FAILURE;
+        }
+        if (check_edit((spatial_backend) b, 3, rects[0][0], rects[0][1], rects[0][2], rects[0][3]) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+    return status;
+}
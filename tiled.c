@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file tiled.c
+ * @brief Fast bilateral filter of images larger than the memory
+ *
+ * The image is read from and written to PNM files one tile at a
+ * time. A first pass over the tiles finds T of the whole image, so
+ * that all the tiles are filtered with the same range kernel fit
+ * and backend; the second pass filters each tile extended by a
+ * halo of REGION_MARGIN filter radii, as shiftableBF_region does
+ * for an edit.
+ **/
+
+#include "headersreq.h"
+
+int tiled_plan(FILE *in, off_t offset, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+               int tile, int cores, program_params *params, float eps);
+
+int shiftableBF_tiled(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                      int cores, program_params *params, float eps);
+
+/**
+ * \brief Fit the range kernel and plan the filter of an image file
+ * \param in        File opened by pnm_open_read
+ * \param offset    Position of the first pixel in the file
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles read
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters, T, K, coeff,
+ *                  error, backend and threads are set
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * T is the largest of the max-filters of the tiles extended by
+ * the radius of the max-filter window, which is T of the whole
+ * image. The range kernel is then fitted and the plan chosen
+ * once, on the first tile for PLAN_MEASURE. Only a tile and its
+ * window are held in memory.
+ */
+int tiled_plan(FILE *in, off_t offset, int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+               int tile, int cores, program_params *params, float eps) {
+    int c, y0, x0, status = EXIT_SUCCESS;
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+
+    /* T of the whole image, from the tiles extended by the radius of the max-filter window */
+    int mc = min(tile + wy - 1, m), nc = min(tile + wx - 1, n);
+    float ***crop = (float ***) calloc(channels, sizeof(float **));
+    for (c = 0; c < channels; c++) {
+        crop[c] = alloc_array(mc, nc);
+        if (crop[c] == NULL)
+            status = EXIT_FAILURE;
+    }
+    if (status != EXIT_SUCCESS)
+        printf("Allocating a %d x %d tile failed \n", mc, nc);
+    float T = 0;
+    for (y0 = 0; y0 < m && status == EXIT_SUCCESS; y0 += tile) {
+        for (x0 = 0; x0 < n && status == EXIT_SUCCESS; x0 += tile) {
+            int iy0 = max(y0 - (wy - 1) / 2, 0), iy1 = min(y0 + tile + (wy - 1) / 2, m);
+            int ix0 = max(x0 - (wx - 1) / 2, 0), ix1 = min(x0 + tile + (wx - 1) / 2, n);
+            status = pnm_read_rect(in, offset, n, channels, iy0, ix0, iy1 - iy0, ix1 - ix0, crop);
+            for (c = 0; c < channels && status == EXIT_SUCCESS; c++)
+                T = max(T, maxfilterfind(crop[c], wy, wx, iy1 - iy0, ix1 - ix0));
+        }
+    }
+
+    /* Range kernel fit and plan shared by the tiles, measured on the first tile */
+    float Tmax = max(T, ceilf(3.2f * sigmar));
+    params->threads = max(cores, 1);
+    if (status == EXIT_SUCCESS) {
+        cache_fourier_coefficients(Tmax, sigmar, eps, params);
+        if (params->planning == PLAN_MEASURE) {
+            status = pnm_read_rect(in, offset, n, channels, 0, 0, min(tile, m), min(tile, n), crop);
+            if (status == EXIT_SUCCESS)
+                status = plan_measure(min(tile, m), min(tile, n), sigmas_x, sigmas_y, channels, crop, params);
+        } else if (params->backend < 0) {
+            params->backend = select_spatial_backend(Tmax, sigmar);
+        }
+    }
+    for (c = 0; c < channels; c++)
+        dealloc_array_fl(crop[c], mc);
+    free(crop);
+    return status;
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter to an image file tile by tile
+ * \param input     Binary PGM or PPM file to filter
+ * \param output    PGM or PPM file written, with the channels of input
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param tile      Side of the tiles written
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * The range kernel is fitted and the filter planned by tiled_plan.
+ * Each tile is filtered by shiftableBF_execute_channels on a crop
+ * extended by REGION_MARGIN filter radii on each side, which is
+ * read from the file, and written to the output. The memory used
+ * is that of a crop and its buffers, and the output matches the
+ * filter of the whole image up to the tail of the spatial filters
+ * beyond the halo, below 0.01 grey levels before rounding.
+ */
+int shiftableBF_tiled(const char *input, const char *output, float sigmas_x, float sigmas_y, float sigmar, int tile,
+                      int cores, program_params *params, float eps) {
+    int m, n, C, c, y0, x0, mc, nc, status;
+    off_t in_offset, out_offset;
+
+    FILE *in = pnm_open_read(input, &n, &m, &C, &in_offset);
+    if (in == NULL)
+        return EXIT_FAILURE;
+    FILE *out = pnm_open_write(output, n, m, C, &out_offset);
+    if (out == NULL) {
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    tile = max(1, min(tile, max(m, n)));
+    status = tiled_plan(in, in_offset, m, n, C, sigmas_x, sigmas_y, sigmar, tile, cores, params, eps);
+
+    /* Crops of the tiles extended by the halo of the spatial filter */
+    spatial_kernel kx, ky;
+    cache_spatial_kernel(max(params->backend, SPATIAL_DERICHE), sigmas_x, &kx);
+    cache_spatial_kernel(max(params->backend, SPATIAL_DERICHE), sigmas_y, &ky);
+    mc = min(tile + 2 * REGION_MARGIN * ky.w, m);
+    nc = min(tile + 2 * REGION_MARGIN * kx.w, n);
+    float ***crop = (float ***) calloc(C, sizeof(float **));
+    float ***outcrop = (float ***) calloc(C, sizeof(float **));
+    for (c = 0; c < C; c++) {
+        crop[c] = alloc_array(mc, nc);
+        outcrop[c] = alloc_array(mc, nc);
+        if (status == EXIT_SUCCESS && (crop[c] == NULL || outcrop[c] == NULL)) {
+            printf("Allocating a %d x %d tile failed \n", mc, nc);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    /* Filter each tile on its crop */
+    for (y0 = 0; y0 < m && status == EXIT_SUCCESS; y0 += tile) {
+        for (x0 = 0; x0 < n && status == EXIT_SUCCESS; x0 += tile) {
+            int y1 = min(y0 + tile, m), x1 = min(x0 + tile, n);
+            int iy0 = max(y0 - REGION_MARGIN * ky.w, 0), iy1 = min(y1 + REGION_MARGIN * ky.w, m);
+            int ix0 = max(x0 - REGION_MARGIN * kx.w, 0), ix1 = min(x1 + REGION_MARGIN * kx.w, n);
+            status = pnm_read_rect(in, in_offset, n, C, iy0, ix0, iy1 - iy0, ix1 - ix0, crop);
+            if (status == EXIT_SUCCESS)
+                status = shiftableBF_execute_channels(iy1 - iy0, ix1 - ix0, C, sigmas_x, sigmas_y, crop, outcrop,
+                                                      params);
+            if (status == EXIT_SUCCESS)
+                status = pnm_write_rect(out, out_offset, n, C, y0, x0, y1 - y0, x1 - x0, outcrop, y0 - iy0,
+                                        x0 - ix0);
+        }
+    }
+
+    for (c = 0; c < C; c++) {
+        dealloc_array_fl(crop[c], mc);
+        dealloc_array_fl(outcrop[c], mc);
+    }
+    free(crop);
+    free(outcrop);
+    fclose(in);
+    if (fclose(out) != 0)
+        status = EXIT_FAILURE;
+    return status;
+}
@@ -60,7 +60,7 @@ static double now() {
     return (nanotimer() - epoch) / 1e9;
 };
 
-double calcElapsed(double start, double end) {
+static double calcElapsed(double start, double end) {
     double took = -start;
     return took + end;
 }
\ No newline at end of file
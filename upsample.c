@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file upsample.c
+ * @brief Fast bilateral filter with the convolutions performed on a
+ * downscaled image (joint bilateral upsampling)
+ *
+ * For each frequency k the auxiliary images G and H are built from
+ * the image reduced by a factor scale and convolved at that size.
+ * The convolved images are interpolated bilinearly to full size and
+ * combined with F computed from the full resolution guide, so that
+ * edges are placed at full resolution while the convolutions cost
+ * scale^2 times less.
+ **/
+
+#include "headersreq.h"
+
+int shiftableBF_upsample(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, int scale,
+                         float ***guide, float ***img, float ***outimg, int cores, program_params *params, float eps);
+
+/**
+ * \brief Reduce an image by averaging blocks of scale x scale pixels
+ * \param m         Image height
+ * \param n         Image width
+ * \param scale     Reduction factor
+ * \param img       Pointer to input image
+ * \return reduced image of size ceil(m/scale) x ceil(n/scale), or
+ *         NULL if it cannot be allocated
+ *
+ * Blocks on the bottom and right borders average the pixels
+ * available.
+ */
+static float **downscale(int m, int n, int scale, float **img) {
+    int ml = (m + scale - 1) / scale, nl = (n + scale - 1) / scale;
+    float **low = alloc_array(ml, nl);
+    if (low == NULL)
+        return NULL;
+    for (int i = 0; i < ml; i++) {
+        int i1 = min(m, (i + 1) * scale);
+        for (int j = 0; j < nl; j++) {
+            int j1 = min(n, (j + 1) * scale);
+            float sum = 0;
+            for (int y = i * scale; y < i1; y++) {
+                for (int x = j * scale; x < j1; x++)
+                    sum += img[y][x];
+            }
+            low[i][j] = sum / ((i1 - i * scale) * (j1 - j * scale));
+        }
+    }
+    return low;
+}
+
+/**
+ * \brief Release the reduced images
+ * \param channels  Number of channels
+ * \param ml        Reduced height
+ * \param guide_low Reduced guide planes
+ * \param img_low   Reduced planes averaged, which may be the guide planes
+ */
+static void release_reduced(int channels, int ml, float ***guide_low, float ***img_low) {
+    for (int c = 0; c < channels; c++) {
+        if (img_low[c] != guide_low[c])
+            dealloc_array_fl(img_low[c], ml);
+        dealloc_array_fl(guide_low[c], ml);
+    }
+    free(guide_low);
+    free(img_low);
+}
+
+/**
+ * \brief Bilinear interpolation positions of a full size axis
+ * \param size      Full size
+ * \param low_size  Reduced size
+ * \param scale     Reduction factor
+ * \param index     Lower reduced index of each full index
+ * \param weight    Weight of the upper reduced index
+ *
+ * Reduced sample l is centered on full position l*scale+(scale-1)/2.
+ */
+static void interpolation_positions(int size, int low_size, int scale, int *index, float *weight) {
+    for (int i = 0; i < size; i++) {
+        float u = (i + 0.5f) / scale - 0.5f;
+        if (u < 0)
+            u = 0;
+        if (u > low_size - 1)
+            u = low_size - 1;
+        index[i] = min((int) u, max(low_size - 2, 0));
+        weight[i] = u - index[i];
+    }
+}
+
+/**
+ * \brief Apply fast shiftable bilateral filter with the convolutions
+ *        performed on a downscaled image
+ * \param m         Image height
+ * \param n         Image width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param scale     Reduction factor of the convolved images
+ * \param guide     Pointer to the guide planes, one per channel
+ * \param img       Pointer to the planes averaged, one per channel
+ * \param outimg    Pointer to the output planes, one per channel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters like
+ *                  coefficients
+ * \param eps       Bound on the range kernel approximation error
+ * \return Success or Failure
+ *
+ * T and the range kernel fit are computed on the full size guide.
+ * For each frequency k, G and H are computed from the guide and
+ * img reduced by scale, and convolved with standard deviations
+ * sigmas/scale (at least 0.5). P and Q are then accumulated at full
+ * size from F of the full size guide and the bilinear interpolation
+ * of the convolved G and H. With scale 1 this is shiftableBF_joint.
+ */
+int shiftableBF_upsample(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar, int scale,
+                         float ***guide, float ***img, float ***outimg, int cores, program_params *params, float eps) {
+    int i, j, k, c;
+    const int C = channels;
+    if (scale <= 1)
+        return shiftableBF_joint(m, n, channels, sigmas_x, sigmas_y, sigmar, guide, img, outimg, cores, params, eps);
+
+    int wx = 2 * (int) ceilf(3 * sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * sigmas_y) + 1; /** \brief Filter height */
+
+    /* Fourier Basis Algorithm, on the full size guide */
+    float T = 0;
+    for (c = 0; c < C; c++)
+        T = max(T, maxfilterfind(guide[c], wy, wx, m, n));
+    float Tmax = max(T, ceilf(3.2f * sigmar)); /* New half period of the filter */
+    cache_fourier_coefficients(Tmax, sigmar, eps, params);
+
+    /* Reduced images */
+    int ml = (m + scale - 1) / scale, nl = (n + scale - 1) / scale;
+    float sl_x = max(sigmas_x / scale, 0.5f), sl_y = max(sigmas_y / scale, 0.5f);
+    float ***guide_low = (float ***) calloc(C, sizeof(float **)), ***img_low = (float ***) calloc(C, sizeof(float **));
+    bool failed = false; /** \brief Whether buffers of the filter could not be allocated */
+    for (c = 0; c < C; c++) {
+        guide_low[c] = downscale(m, n, scale, guide[c]);
+        img_low[c] = (img[c] == guide[c]) ? guide_low[c] : downscale(m, n, scale, img[c]);
+        if (guide_low[c] == NULL || img_low[c] == NULL)
+            failed = true;
+    }
+    if (failed) {
+        printf("Allocating the reduced images failed \n");
+        release_reduced(C, ml, guide_low, img_low);
+        return EXIT_FAILURE;
+    }
+
+    params->threads = cores;
+    if (params->planning == PLAN_MEASURE) {
+        /* The convolutions dominate, so the plan is measured on the reduced image */
+        if (plan_measure(ml, nl, sl_x, sl_y, C, guide_low, params) != EXIT_SUCCESS) {
+            release_reduced(C, ml, guide_low, img_low);
+            return EXIT_FAILURE;
+        }
+    } else if (params->backend < 0) {
+        params->backend = select_spatial_backend(Tmax, sigmar);
+    }
+
+    int Kapprox = params->K;
+    const float *coff = params->coeff;
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    const spatial_filter *spatial = &spatial_filters[params->backend];
+    spatial_kernel kx, ky; /** \brief Spatial filter constants of the reduced images */
+    cache_spatial_kernel(params->backend, sl_x, &kx);
+    cache_spatial_kernel(params->backend, sl_y, &ky);
+    int mp = ml + 2 * ky.w, np = nl + 2 * kx.w; /** \brief Size of the padded reduced auxiliary images */
+
+    /** \brief Interpolation positions along columns (rows index) and rows (columns index) */
+    int *iy = calloc(m, sizeof(int)), *ix = calloc(n, sizeof(int));
+    float *ay = calloc(m, sizeof(float)), *ax = calloc(n, sizeof(float));
+    interpolation_positions(m, ml, scale, iy, ay);
+    interpolation_positions(n, nl, scale, ix, ax);
+
+    float **P = alloc_array(m, n * C); /** \brief Matrix to store unnormalized filtered image */
+    float **Q = alloc_array(m, n * C); /** \brief Matrix to store weight sums for normalization */
+
+    /** \brief Full size basis F1 for frequency omegao */
+    fft_complex **F1 = alloc_array_complex(m, n * C);
+    failed = P == NULL || Q == NULL || F1 == NULL;
+    for (i = 0; i < m && !failed; i++) {
+        for (j = 0; j < n; j++) {
+            for (c = 0; c < C; c++) {
+                F1[i][j * C + c].real = cosf(omegao * guide[c][i][j]);
+                F1[i][j * C + c].imag = sinf(omegao * guide[c][i][j]);
+            }
+        }
+    }
+    /** \brief Reduced grid shared by all threads */
+    reduced_grid low = {ml, nl, guide_low, img_low, iy, ix, ay, ax};
+    int chunk = (params->threads > 0) ? Kapprox / params->threads : Kapprox;
+    if (chunk == 0)
+        chunk = 1;
+    int nchunks = failed ? 0 : (Kapprox + chunk - 1) / chunk;
+#ifdef _OPENMP
+    omp_set_num_threads(params->threads);
+#pragma omp parallel shared(chunk, nchunks, Kapprox, m, n, mp, np, spatial, kx, ky, P, Q, guide, img, F1, coff, omegao, low, failed) private(k, i, j)
+#endif
+    if (nchunks > 0) {
+        /** \brief Full size F and reduced auxiliary images G and H */
+        fft_complex **F = alloc_array_complex(m, n * C), **G = alloc_array_complex(mp, np * C),
+                **H = alloc_array_complex(mp, np * C);
+        float **P_k = alloc_array(m, n * C), **Q_k = alloc_array(m, n * C);
+        bool allocated = F != NULL && G != NULL && H != NULL && P_k != NULL && Q_k != NULL;
+        if (!allocated) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            failed = true;
+        }
+
+#ifdef _OPENMP
+#pragma omp for schedule(static, 1) nowait
+#endif
+        for (k = 0; k < nchunks; k++) {
+            if (!allocated)
+                continue;
+            shiftableBF_accumulate(m, n, C, k * chunk, min(Kapprox, (k + 1) * chunk), omegao, coff, spatial, &kx, &ky,
+                                   guide, img, F1, F, G, H, P_k, Q_k, &low);
+        }
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        if (allocated) {
+            for (i = 0; i < m; i++) {
+                for (j = 0; j < n * C; j++) {
+                    P[i][j] += P_k[i][j];
+                    Q[i][j] += Q_k[i][j];
+                }
+            }
+        }
+
+        dealloc_array_fl(P_k, m);
+        dealloc_array_fl(Q_k, m);
+        dealloc_array_fl_complex(F, m);
+        dealloc_array_fl_complex(G, mp);
+        dealloc_array_fl_complex(H, mp);
+    }
+
+    /* Compute Output Image from P and Q */
+    for (c = 0; c < C && !failed; c++) {
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                if (fabsf((Q[i][j * C + c])) <= 0.001f)
+                    outimg[c][i][j] = img[c][i][j];
+                else
+                    outimg[c][i][j] = (P[i][j * C + c] / Q[i][j * C + c]);
+            }
+        }
+    }
+    release_reduced(C, ml, guide_low, img_low);
+    dealloc_array_fl_complex(F1, m);
+    dealloc_array_fl(P, m);
+    dealloc_array_fl(Q, m);
+    free(iy);
+    free(ix);
+    free(ay);
+    free(ax);
+    if (failed) {
+        printf("Allocating the buffers of the filter failed \n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2026, the FBF contributors
+ * All rights reserved.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version. You should have received a copy of this license along
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file video.c
+ * @brief Fast bilateral filter of a sequence of frames of the same size
+ *
+ * A session keeps the range kernel fit, the spatial backend and all
+ * the buffers from frame to frame. T changes little between frames,
+ * so instead of running the max-filter on each frame an upper bound
+ * of T is computed from the ranges of small blocks; the exact T is
+ * only computed, and the range kernel refitted, when the bound leaves
+ * the band of the current fit.
+ **/
+
+#include "headersreq.h"
+
+/** \brief Relative margin added to T when fitting, so that small increases do not cause a refit */
+#define VIDEO_HEADROOM 0.1f
+
+video_session *video_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                  int cores, const program_params *params, float eps);
+
+int video_session_filter(video_session *session, float ***frame, float ***outframe);
+
+void video_session_close(video_session *session);
+
+/**
+ * \brief Upper bound of T from the ranges of blocks
+ * \param f         Pointer to input image
+ * \param m         Image height
+ * \param n         Image width
+ * \param wy        Height of spatial kernel
+ * \param wx        Width of spatial kernel
+ * \return bound of maxfilterfind(f, wy, wx, m, n), infinite if the
+ *         blocks cannot be allocated
+ *
+ * The image is divided in blocks of (wy+1)/2 x (wx+1)/2 pixels.
+ * Two pixels at most (wy-1)/2 rows and (wx-1)/2 columns apart lie
+ * in 2 x 2 adjacent blocks, so T is at most the largest range of
+ * 2 x 2 adjacent blocks.
+ */
+static float video_bound(float **f, int m, int n, int wy, int wx) {
+    int bh = (wy + 1) / 2, bw = (wx + 1) / 2;
+    int mb = (m + bh - 1) / bh, nb = (n + bw - 1) / bw;
+    float **lo = alloc_array(mb, nb), **hi = alloc_array(mb, nb);
+    float T = 0;
+    int i, j, y, x;
+
+    /* Without the blocks, no bound: the exact T is computed */
+    if (lo == NULL || hi == NULL) {
+        dealloc_array_fl(lo, mb);
+        dealloc_array_fl(hi, mb);
+        return INFINITY;
+    }
+
+    for (i = 0; i < m; i++) {
+        float *l = lo[i / bh], *h = hi[i / bh];
+        for (j = 0; j < n; j++) {
+            if (i % bh == 0 && j % bw == 0) {
+                l[j / bw] = f[i][j];
+                h[j / bw] = f[i][j];
+            }
+            l[j / bw] = min(l[j / bw], f[i][j]);
+            h[j / bw] = max(h[j / bw], f[i][j]);
+        }
+    }
+    for (i = 0; i < mb; i++) {
+        for (j = 0; j < nb; j++) {
+            float l = lo[i][j], h = hi[i][j];
+            for (y = i; y <= min(i + 1, mb - 1); y++) {
+                for (x = j; x <= min(j + 1, nb - 1); x++) {
+                    l = min(l, lo[y][x]);
+                    h = max(h, hi[y][x]);
+                }
+            }
+            T = max(T, h - l);
+        }
+    }
+    dealloc_array_fl(lo, mb);
+    dealloc_array_fl(hi, mb);
+    return T;
+}
+
+/**
+ * \brief Half period fitted for a given T
+ * \param session   Pointer to the session
+ * \param T         Maximum local dynamic range of the frame
+ * \return T with headroom, at least ceil(3.2*sigmar)
+ */
+static float video_target(const video_session *session, float T) {
+    return max(ceilf(T * (1 + VIDEO_HEADROOM)), ceilf(3.2f * session->sigmar));
+}
+
+/**
+ * \brief Start a video filtering session
+ * \param m         Frame height
+ * \param n         Frame width
+ * \param channels  Number of channels filtered
+ * \param sigmas_x  Standard deviation of spatial kernel along rows
+ * \param sigmas_y  Standard deviation of spatial kernel along columns
+ * \param sigmar    Standard deviation of range kernel
+ * \param cores     Number of physical cores on system
+ * \param params    Pointer to Program parameters with the requested
+ *                  backend and planning mode
+ * \param eps       Bound on the range kernel approximation error
+ * \return new session, to be released with video_session_close
+ *
+ * Nothing is computed before the first frame, which decides the
+ * plan of the session.
+ */
+video_session *video_session_open(int m, int n, int channels, float sigmas_x, float sigmas_y, float sigmar,
+                                  int cores, const program_params *params, float eps) {
+    video_session *session = (video_session *) calloc(1, sizeof(video_session));
+    session->m = m;
+    session->n = n;
+    session->channels = channels;
+    session->sigmas_x = sigmas_x;
+    session->sigmas_y = sigmas_y;
+    session->sigmar = sigmar;
+    session->eps = eps;
+    session->params = *params;
+    session->params.coeff = NULL;
+    session->params.threads = max(cores, 1);
+    return session;
+}
+
+/**
+ * \brief Release the buffers of a session
+ * \param session   Pointer to the session, whose buffers are set to NULL
+ */
+static void video_session_release(video_session *session) {
+    const int m = session->m, mp = session->m + 2 * session->ky.w;
+    for (int t = 0; t < session->params.threads; t++) {
+        if (session->F != NULL)
+            dealloc_array_fl_complex(session->F[t], m);
+        if (session->G != NULL)
+            dealloc_array_fl_complex(session->G[t], mp);
+        if (session->H != NULL)
+            dealloc_array_fl_complex(session->H[t], mp);
+        if (session->P_k != NULL)
+            dealloc_array_fl(session->P_k[t], m);
+        if (session->Q_k != NULL)
+            dealloc_array_fl(session->Q_k[t], m);
+    }
+    free(session->F);
+    free(session->G);
+    free(session->H);
+    free(session->P_k);
+    free(session->Q_k);
+    dealloc_array_fl_complex(session->F1, m);
+    dealloc_array_fl(session->P, m);
+    dealloc_array_fl(session->Q, m);
+    session->F = session->G = session->H = NULL;
+    session->P_k = session->Q_k = NULL;
+    session->F1 = NULL;
+    session->P = session->Q = NULL;
+}
+
+/**
+ * \brief Choose the plan and allocate the buffers of the session
+ * \param session   Pointer to the session, with the range kernel fitted
+ * \param frame     Pointer to the planes of the first frame
+ * \return Success or Failure
+ */
+static int video_session_setup(video_session *session, float ***frame) {
+    program_params *params = &session->params;
+    const int m = session->m, n = session->n, C = session->channels;
+
+    if (params->planning == PLAN_MEASURE) {
+        if (plan_measure(m, n, session->sigmas_x, session->sigmas_y, C, frame, params) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    } else if (params->backend < 0) {
+        params->backend = select_spatial_backend(params->T, session->sigmar);
+    }
+    cache_spatial_kernel(params->backend, session->sigmas_x, &session->kx);
+    cache_spatial_kernel(params->backend, session->sigmas_y, &session->ky);
+    int mp = m + 2 * session->ky.w, np = n + 2 * session->kx.w; /** \brief Size of the padded auxiliary images */
+
+    session->F1 = alloc_array_complex(m, n * C);
+    session->P = alloc_array(m, n * C);
+    session->Q = alloc_array(m, n * C);
+    session->F = (fft_complex ***) calloc(params->threads, sizeof(fft_complex **));
+    session->G = (fft_complex ***) calloc(params->threads, sizeof(fft_complex **));
+    session->H = (fft_complex ***) calloc(params->threads, sizeof(fft_complex **));
+    session->P_k = (float ***) calloc(params->threads, sizeof(float **));
+    session->Q_k = (float ***) calloc(params->threads, sizeof(float **));
+    bool allocated = session->F1 != NULL && session->P != NULL && session->Q != NULL && session->F != NULL &&
+                     session->G != NULL && session->H != NULL && session->P_k != NULL && session->Q_k != NULL;
+    for (int t = 0; t < params->threads && allocated; t++) {
+        session->F[t] = alloc_array_complex(m, n * C);
+        session->G[t] = alloc_array_complex(mp, np * C);
+        session->H[t] = alloc_array_complex(mp, np * C);
+        session->P_k[t] = alloc_array(m, n * C);
+        session->Q_k[t] = alloc_array(m, n * C);
+        allocated = session->F[t] != NULL && session->G[t] != NULL && session->H[t] != NULL &&
+                    session->P_k[t] != NULL && session->Q_k[t] != NULL;
+    }
+    if (!allocated) {
+        printf("Allocating the buffers of the video session failed \n");
+        video_session_release(session);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Filter the next frame of a video session
+ * \param session   Pointer to the session
+ * \param frame     Pointer to the input planes, one per channel
+ * \param outframe  Pointer to the output planes, one per channel
+ * \return Success or Failure
+ *
+ * The range kernel fitted on a previous frame is kept while the
+ * bound of T of the frame (see video_bound) is below the half
+ * period of the fit and not much smaller than it. Otherwise the
+ * exact T is computed, and the range kernel is refitted with
+ * VIDEO_HEADROOM if T is out of the band.
+ */
+int video_session_filter(video_session *session, float ***frame, float ***outframe) {
+    program_params *params = &session->params;
+    const int m = session->m, n = session->n, C = session->channels;
+    int wx = 2 * (int) ceilf(3 * session->sigmas_x) + 1; /** \brief Filter width */
+    int wy = 2 * (int) ceilf(3 * session->sigmas_y) + 1; /** \brief Filter height */
+    int i, j, k, c;
+
+    /* Range kernel fit, kept while T stays in its band */
+    float T = 0;
+    for (c = 0; c < C; c++)
+        T = max(T, video_bound(frame[c], m, n, wy, wx));
+    if (session->frames == 0 || T > params->T || video_target(session, T) * (1 + VIDEO_HEADROOM) < params->T) {
+        T = 0;
+        for (c = 0; c < C; c++)
+            T = max(T, maxfilterfind(frame[c], wy, wx, m, n));
+        session->maxfilters++;
+        if (session->frames == 0 || T > params->T ||
+            video_target(session, T) * (1 + VIDEO_HEADROOM) < params->T) {
+            free(params->coeff);
+            cache_fourier_coefficients(video_target(session, T), session->sigmar, session->eps, params);
+            session->fits++;
+        }
+    }
+    if (session->frames == 0 && video_session_setup(session, frame) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    session->frames++;
+
+    int Kapprox = params->K;
+    const float *coff = params->coeff;
+    float omegao = (2 * M_PI) / (2 * params->T + 1);
+    const spatial_filter *spatial = &spatial_filters[params->backend];
+    fft_complex **F1 = session->F1;
+    float **P = session->P, **Q = session->Q;
+
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            for (c = 0; c < C; c++) {
+                F1[i][j * C + c].real = cosf(omegao * frame[c][i][j]);
+                F1[i][j * C + c].imag = sinf(omegao * frame[c][i][j]);
+            }
+        }
+        memset(P[i], 0, n * C * sizeof(float));
+        memset(Q[i], 0, n * C * sizeof(float));
+    }
+    int chunk = Kapprox / params->threads;
+    if (chunk == 0)
+        chunk = 1;
+    int nchunks = (Kapprox + chunk - 1) / chunk;
+#ifdef _OPENMP
+    omp_set_num_threads(params->threads);
+#pragma omp parallel shared(chunk, nchunks, Kapprox, session, spatial, P, Q, frame, F1, coff, omegao) private(k, i, j)
+#endif
+    {
+#ifdef _OPENMP
+        int t = omp_get_thread_num();
+#else
+        int t = 0;
+#endif
+        float **P_k = session->P_k[t], **Q_k = session->Q_k[t];
+        for (i = 0; i < m; i++) {
+            memset(P_k[i], 0, n * C * sizeof(float));
+            memset(Q_k[i], 0, n * C * sizeof(float));
+        }
+
+#ifdef _OPENMP
+#pragma omp for schedule(static, 1) nowait
+#endif
+        for (k = 0; k < nchunks; k++) {
+            shiftableBF_accumulate(m, n, C, k * chunk, min(Kapprox, (k + 1) * chunk), omegao, coff, spatial,
+                                   &session->kx, &session->ky, frame, frame, F1, session->F[t], session->G[t],
+                                   session->H[t], P_k, Q_k, NULL);
+        }
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (i = 0; i < m; i++) {
+                for (j = 0; j < n * C; j++) {
+                    P[i][j] += P_k[i][j];
+                    Q[i][j] += Q_k[i][j];
+                }
+            }
+        }
+    }
+
+    /* Compute Output Image from P and Q */
+    for (c = 0; c < C; c++) {
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                if (fabsf((Q[i][j * C + c])) <= 0.001f)
+                    outframe[c][i][j] = frame[c][i][j];
+                else
+                    outframe[c][i][j] = (P[i][j * C + c] / Q[i][j * C + c]);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief End a video filtering session and release its buffers
+ * \param session   Pointer to the session
+ */
+void video_session_close(video_session *session) {
+    video_session_release(session);
+    free(session->params.coeff);
+    free(session);
+}
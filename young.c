@@ -21,12 +21,12 @@
 
 #include "headersreq.h"
 
-void convolve_young2D(int rows, int columns, int sigma, fft_complex **ip_padded);
+void young_init(spatial_kernel *kernel, float sigma);
 
-void symmetric_padding(int rows, int columns, fft_complex **in, int w);
+void convolve_young2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                      fft_complex **ip_padded);
 
-float bf[3], bb[3], B;
-int w;
+void symmetric_padding(int rows, int columns, int lanes, fft_complex **in, int wy, int wx);
 
 /**
  * \brief Convolve input array with 1D Causal filter
@@ -34,32 +34,35 @@ int w;
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D Causal filter
  * of Young and van Vliet's algorithm. The 1D filter is an
- * IIR filter. 
+ * IIR filter. The real and imaginary parts of the lanes
+ * are filtered together by the innermost loops.
  */
-
-void convolve_youngCausal(fft_complex *in, fft_complex *out, int datasize) {
-	 
+static inline void convolve_youngCausal(fft_complex *in, fft_complex *out, int datasize, int lanes,
+                                        const spatial_kernel *kernel) {
+	const float B = kernel->B, *bf = kernel->bf;
+	const int L = 2 * lanes;
+	const float *x = (const float *) in;
+	float *y = (float *) out;
+	int l;
 
     /* Compute first 3 output elements */
-    out[0].real =  B* in[0].real;
-	out[0].imag = B* in[0].imag;
-    out[1].real =   (B* in[1].real)+  (bf[2]* out[0].real);
-	out[1].imag =   (B* in[1].imag)+  (bf[2]* out[0].imag);
-    out[2].real =  ( (B* in[2].real)+  ( (bf[1] * out[0].real)+  (bf[2] * out[1].real)));
-	out[2].imag =  ( (B* in[2].imag)+  ( (bf[1] * out[0].imag)+  (bf[2] * out[1].imag)));
+    for (l = 0; l < L; l++) {
+        y[l] = B * x[l];
+        y[L + l] = (B * x[L + l]) + (bf[2] * y[l]);
+        y[2 * L + l] = ((B * x[2 * L + l]) + ((bf[1] * y[l]) + (bf[2] * y[L + l])));
+    }
 
     /* Recursive computation of output in forward direction using filter parameters bf and B */
     for (int i = 3; i < datasize; i++) { 
-
-		out[i].real = B * in[i].real;
-		out[i].imag = B * in[i].imag;
-        for (int j = 0; j < 3; j++) {
-            out[i].real +=  (   (bf[j]*out[i - (3 - j)].real));
-			out[i].imag +=  (   (bf[j]*out[i - (3 - j)].imag));
+        float *yi = y + i * L;
+        for (l = 0; l < L; l++) {
+            yi[l] = B * x[i * L + l] + bf[0] * yi[l - 3 * L] + bf[1] * yi[l - 2 * L] + bf[2] * yi[l - L];
         }
     }
 
@@ -71,32 +74,36 @@ void convolve_youngCausal(fft_complex *in, fft_complex *out, int datasize) {
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D AntiCausal filter
  * of Young and van Vliet's algorithm. The 1D filter is an
  * IIR filter. 
  */
-void convolve_youngAnticausal(fft_complex *in, fft_complex *out, int datasize) {
-	 
+static inline void convolve_youngAnticausal(fft_complex *in, fft_complex *out, int datasize, int lanes,
+                                            const spatial_kernel *kernel) {
+	const float B = kernel->B, *bb = kernel->bb;
+	const int w = kernel->w, L = 2 * lanes;
+	const float *x = (const float *) in;
+	float *y = (float *) out;
+	const int last = (datasize - 1) * L;
+	int l;
 
     /* Compute last 3 output elements */
-    out[datasize - 1].real =  (B* in[datasize - 1].real);
-	out[datasize - 1].imag =  (B* in[datasize - 1].imag);
-    out[datasize - 2].real =  ( (B* in[datasize - 2].real)+  (bb[0]* out[datasize - 1].real));
-	out[datasize - 2].imag =  ( (B* in[datasize - 2].imag)+  (bb[0]* out[datasize - 1].imag));
-    out[datasize - 3].real =  ( (B* in[datasize - 3].real)+
-                             ( ( (bb[0]* out[datasize - 2].real)+ (bb[1]* out[datasize - 1].real))));
-	out[datasize - 3].imag = ((B* in[datasize - 3].imag) +
-		(((bb[0] * out[datasize - 2].imag) + (bb[1] * out[datasize - 1].imag))));
+    for (l = 0; l < L; l++) {
+        y[last + l] = (B * x[last + l]);
+        y[last - L + l] = ((B * x[last - L + l]) + (bb[0] * y[last + l]));
+        y[last - 2 * L + l] = ((B * x[last - 2 * L + l]) +
+                               (((bb[0] * y[last - L + l]) + (bb[1] * y[last + l]))));
+    }
 
     /* Recursive computation of output in backward direction using filter parameters bb and B */
     for  (int i = datasize - 4; i >= w; i--) {
-        out[i].real =  (B* in[i].real);
-		out[i].imag =  (B* in[i].imag);
-        for (int j = 0; j < 3; j++) {
-            out[i].real +=  (  (bb[j]* out[i + (j + 1)].real));
-			out[i].imag +=  (  (bb[j]* out[i + (j + 1)].imag));
+        float *yi = y + i * L;
+        for (l = 0; l < L; l++) {
+            yi[l] = B * x[i * L + l] + bb[0] * yi[l + L] + bb[1] * yi[l + 2 * L] + bb[2] * yi[l + 3 * L];
         }
     }
 
@@ -108,39 +115,48 @@ void convolve_youngAnticausal(fft_complex *in, fft_complex *out, int datasize) {
  * \param in        Pointer to input array
  * \param out       Pointer to output array
  * \param datasize  Input array size
+ * \param lanes     Number of interleaved complex values per element
+ * \param kernel    Filter constants
  *
  * This routine performs constant time convolution of the
  * 1D input array of complex floats with 1D Gaussian filter
  * using Young and van Vliet's algorithm. The input array is
  * first convolved with 1D Causal filter, the result of
  * which is convolved with 1D AntiCausal filter.
+ * The usual lane counts are passed as constants so that the
+ * compiler unrolls the lane loops.
  */
-void convolve_young1D(fft_complex *in, fft_complex *out, int datasize) {
-    /** \brief Array to store output of Causal filter convolution */
-    convolve_youngCausal(in, out, datasize);
-    convolve_youngAnticausal(out, in, datasize);
+void convolve_young1D(fft_complex *in, fft_complex *out, int datasize, int lanes, const spatial_kernel *kernel) {
+    switch (lanes) {
+        case 1:
+            convolve_youngCausal(in, out, datasize, 1, kernel);
+            convolve_youngAnticausal(out, in, datasize, 1, kernel);
+            break;
+        case 3:
+            convolve_youngCausal(in, out, datasize, 3, kernel);
+            convolve_youngAnticausal(out, in, datasize, 3, kernel);
+            break;
+        default:
+            convolve_youngCausal(in, out, datasize, lanes, kernel);
+            convolve_youngAnticausal(out, in, datasize, lanes, kernel);
+    }
 }
 
 /**
- * \brief Apply 2D Gaussian filter to input image
- *        (Young and van Vliet's algorithm) 
- * \param rows      Image height
- * \param columns   Image width
+ * \brief Compute Young and van Vliet filter constants
+ * \param kernel    Pointer to filter constants to fill
  * \param sigma     Gaussian kernel standard deviation
- * \param ip_padded Pointer to input image
- * \param op_padded Pointer to output image
  *
- * This routine applies 2D Gaussian filter of s.d.
- * sigma to input image ip_padded of dimensions
- * rows x columns and computes output image op_padded.
- * 1D filter is first convolved along rows and then
- * along columns. The 1D convolution is performed using
- * Young and van Vliet's fast recursive algorithm.
+ * This routine computes the forward and backward recursion
+ * coefficients bf, bb and the gain B of Young and van Vliet's
+ * approximation of the Gaussian with s.d. sigma.
  */
-void convolve_young2D(int rows, int columns, int sigma, fft_complex **ip_padded) {
+void young_init(spatial_kernel *kernel, float sigma) {
 
+    kernel->backend = SPATIAL_YOUNG;
+    kernel->sigma = sigma;
     /** \brief Filter radius */
-    w = 3 * sigma;
+    kernel->w = (int) ceilf(3 * sigma);
     /** \brief Filter parameter q */
     float q;
     if (sigma < 2.5)
@@ -155,31 +171,57 @@ void convolve_young2D(int rows, int columns, int sigma, fft_complex **ip_padded)
     float b3 = 0.422205f * q * q * q;
 	float invb0 = 1.0f / b0;
     /** \brief Filter parameters bf, bb, B */
-    bf[0] = b3 * invb0  ;
-    bf[1] = b2 * invb0;
-    bf[2] = b1 * invb0;
-    bb[0] = b1 * invb0;
-    bb[1] = b2 * invb0;
-    bb[2] = b3 * invb0;
-    B = 1 - (b1 + b2 + b3) * invb0; 
-    symmetric_padding(rows, columns, ip_padded, w);
+    kernel->bf[0] = b3 * invb0  ;
+    kernel->bf[1] = b2 * invb0;
+    kernel->bf[2] = b1 * invb0;
+    kernel->bb[0] = b1 * invb0;
+    kernel->bb[1] = b2 * invb0;
+    kernel->bb[2] = b3 * invb0;
+    kernel->B = 1 - (b1 + b2 + b3) * invb0;
+}
+
+/**
+ * \brief Apply 2D Gaussian filter to input image
+ *        (Young and van Vliet's algorithm) 
+ * \param rows      Image height
+ * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
+ * \param kx        Filter constants from young_init for rows
+ * \param ky        Filter constants from young_init for columns
+ * \param ip_padded Pointer to input/output image padded by
+ *                  ky->w rows and kx->w columns
+ *
+ * This routine applies 2D Gaussian filter to input image
+ * ip_padded of dimensions rows x columns in place.
+ * 1D filter is first convolved along rows and then
+ * along columns. The 1D convolution is performed using
+ * Young and van Vliet's fast recursive algorithm.
+ */
+void convolve_young2D(int rows, int columns, int lanes, const spatial_kernel *kx, const spatial_kernel *ky,
+                      fft_complex **ip_padded) {
+
+    /** \brief Padding widths */
+    const int wx = kx->w, wy = ky->w;
+    symmetric_padding(rows, columns, lanes, ip_padded, wy, wx);
     /* Convolve each row with 1D Gaussian filter */
-    fft_complex *out_t = calloc(columns + (2 * w), sizeof(fft_complex));
-    for (int i = 0; i < rows + 2 * w; i++) {
-        convolve_young1D(ip_padded[i], out_t, columns + 2 * w);
+    fft_complex *out_t = calloc((columns + (2 * wx)) * lanes, sizeof(fft_complex));
+    for (int i = 0; i < rows + 2 * wy; i++) {
+        convolve_young1D(ip_padded[i], out_t, columns + 2 * wx, lanes, kx);
     }
     free(out_t);
-    fft_complex *intemp = calloc(rows + (2 * w), sizeof(fft_complex)), *outtemp = calloc(rows + (2 * w),
-                                                                                         sizeof(fft_complex));
-    for (int j = w; j < columns + w; j++) {
+    fft_complex *intemp = calloc((rows + (2 * wy)) * lanes, sizeof(fft_complex)), *outtemp = calloc(
+            (rows + (2 * wy)) * lanes, sizeof(fft_complex));
+    for (int j = wx; j < columns + wx; j++) {
         /* Convolve each column with 1D Gaussian filter */
-        for (int i = 0; i < rows + (2 * w); i++) {
-            intemp[i] = ip_padded[i][j];
+        for (int i = 0; i < rows + (2 * wy); i++) {
+            for (int l = 0; l < lanes; l++)
+                intemp[i * lanes + l] = ip_padded[i][j * lanes + l];
         }
-        convolve_young1D(intemp, outtemp, rows + 2 * w);
+        convolve_young1D(intemp, outtemp, rows + 2 * wy, lanes, ky);
         /* Store the convolved column in row of output matrix*/
-        for (int i = 0; i < rows + (2 * w); i++) {
-            ip_padded[i][j] = intemp[i];
+        for (int i = 0; i < rows + (2 * wy); i++) {
+            for (int l = 0; l < lanes; l++)
+                ip_padded[i][j * lanes + l] = intemp[i * lanes + l];
         }
     }
     free(intemp);
@@ -191,56 +233,28 @@ void convolve_young2D(int rows, int columns, int sigma, fft_complex **ip_padded)
  *        (Young and van Vliet's algorithm) 
  * \param rows      Image height
  * \param columns   Image width
+ * \param lanes     Number of interleaved complex values per pixel
  * \param in Pointer to input image padded with zeros
+ * \param wy        Padding width above and below
+ * \param wx        Padding width left and right
  *
  * This routine applies mirror boundary conditions
  * to input image which is zero padded i.e size of
- * input image will be [rows+2*w, columns+2*w]
+ * input image will be [rows+2*wy, columns+2*wx]
  */
-void symmetric_padding(int rows, int columns, fft_complex **in, int w) {
+void symmetric_padding(int rows, int columns, int lanes, fft_complex **in, int wy, int wx) {
     int i, j;
-    fft_complex pixval;
-    /* Rows 0 - w are duplicated to satisfy mirror bondary condition */
-    for (i = 0; i < w; i++) {
-        for (j = 0; j < columns; j++) {
-            pixval = in[i + w][j + w];
-            if (j < w) {
-                in[i + w][w - 1 - j] = pixval;
-                in[w - 1 - i][w - 1 - j] = pixval;
-            }
-            if (j >= columns - w) {
-                in[i + w][columns + w + (columns - j) - 1] = pixval;
-                in[w - 1 - i][columns + w + (columns - j) - 1] = pixval;
-            }
-            in[w - 1 - i][j + w] = pixval;
-        }
-    }
-    /* Rows rows-w - rows  are duplicated to satisfy mirror bondary condition */
-    for (i = rows - w; i < rows; i++) {
-        for (j = 0; j < columns; j++) {
-            pixval = in[i + w][j + w];
-            if (j < w) {
-                in[i + w][w - 1 - j] = pixval;
-                in[rows + w + (rows - i) - 1][w - 1 - j] = pixval;
-            }
-            if (j >= columns - w) {
-                in[i + w][columns + w + (columns - j) - 1] = pixval;
-                in[rows + w + (rows - i) - 1][columns + w + (columns - j) - 1] = pixval;
-            }
-            in[rows + w + (rows - i) - 1][j + w] = pixval;
-        }
-    }
-    /* Remaining rows are duplicated to satisfy mirror bondary condition*/
-    for (i = w; i < rows - w; i++) {
-        for (j = 0; j < w; j++) {
-            in[i + w][w - 1 - j] = in[i + w][j + w];
+    const size_t pixel = lanes * sizeof(fft_complex);
+    /* Columns 0 - wx and columns-wx - columns are duplicated to satisfy mirror bondary condition */
+    for (i = wy; i < rows + wy; i++) {
+        for (j = 0; j < wx; j++) {
+            memcpy(in[i] + (wx - 1 - j) * lanes, in[i] + (wx + j) * lanes, pixel);
+            memcpy(in[i] + (columns + wx + j) * lanes, in[i] + (columns + wx - 1 - j) * lanes, pixel);
         }
     }
-    for (i = w; i < rows - w; i++) {
-        for (j = columns - w; j < columns; j++) {
-            in[i + w][columns + w + (columns - j) - 1] = in[i + w][j + w];
-        }
+    /* Rows 0 - wy and rows-wy - rows, with their padding, are duplicated to satisfy mirror bondary condition */
+    for (i = 0; i < wy; i++) {
+        memcpy(in[wy - 1 - i], in[wy + i], (columns + 2 * wx) * pixel);
+        memcpy(in[rows + wy + i], in[rows + wy - 1 - i], (columns + 2 * wx) * pixel);
     }
-
 }
-